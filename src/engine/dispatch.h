@@ -22,6 +22,7 @@
 
 #include <stdlib.h>
 #include <vector>
+#include "blip_buf.h"
 
 #define ONE_SEMITONE 2200
 
@@ -137,6 +138,56 @@ struct DivDelayedCommand {
   DivCommand cmd;
 };
 
+/**
+ * band-limited output of a dispatch which renders with acquireDirect().
+ * owned by the dispatch container.
+ */
+struct DivDeltaBuf {
+  blip_buffer_t* bb[2];
+  int last[2];
+  bool lowQuality;
+
+  /**
+   * set the output level of a channel.
+   * nothing is done if it didn't change.
+   * @param ch 0 for left or mono, 1 for right.
+   * @param time the time in samples (at the dispatch's rate) since the start of the frame.
+   * @param level the new level.
+   */
+  inline void put(int ch, size_t time, int level) {
+    int delta=level-last[ch];
+    if (delta==0) return;
+    last[ch]=level;
+    if (lowQuality) {
+      blip_add_delta_fast(bb[ch],time,delta);
+    } else {
+      blip_add_delta(bb[ch],time,delta);
+    }
+  }
+
+  /**
+   * change the output level of a channel by an amount.
+   * use this when changes arrive out of order, e.g. from several voices.
+   * @param ch 0 for left or mono, 1 for right.
+   * @param time the time in samples (at the dispatch's rate) since the start of the frame.
+   * @param delta the change in level.
+   */
+  inline void add(int ch, size_t time, int delta) {
+    if (delta==0) return;
+    last[ch]+=delta;
+    if (lowQuality) {
+      blip_add_delta_fast(bb[ch],time,delta);
+    } else {
+      blip_add_delta(bb[ch],time,delta);
+    }
+  }
+
+  DivDeltaBuf():
+    bb{NULL,NULL},
+    last{0,0},
+    lowQuality(false) {}
+};
+
 struct DivRegWrite {
   /**
    * an address of 0xffffxx00 indicates a Furnace specific command.
@@ -188,6 +239,39 @@ class DivDispatch {
      */
     virtual void acquire(short* bufL, short* bufR, size_t start, size_t len);
 
+    /**
+     * test whether this dispatch renders with acquireDirect() instead of acquire().
+     * @return whether it does.
+     */
+    virtual bool isDirect();
+
+    /**
+     * render by reporting changes in output level straight to blip buffers,
+     * instead of filling a buffer with every sample.
+     * only called if isDirect() returns true.
+     * @param out the output.
+     * @param start the start offset.
+     * @param len the amount of samples to render.
+     */
+    virtual void acquireDirect(DivDeltaBuf& out, size_t start, size_t len);
+
+    /**
+     * test whether this dispatch is quiet: no writes are pending and its output
+     * will stay at the last level until the next tick.
+     * while this is true the engine won't call acquire() or acquireDirect(),
+     * and calls skipQuiet() instead.
+     * @return whether it is.
+     */
+    virtual bool isQuiet();
+
+    /**
+     * advance the emulation while quiet, without rendering.
+     * state which outlives the quiet stretch (counters, noise) should move on
+     * as if acquire() had been called.
+     * @param len the amount of samples to skip.
+     */
+    virtual void skipQuiet(size_t len);
+
     /**
      * send a command to this dispatch.
      * @param c a DivCommand.
@@ -231,18 +315,26 @@ class DivDispatch {
     virtual int getRegisterPoolDepth();
 
     /**
-     * get this dispatch's state. DO NOT IMPLEMENT YET.
-     * @return a pointer to the dispatch's state. must be deallocated manually!
+     * get this dispatch's state.
+     * this is the playback state (channels, macros and so on), not the state of the emulated chip.
+     * @return a pointer to the dispatch's state, or NULL if this dispatch does not support state saves.
+     * must be deallocated using freeState()!
      */
     virtual void* getState();
 
     /**
-     * set this dispatch's state. DO NOT IMPLEMENT YET.
+     * set this dispatch's state.
      * @param state a pointer to a state pertaining to this dispatch,
      * or NULL if this dispatch does not support state saves.
      */
     virtual void setState(void* state);
 
+    /**
+     * free a state returned by getState().
+     * @param state a pointer to a state pertaining to this dispatch.
+     */
+    virtual void freeState(void* state);
+
     /**
      * mute a channel.
      * @param ch the channel to mute.
@@ -42,8 +42,10 @@
 #include "platform/qsound.h"
 #include "platform/dummy.h"
 #include "platform/lynx.h"
+#include "mix.h"
 #include "../ta-log.h"
 #include "song.h"
+#include <algorithm>
 
 void DivDispatchContainer::setRates(double gotRate) {
   blip_set_rates(bb[0],dispatch->rate,gotRate);
@@ -52,41 +54,62 @@ void DivDispatchContainer::setRates(double gotRate) {
 
 void DivDispatchContainer::setQuality(bool lowQual) {
   lowQuality=lowQual;
+  deltaBuf.lowQuality=lowQual;
 }
 
 void DivDispatchContainer::acquire(size_t offset, size_t count) {
-  dispatch->acquire(bbIn[0],bbIn[1],offset,count);
+  DivTraceSpan span("acquire",sysName,"sys",sysIndex);
+  perfAcquire.begin();
+  if (dispatch->isQuiet()) {
+    dispatch->skipQuiet(count);
+    // hold the last level. no deltas are needed for that
+    if (!dispatch->isDirect()) {
+      for (int i=0; i<(dispatch->isStereo()?2:1); i++) {
+        std::fill_n(bbIn[i]+offset,count,(offset>0)?bbIn[i][offset-1]:prevSample[i]);
+      }
+    }
+  } else if (dispatch->isDirect()) {
+    dispatch->acquireDirect(deltaBuf,offset,count);
+  } else {
+    dispatch->acquire(bbIn[0],bbIn[1],offset,count);
+    activeLen=offset+count;
+  }
+  perfAcquire.end();
 }
 
 void DivDispatchContainer::flush(size_t count) {
   blip_read_samples(bb[0],bbOut[0],count,0);
 
-  if (dispatch->isStereo()) {
+  if (dispatch->isStereo() || groupLen>0) {
     blip_read_samples(bb[1],bbOut[1],count,0);
   }
 }
 
 void DivDispatchContainer::fillBuf(size_t runtotal, size_t offset, size_t size) {
-  if (lowQuality) {
-    for (size_t i=0; i<runtotal; i++) {
+  DivTraceSpan span("fillBuf",sysName,"sys",sysIndex);
+  perfFillBuf.begin();
+  if (dispatch->isDirect()) {
+    // the deltas are already in the blip buffers
+  } else if (lowQuality) {
+    for (size_t i=0; i<activeLen; i++) {
       temp[0]=bbIn[0][i];
       blip_add_delta_fast(bb[0],i,temp[0]-prevSample[0]);
       prevSample[0]=temp[0];
     }
 
-    if (dispatch->isStereo()) for (size_t i=0; i<runtotal; i++) {
+    if (dispatch->isStereo()) for (size_t i=0; i<activeLen; i++) {
       temp[1]=bbIn[1][i];
       blip_add_delta_fast(bb[1],i,temp[1]-prevSample[1]);
       prevSample[1]=temp[1];
     }
   } else {
-    for (size_t i=0; i<runtotal; i++) {
+    for (size_t i=0; i<activeLen; i++) {
       temp[0]=bbIn[0][i];
       blip_add_delta(bb[0],i,temp[0]-prevSample[0]);
       prevSample[0]=temp[0];
     }
 
-    if (dispatch->isStereo()) for (size_t i=0; i<runtotal; i++) {
+    if (dispatch->isStereo()) for (size_t i=0; i<activeLen; i++) {
       temp[1]=bbIn[1][i];
       blip_add_delta(bb[1],i,temp[1]-prevSample[1]);
       prevSample[1]=temp[1];
@@ -105,6 +128,102 @@ void DivDispatchContainer::fillBuf(size_t runtotal, size_t offset, size_t size)
     blip_end_frame(bb[1],runtotal);
     blip_read_samples(bb[1],bbOut[1]+offset,size,0);
   }
+  activeLen=0;
+  perfFillBuf.end();
+}
+
+void DivDispatchContainer::fillGroupBuf(size_t runtotal, size_t offset, size_t size) {
+  DivTraceSpan span("fillBuf",sysName,"sys",sysIndex);
+  perfFillBuf.begin();
+  // sum the members with their volumes, scaled down so the sum can't clip
+  memset(groupIn[0],0,runtotal*sizeof(int));
+  memset(groupIn[1],0,runtotal*sizeof(int));
+  for (int i=0; i<groupLen; i++) {
+    DivDispatchContainer* c=groupMembers[i];
+    if (c->dispatch->isStereo()) {
+      divMixVoice(groupIn[0],groupIn[1],c->bbIn[0],groupVol[i][0],0,groupShift,runtotal);
+      divMixVoice(groupIn[0],groupIn[1],c->bbIn[1],0,groupVol[i][1],groupShift,runtotal);
+    } else {
+      divMixVoice(groupIn[0],groupIn[1],c->bbIn[0],groupVol[i][0],groupVol[i][1],groupShift,runtotal);
+    }
+    // the quiet hold in acquire() continues from here
+    if (runtotal>0) {
+      c->prevSample[0]=c->bbIn[0][runtotal-1];
+      if (c->dispatch->isStereo()) c->prevSample[1]=c->bbIn[1][runtotal-1];
+    }
+    c->activeLen=0;
+  }
+
+  for (int j=0; j<2; j++) {
+    if (lowQuality) {
+      for (size_t i=0; i<runtotal; i++) {
+        blip_add_delta_fast(bb[j],i,groupIn[j][i]-groupPrev[j]);
+        groupPrev[j]=groupIn[j][i];
+      }
+    } else {
+      for (size_t i=0; i<runtotal; i++) {
+        blip_add_delta(bb[j],i,groupIn[j][i]-groupPrev[j]);
+        groupPrev[j]=groupIn[j][i];
+      }
+    }
+    blip_end_frame(bb[j],runtotal);
+    blip_read_samples(bb[j],bbOut[j]+offset,size,0);
+  }
+  perfFillBuf.end();
+}
+
+void DivDispatchContainer::joinGroup() {
+  if (bbOut[0]==NULL) return;
+  delete[] bbOut[0];
+  delete[] bbOut[1];
+  bbOut[0]=NULL;
+  bbOut[1]=NULL;
+}
+
+void DivDispatchContainer::leaveGroup() {
+  if (bbOut[0]!=NULL) return;
+  bbOut[0]=new short[bbOutLen];
+  bbOut[1]=new short[bbOutLen];
+  // resume from the current level
+  for (int i=0; i<2; i++) {
+    blip_clear(bb[i]);
+    blip_add_delta(bb[i],0,prevSample[i]);
+  }
+}
+
+void _acquireJob(void* cont) {
+  DivDispatchContainer* c=(DivDispatchContainer*)cont;
+  c->acquire(c->jobOffset,c->jobSize);
+}
+
+void _fillBufJob(void* cont) {
+  DivDispatchContainer* c=(DivDispatchContainer*)cont;
+  c->fillBuf(c->jobRunTotal,c->jobOffset,c->jobSize);
+}
+
+void _fillGroupBufJob(void* cont) {
+  DivDispatchContainer* c=(DivDispatchContainer*)cont;
+  c->fillGroupBuf(c->jobRunTotal,c->jobOffset,c->jobSize);
+}
+
+void DivDispatchContainer::queueAcquire(DivWorkPool& pool, size_t offset, size_t count) {
+  jobOffset=offset;
+  jobSize=count;
+  pool.push(_acquireJob,this);
+}
+
+void DivDispatchContainer::queueFillBuf(DivWorkPool& pool, size_t runtotal, size_t offset, size_t size) {
+  jobRunTotal=runtotal;
+  jobOffset=offset;
+  jobSize=size;
+  pool.push(_fillBufJob,this);
+}
+
+void DivDispatchContainer::queueFillGroupBuf(DivWorkPool& pool, size_t runtotal, size_t offset, size_t size) {
+  jobRunTotal=runtotal;
+  jobOffset=offset;
+  jobSize=size;
+  pool.push(_fillGroupBufJob,this);
 }
 
 void DivDispatchContainer::clear() {
@@ -114,6 +233,11 @@ void DivDispatchContainer::clear() {
   temp[1]=0;
   prevSample[0]=0;
   prevSample[1]=0;
+  activeLen=0;
+  groupPrev[0]=0;
+  groupPrev[1]=0;
+  deltaBuf.last[0]=0;
+  deltaBuf.last[1]=0;
   // run for one cycle to determine DC offset
   // TODO: SAA1099 doesn't like that
   /*dispatch->acquire(bbIn[0],bbIn[1],0,1);
@@ -123,26 +247,30 @@ void DivDispatchContainer::clear() {
   prevSample[1]=temp[1];*/
 }
 
-void DivDispatchContainer::init(DivSystem sys, DivEngine* eng, int chanCount, double gotRate, unsigned int flags) {
+void DivDispatchContainer::init(DivSystem sys, DivEngine* eng, int chanCount, double gotRate, unsigned int flags, size_t bufSize) {
   if (dispatch!=NULL) return;
 
-  bb[0]=blip_new(32768);
+  bb[0]=blip_new(bufSize);
   if (bb[0]==NULL) {
     logE("not enough memory!\n");
     return;
   }
 
-  bb[1]=blip_new(32768);
+  bb[1]=blip_new(bufSize);
   if (bb[1]==NULL) {
     logE("not enough memory!\n");
     return;
   }
+  deltaBuf.bb[0]=bb[0];
+  deltaBuf.bb[1]=bb[1];
 
-  bbOut[0]=new short[32768];
-  bbOut[1]=new short[32768];
-  bbIn[0]=new short[32768];
-  bbIn[1]=new short[32768];
-  bbInLen=32768;
+  // bbIn grows in nextBuf if a system needs more input than this
+  bbOut[0]=new short[bufSize];
+  bbOut[1]=new short[bufSize];
+  bbOutLen=bufSize;
+  bbIn[0]=new short[bufSize];
+  bbIn[1]=new short[bufSize];
+  bbInLen=bufSize;
 
   switch (sys) {
     case DIV_SYSTEM_YM2612:
@@ -209,6 +337,7 @@ void DivDispatchContainer::init(DivSystem sys, DivEngine* eng, int chanCount, do
       dispatch=new DivPlatformOPLL;
       ((DivPlatformOPLL*)dispatch)->setVRC7(sys==DIV_SYSTEM_VRC7);
       ((DivPlatformOPLL*)dispatch)->setProperDrums(sys==DIV_SYSTEM_OPLL_DRUMS);
+      ((DivPlatformOPLL*)dispatch)->setYMFM(eng->getConfInt("opllCore",0));
       break;
     case DIV_SYSTEM_SAA1099: {
       int saaCore=eng->getConfInt("saaCore",0);
@@ -248,7 +377,16 @@ void DivDispatchContainer::quit() {
   delete[] bbOut[1];
   delete[] bbIn[0];
   delete[] bbIn[1];
+  delete[] groupIn[0];
+  delete[] groupIn[1];
+  bbOut[0]=NULL;
+  bbOut[1]=NULL;
+  groupIn[0]=NULL;
+  groupIn[1]=NULL;
+  groupInLen=0;
   bbInLen=0;
   blip_delete(bb[0]);
   blip_delete(bb[1]);
+  deltaBuf.bb[0]=NULL;
+  deltaBuf.bb[1]=NULL;
 }
@@ -37,11 +37,13 @@
 #include "../audio/jack.h"
 #endif
 #include <math.h>
+#include <chrono>
+#include <algorithm>
 #include <sndfile.h>
 #include <fmt/printf.h>
 
 void process(void* u, float** in, float** out, int inChans, int outChans, unsigned int size) {
-  ((DivEngine*)u)->nextBuf(in,out,inChans,outChans,size);
+  ((DivEngine*)u)->processAudio(in,out,inChans,outChans,size);
 }
 
 const char* DivEngine::getEffectDesc(unsigned char effect, int chan) {
@@ -108,61 +110,74 @@ const char* DivEngine::getEffectDesc(unsigned char effect, int chan) {
   return "Invalid effect";
 }
 
-void DivEngine::walkSong(int& loopOrder, int& loopRow, int& loopEnd) {
-  loopOrder=0;
-  loopRow=0;
-  loopEnd=-1;
-  int nextOrder=-1;
-  int nextRow=0;
-  int effectVal=0;
-  DivPattern* pat[DIV_MAX_CHANS];
-  for (int i=0; i<song.ordersLen; i++) {
-    for (int j=0; j<chans; j++) {
-      pat[j]=song.pat[j].getPattern(song.orders.ord[j][i],false);
-    }
-    for (int j=nextRow; j<song.patLen; j++) {
-      nextRow=0;
-      for (int k=0; k<chans; k++) {
-        for (int l=0; l<song.pat[k].effectRows; l++) {
-          effectVal=pat[k]->data[j][5+(l<<1)];
-          if (effectVal<0) effectVal=0;
-          if (pat[k]->data[j][4+(l<<1)]==0x0d) {
-            if (nextOrder==-1 && i<song.ordersLen-1) {
-              nextOrder=i+1;
-              nextRow=effectVal;
-            }
-          } else if (pat[k]->data[j][4+(l<<1)]==0x0b) {
-            if (nextOrder==-1) {
-              nextOrder=effectVal;
-              nextRow=0;
-            }
-          }
-        }
-      }
-      if (nextOrder!=-1) {
-        if (nextOrder<=i) {
-          loopOrder=nextOrder;
-          loopRow=nextRow;
-          loopEnd=i;
-          return;
-        }
-        i=nextOrder-1;
-        nextOrder=-1;
-        break;
-      }
+void _runExportThread(DivEngine* caller) {
+  traceThreadStart();
+  caller->runExportThread();
+}
+
+void _runExportChanJob(void* caller) {
+  ((DivEngine*)caller)->runExportChanJob();
+}
+
+void _runRenderThread(DivEngine* caller) {
+  traceThreadStart();
+  caller->runRenderThread();
+}
+
+void DivEngine::runRenderThread() {
+  float* buf[2];
+  buf[0]=new float[renderAheadSize];
+  buf[1]=new float[renderAheadSize];
+  // wake up once per buffer anyway in case a notification is missed
+  std::chrono::microseconds period((long long)(1000000.0*renderAheadSize/got.rate));
+
+  std::unique_lock<std::mutex> lock(renderLock);
+  while (!renderQuit) {
+    // don't start until the audio callback does (the engine may not be
+    // fully initialized before that)
+    if (!renderStarted || renderRing[1].readable()>=renderAhead*renderAheadSize || renderRing[0].writable()<renderAheadSize) {
+      renderWake.wait_for(lock,period);
+      continue;
     }
+    lock.unlock();
+    nextBuf(NULL,buf,0,2,renderAheadSize);
+    renderRing[0].write(buf[0],renderAheadSize);
+    renderRing[1].write(buf[1],renderAheadSize);
+    lock.lock();
   }
+
+  delete[] buf[0];
+  delete[] buf[1];
 }
 
-void _runExportThread(DivEngine* caller) {
-  caller->runExportThread();
+void DivEngine::processAudio(float** in, float** out, int inChans, int outChans, unsigned int size) {
+  if (renderThread==NULL) {
+    nextBuf(in,out,inChans,outChans,size);
+    return;
+  }
+
+  // the left channel is always written first
+  size_t avail=renderRing[1].readable();
+  if (avail>size) avail=size;
+  renderRing[0].read(out[0],avail);
+  renderRing[1].read(out[1],avail);
+  if (avail<size) {
+    memset(out[0]+avail,0,(size-avail)*sizeof(float));
+    memset(out[1]+avail,0,(size-avail)*sizeof(float));
+  }
+
+  renderStarted=true;
+  renderWake.notify_one();
 }
 
 bool DivEngine::isExporting() {
   return exporting;
 }
 
-#define EXPORT_BUFSIZE 2048
+// one blip_buf frame at most. longer frames overflow its time arithmetic.
+#define EXPORT_BUFSIZE blip_max_frame
+// each per-channel export thread holds a copy of the song and its systems
+#define EXPORT_MAX_THREADS 8
 
 void DivEngine::runExportThread() {
   switch (exportMode) {
@@ -193,6 +208,7 @@ void DivEngine::runExportThread() {
 
       while (playing) {
         nextBuf(NULL,outBuf,0,2,EXPORT_BUFSIZE);
+        exportProgress=getRenderProgress(exportLoops);
         for (int i=0; i<EXPORT_BUFSIZE; i++) {
           outBuf[2][i<<1]=MAX(-1.0f,MIN(1.0f,outBuf[0][i]));
           outBuf[2][1+(i<<1)]=MAX(-1.0f,MIN(1.0f,outBuf[1][i]));
@@ -200,9 +216,12 @@ void DivEngine::runExportThread() {
         if (totalProcessed>EXPORT_BUFSIZE) {
           logE("error: total processed is bigger than export bufsize! %d>%d\n",totalProcessed,EXPORT_BUFSIZE);
         }
-        if (sf_writef_float(sf,outBuf[2],totalProcessed)!=(int)totalProcessed) {
-          logE("error: failed to write entire buffer!\n");
-          break;
+        {
+          DivTraceSpan span("export","write");
+          if (sf_writef_float(sf,outBuf[2],totalProcessed)!=(int)totalProcessed) {
+            logE("error: failed to write entire buffer!\n");
+            break;
+          }
         }
       }
 
@@ -262,12 +281,15 @@ void DivEngine::runExportThread() {
 
       // take control of audio output
       deinitAudioBackend();
+      // every system needs its own output
+      shareBlip=false;
       playSub(false);
 
       logI("rendering to files...\n");
 
       while (playing) {
         nextBuf(NULL,outBuf,0,2,EXPORT_BUFSIZE);
+        exportProgress=getRenderProgress(exportLoops);
         for (int i=0; i<song.systemLen; i++) {
           for (int j=0; j<EXPORT_BUFSIZE; j++) {
             if (!disCont[i].dispatch->isStereo()) {
@@ -280,9 +302,12 @@ void DivEngine::runExportThread() {
           if (totalProcessed>EXPORT_BUFSIZE) {
             logE("error: total processed is bigger than export bufsize! (%d) %d>%d\n",i,totalProcessed,EXPORT_BUFSIZE);
           }
-          if (sf_writef_short(sf[i],sysBuf,totalProcessed)!=(int)totalProcessed) {
-            logE("error: failed to write entire buffer! (%d)\n",i);
-            break;
+          {
+            DivTraceSpan span("export","write");
+            if (sf_writef_short(sf[i],sysBuf,totalProcessed)!=(int)totalProcessed) {
+              logE("error: failed to write entire buffer! (%d)\n",i);
+              break;
+            }
           }
         }
       }
@@ -296,6 +321,7 @@ void DivEngine::runExportThread() {
           logE("could not close audio file!\n");
         }
       }
+      shareBlip=true;
       exporting=false;
 
       if (initAudioBackend()) {
@@ -311,99 +337,179 @@ void DivEngine::runExportThread() {
       break;
     }
     case DIV_EXPORT_MODE_MANY_CHAN: {
-      // take control of audio output
-      deinitAudioBackend();
-
-      float* outBuf[3];
-      outBuf[0]=new float[EXPORT_BUFSIZE];
-      outBuf[1]=new float[EXPORT_BUFSIZE];
-      outBuf[2]=new float[EXPORT_BUFSIZE*2];
-      int loopCount=remainingLoops;
+      // each thread renders stems in its own copy of the engine, so playback
+      // goes on while exporting.
+      int threads=std::thread::hardware_concurrency();
+      if (threads>EXPORT_MAX_THREADS) threads=EXPORT_MAX_THREADS;
+      if (threads>chans) threads=chans;
+      if (threads>DIV_WORK_POOL_MAX_JOBS) threads=DIV_WORK_POOL_MAX_JOBS;
+      if (threads<1) threads=1;
+
+      logI("rendering to files using %d threads...\n",threads);
+
+      DivWorkPool exportPool;
+      exportPool.init(threads);
+      exportNextChan=0;
+      exportChansDone=0;
+      for (int i=0; i<threads; i++) {
+        exportPool.push(_runExportChanJob,this);
+      }
+      exportPool.run();
+      exportPool.quit();
 
-      logI("rendering to files...\n");
-      
-      for (int i=0; i<chans; i++) {
-        SNDFILE* sf;
-        SF_INFO si;
-        String fname=fmt::sprintf("%s_c%02d.wav",exportPath,i+1);
-        logI("- %s\n",fname.c_str());
-        si.samplerate=got.rate;
-        si.channels=2;
-        si.format=SF_FORMAT_WAV|SF_FORMAT_PCM_16;
-
-        sf=sf_open(fname.c_str(),SFM_WRITE,&si);
-        if (sf==NULL) {
-          logE("could not open file for writing! (%s)\n",sf_strerror(NULL));
-          break;
-        }
+      delete[] exportSong;
+      exportSong=NULL;
+      exportSongLen=0;
+      exporting=false;
+      logI("done!\n");
+      break;
+    }
+  }
+}
 
-        for (int j=0; j<chans; j++) {
-          bool mute=(j!=i);
-          isMuted[j]=mute;
-          if (disCont[dispatchOfChan[j]].dispatch!=NULL) {
-            disCont[dispatchOfChan[j]].dispatch->muteChannel(dispatchChanOfChan[j],isMuted[j]);
-          }
-        }
-        
-        curOrder=0;
-        remainingLoops=loopCount;
-        playSub(false);
+void DivEngine::runExportChanJob() {
+  DivEngine* clone=new DivEngine;
+  if (!clone->initClone(this,exportSong,exportSongLen)) {
+    logE("could not copy song for export!\n");
+    if (!exportHalt.exchange(true)) {
+      exportError="could not copy song for export";
+    }
+    delete clone;
+    return;
+  }
 
-        while (playing) {
-          nextBuf(NULL,outBuf,0,2,EXPORT_BUFSIZE);
-          for (int j=0; j<EXPORT_BUFSIZE; j++) {
-            outBuf[2][j<<1]=MAX(-1.0f,MIN(1.0f,outBuf[0][j]));
-            outBuf[2][1+(j<<1)]=MAX(-1.0f,MIN(1.0f,outBuf[1][j]));
-          }
-          if (totalProcessed>EXPORT_BUFSIZE) {
-            logE("error: total processed is bigger than export bufsize! %d>%d\n",totalProcessed,EXPORT_BUFSIZE);
-          }
-          if (sf_writef_float(sf,outBuf[2],totalProcessed)!=(int)totalProcessed) {
-            logE("error: failed to write entire buffer!\n");
-            break;
-          }
-        }
+  float* outBuf[3];
+  outBuf[0]=new float[EXPORT_BUFSIZE];
+  outBuf[1]=new float[EXPORT_BUFSIZE];
+  outBuf[2]=new float[EXPORT_BUFSIZE*2];
+
+  while (!exportHalt) {
+    int i=exportNextChan++;
+    if (i>=clone->chans) break;
+
+    SNDFILE* sf;
+    SF_INFO si;
+    String fname=fmt::sprintf("%s_c%02d.wav",exportPath,i+1);
+    logI("- %s\n",fname.c_str());
+    si.samplerate=clone->got.rate;
+    si.channels=2;
+    si.format=SF_FORMAT_WAV|SF_FORMAT_PCM_16;
+
+    sf=sf_open(fname.c_str(),SFM_WRITE,&si);
+    if (sf==NULL) {
+      logE("could not open file for writing! (%s)\n",sf_strerror(NULL));
+      // stop the other threads as well. only the first error is kept
+      if (!exportHalt.exchange(true)) {
+        exportError=fmt::sprintf("could not open %s: %s",fname,sf_strerror(NULL));
+      }
+      exportProgress=(float)(++exportChansDone)/clone->chans;
+      break;
+    }
 
-        if (sf_close(sf)!=0) {
-          logE("could not close audio file!\n");
-        }
+    for (int j=0; j<clone->chans; j++) {
+      clone->isMuted[j]=(j!=i);
+      if (clone->disCont[clone->dispatchOfChan[j]].dispatch!=NULL) {
+        clone->disCont[clone->dispatchOfChan[j]].dispatch->muteChannel(clone->dispatchChanOfChan[j],clone->isMuted[j]);
       }
-      exporting=false;
+    }
 
-      delete[] outBuf[0];
-      delete[] outBuf[1];
-      delete[] outBuf[2];
+    clone->curOrder=0;
+    clone->remainingLoops=exportLoops;
+    clone->playSub(false);
 
-      for (int i=0; i<chans; i++) {
-        isMuted[i]=false;
-        if (disCont[dispatchOfChan[i]].dispatch!=NULL) {
-          disCont[dispatchOfChan[i]].dispatch->muteChannel(dispatchChanOfChan[i],false);
-        }
+    while (clone->playing && !exportHalt) {
+      clone->nextBuf(NULL,outBuf,0,2,EXPORT_BUFSIZE);
+      for (int j=0; j<EXPORT_BUFSIZE; j++) {
+        outBuf[2][j<<1]=MAX(-1.0f,MIN(1.0f,outBuf[0][j]));
+        outBuf[2][1+(j<<1)]=MAX(-1.0f,MIN(1.0f,outBuf[1][j]));
       }
-
-      if (initAudioBackend()) {
-        for (int i=0; i<song.systemLen; i++) {
-          disCont[i].setRates(got.rate);
-          disCont[i].setQuality(lowQuality);
-        }
-        if (!output->setRun(true)) {
-          logE("error while activating audio!\n");
+      if (clone->totalProcessed>EXPORT_BUFSIZE) {
+        logE("error: total processed is bigger than export bufsize! %d>%d\n",clone->totalProcessed,EXPORT_BUFSIZE);
+      }
+      {
+        DivTraceSpan span("export","write");
+        if (sf_writef_float(sf,outBuf[2],clone->totalProcessed)!=(int)clone->totalProcessed) {
+          logE("error: failed to write entire buffer!\n");
+          break;
         }
       }
-      logI("done!\n");
-      break;
     }
+
+    if (sf_close(sf)!=0) {
+      logE("could not close audio file!\n");
+    }
+    exportProgress=(float)(++exportChansDone)/clone->chans;
   }
+
+  delete[] outBuf[0];
+  delete[] outBuf[1];
+  delete[] outBuf[2];
+
+  clone->quitClone();
+  delete clone;
+}
+
+float DivEngine::getRenderProgress(int loops) {
+  if (loops<1 || song.ordersLen<1) return 0.0f;
+  float ret;
+  if (exportLength>0.0) {
+    // elapsed play time against the length measured when the export started
+    ret=(totalSeconds+(double)totalTicks/1000000.0)/exportLength;
+  } else {
+    ret=((float)(loops-remainingLoops)+(float)curOrder/song.ordersLen)/loops;
+  }
+  if (ret<0.0f) return 0.0f;
+  if (ret>1.0f) return 1.0f;
+  return ret;
 }
 
 bool DivEngine::saveAudio(const char* path, int loops, DivAudioExportModes mode) {
   exportPath=path;
   exportMode=mode;
+  exportLoops=loops;
+  exportHalt=false;
+  exportProgress=0.0f;
+  exportLength=0.0;
+  if (mode==DIV_EXPORT_MODE_MANY_CHAN) {
+    // the export threads load their own copy of the song from this.
+    // saveFur() marks the song as a .fur one, which must not stick.
+    bool wasDMF=song.isDMF;
+    unsigned short oldVersion=song.version;
+    String oldWarnings=warnings;
+    SafeWriter* w=saveFur();
+    song.isDMF=wasDMF;
+    song.version=oldVersion;
+    warnings=oldWarnings;
+    if (w==NULL) {
+      logE("could not copy song for export!\n");
+      return false;
+    }
+    exportSongLen=w->size();
+    exportSong=new unsigned char[exportSongLen];
+    memcpy(exportSong,w->getFinalBuf(),exportSongLen);
+    w->finish();
+    delete w;
+  }
+  exportError="";
+  // this must be done before the export thread starts, so it can't be queued
+  isBusy.lock();
+  if (mode!=DIV_EXPORT_MODE_MANY_CHAN) {
+    runCmds();
+    runCmd(DivEngineCmd(DIV_ENGINE_CMD_STOP));
+    repeatPattern=false;
+    runCmd(DivEngineCmd(DIV_ENGINE_CMD_SET_ORDER,0));
+    remainingLoops=loops;
+    // measure the song once, so progress only has to look at the play time
+    checkTimeline();
+    while (stepTimeline());
+    exportLength=timeline.duration;
+    if (!timeline.stops && exportLength>0.0) {
+      double loopStart=getRowTimeUnlocked(timeline.loopOrder,timeline.loopRow);
+      if (loopStart>=0.0) exportLength+=(exportLength-loopStart)*(loops-1);
+    }
+  }
   exporting=true;
-  stop();
-  repeatPattern=false;
-  setOrder(0);
-  remainingLoops=loops;
+  isBusy.unlock();
   exportThread=new std::thread(_runExportThread,this);
   return true;
 }
@@ -415,47 +521,209 @@ void DivEngine::waitAudioFile() {
 }
 
 bool DivEngine::haltAudioFile() {
-  stop();
+  exportHalt=true;
+  // per-channel export doesn't play in this engine
+  if (exportMode!=DIV_EXPORT_MODE_MANY_CHAN) stop();
   return true;
 }
 
-void DivEngine::notifyInsChange(int ins) {
+float DivEngine::getExportProgress() {
+  return exportProgress;
+}
+
+String DivEngine::getExportError() {
+  return exportError;
+}
+
+bool DivEngine::benchmark(DivBenchmarkResult& result, unsigned int bufsize, int loops) {
+  if (output!=NULL && audioEngine!=DIV_AUDIO_DUMMY) {
+    logE("can't benchmark while audio output is running!\n");
+    return false;
+  }
+  // blip_buf can't resample more than blip_max_frame samples at once
+  if (bufsize<1 || bufsize>(unsigned int)blip_max_frame) {
+    logE("invalid buffer size!\n");
+    return false;
+  }
+  if (loops<1) {
+    logE("can't benchmark with infinite loops!\n");
+    return false;
+  }
+
+  std::vector<double> bufTime;
+  float* outBuf[2];
+  outBuf[0]=new float[bufsize];
+  outBuf[1]=new float[bufsize];
+
   isBusy.lock();
+  runCmds();
+  runCmd(DivEngineCmd(DIV_ENGINE_CMD_STOP));
+  repeatPattern=false;
+  runCmd(DivEngineCmd(DIV_ENGINE_CMD_SET_ORDER,0));
+  remainingLoops=loops;
+  playSub(false);
+  // nothing else renders here, so the counters can be cleared right away
+  perfResetPending=false;
+  clearPerfCounters();
+  isBusy.unlock();
+
+  logI("benchmarking...\n");
+
+  size_t frames=0;
+  std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+  while (playing) {
+    std::chrono::steady_clock::time_point bufStart=std::chrono::steady_clock::now();
+    nextBuf(NULL,outBuf,0,2,bufsize);
+    bufTime.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now()-bufStart).count());
+    frames+=totalProcessed;
+  }
+  std::chrono::steady_clock::time_point end=std::chrono::steady_clock::now();
+
+  delete[] outBuf[0];
+  delete[] outBuf[1];
+
+  if (bufTime.empty()) {
+    logE("nothing was rendered!\n");
+    return false;
+  }
+
+  result.rate=got.rate;
+  result.bufsize=bufsize;
+  result.buffers=bufTime.size();
+  result.audioTime=(double)frames/got.rate;
+  result.renderTime=std::chrono::duration<double>(end-start).count();
+  result.bufMean=0;
+  for (double i: bufTime) {
+    result.bufMean+=i;
+  }
+  result.bufMean/=bufTime.size();
+  std::sort(bufTime.begin(),bufTime.end());
+  result.bufP99=bufTime[(bufTime.size()-1)*99/100];
+  result.bufMax=bufTime.back();
+  result.sysTime.clear();
   for (int i=0; i<song.systemLen; i++) {
-    disCont[i].dispatch->notifyInsChange(ins);
+    result.sysTime.push_back((double)disCont[i].perfAcquire.total/1000000000.0);
   }
-  isBusy.unlock();
+  return true;
 }
 
-void DivEngine::notifyWaveChange(int wave) {
-  isBusy.lock();
+void DivEngine::commitPerf() {
+  if (perfResetPending.exchange(false)) {
+    clearPerfCounters();
+    return;
+  }
+  perfBuf.commit();
+  perfTick.commit();
+  perfMix.commit();
   for (int i=0; i<song.systemLen; i++) {
-    disCont[i].dispatch->notifyWaveChange(wave);
+    disCont[i].perfTick.commit();
+    disCont[i].perfAcquire.commit();
+    disCont[i].perfFillBuf.commit();
   }
-  isBusy.unlock();
+}
+
+const DivPerfCounter* DivEngine::getPerfCounter(DivPerfStages stage, int sys) {
+  switch (stage) {
+    case DIV_PERF_BUFFER:
+      return &perfBuf;
+    case DIV_PERF_TICK:
+      return &perfTick;
+    case DIV_PERF_MIX:
+      return &perfMix;
+    default:
+      break;
+  }
+  if (sys<0 || sys>=song.systemLen) return NULL;
+  switch (stage) {
+    case DIV_PERF_SYS_TICK:
+      return &disCont[sys].perfTick;
+    case DIV_PERF_SYS_ACQUIRE:
+      return &disCont[sys].perfAcquire;
+    case DIV_PERF_SYS_FILL_BUF:
+      return &disCont[sys].perfFillBuf;
+    default:
+      break;
+  }
+  return NULL;
+}
+
+void DivEngine::getPerfLoad(float& avg, float& peak) {
+  avg=0;
+  peak=0;
+  if (got.rate<1 || got.bufsize<1) return;
+  double bufTime=1000000000.0*(double)got.bufsize/got.rate;
+  avg=(double)perfBuf.avg/bufTime;
+  peak=(double)perfBuf.peak/bufTime;
+}
+
+void DivEngine::resetPerfCounters() {
+  perfResetPending=true;
+}
+
+void DivEngine::clearPerfCounters() {
+  perfBuf.reset();
+  perfTick.reset();
+  perfMix.reset();
+  for (int i=0; i<32; i++) {
+    disCont[i].perfTick.reset();
+    disCont[i].perfAcquire.reset();
+    disCont[i].perfFillBuf.reset();
+  }
+}
+
+void DivEngine::notifyInsChange(int ins) {
+  postCmd(DivEngineCmd(DIV_ENGINE_CMD_INS_CHANGE,ins));
+}
+
+void DivEngine::notifyWaveChange(int wave) {
+  postCmd(DivEngineCmd(DIV_ENGINE_CMD_WAVE_CHANGE,wave));
 }
 
 void DivEngine::renderSamplesP() {
-  isBusy.lock();
-  renderSamples();
-  isBusy.unlock();
+  // give the audio thread a moment to pick up the previous render, so that
+  // its memory can be reused.
+  for (int i=0; i<100; i++) {
+    freeSampleRenders();
+    if (sampleRendersPending<=0) break;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  postCmd(DivEngineCmd(DIV_ENGINE_CMD_SWAP_SAMPLES,0,0,0,0,prepareSampleRender()));
 }
 
 void DivEngine::renderSamples() {
-  sPreview.sample=-1;
-  sPreview.pos=0;
+  // anything still queued is out of date now
+  sampleRenderGen++;
+  applySampleRender(prepareSampleRender());
+}
+
+DivSampleRender* DivEngine::prepareSampleRender() {
+  freeSampleRenders();
+  DivSampleRender* r=sampleRenderSpare;
+  sampleRenderSpare=NULL;
+  if (r==NULL) r=new DivSampleRender;
+  r->gen=sampleRenderGen;
+  sampleRendersPending++;
 
   // step 1: render samples
   for (int i=0; i<song.sampleLen; i++) {
-    song.sample[i]->render();
+    DivSample* source=song.sample[i];
+    DivSample* s=new DivSample;
+    s->depth=source->depth;
+    s->samples=source->samples;
+    if (s->initInternal(s->depth,s->samples) && source->getCurBuf()!=NULL) {
+      memcpy(s->getCurBuf(),source->getCurBuf(),MIN(s->getCurBufLen(),source->getCurBufLen()));
+    }
+    s->render();
+    r->source.push_back(source);
+    r->sample.push_back(s);
   }
 
   // step 2: allocate ADPCM-A samples
-  if (adpcmAMem==NULL) adpcmAMem=new unsigned char[16777216];
+  if (r->adpcmAMem==NULL) r->adpcmAMem=new unsigned char[16777216];
 
   size_t memPos=0;
   for (int i=0; i<song.sampleLen; i++) {
-    DivSample* s=song.sample[i];
+    DivSample* s=r->sample[i];
     int paddedLen=(s->lengthA+255)&(~0xff);
     if ((memPos&0xf00000)!=((memPos+paddedLen)&0xf00000)) {
       memPos=(memPos+0xfffff)&0xf00000;
@@ -465,22 +733,22 @@ void DivEngine::renderSamples() {
       break;
     }
     if (memPos+paddedLen>=16777216) {
-      memcpy(adpcmAMem+memPos,s->dataA,16777216-memPos);
+      memcpy(r->adpcmAMem+memPos,s->dataA,16777216-memPos);
       logW("out of ADPCM-A memory for sample %d!\n",i);
     } else {
-      memcpy(adpcmAMem+memPos,s->dataA,paddedLen);
+      memcpy(r->adpcmAMem+memPos,s->dataA,paddedLen);
     }
     s->offA=memPos;
     memPos+=paddedLen;
   }
-  adpcmAMemLen=memPos+256;
+  r->adpcmAMemLen=memPos+256;
 
   // step 2: allocate ADPCM-B samples
-  if (adpcmBMem==NULL) adpcmBMem=new unsigned char[16777216];
+  if (r->adpcmBMem==NULL) r->adpcmBMem=new unsigned char[16777216];
 
   memPos=0;
   for (int i=0; i<song.sampleLen; i++) {
-    DivSample* s=song.sample[i];
+    DivSample* s=r->sample[i];
     int paddedLen=(s->lengthB+255)&(~0xff);
     if ((memPos&0xf00000)!=((memPos+paddedLen)&0xf00000)) {
       memPos=(memPos+0xfffff)&0xf00000;
@@ -490,23 +758,23 @@ void DivEngine::renderSamples() {
       break;
     }
     if (memPos+paddedLen>=16777216) {
-      memcpy(adpcmBMem+memPos,s->dataB,16777216-memPos);
+      memcpy(r->adpcmBMem+memPos,s->dataB,16777216-memPos);
       logW("out of ADPCM-B memory for sample %d!\n",i);
     } else {
-      memcpy(adpcmBMem+memPos,s->dataB,paddedLen);
+      memcpy(r->adpcmBMem+memPos,s->dataB,paddedLen);
     }
     s->offB=memPos;
     memPos+=paddedLen;
   }
-  adpcmBMemLen=memPos+256;
+  r->adpcmBMemLen=memPos+256;
 
   // step 4: allocate qsound pcm samples
-  if (qsoundMem==NULL) qsoundMem=new unsigned char[16777216];
-  memset(qsoundMem,0,16777216);
+  if (r->qsoundMem==NULL) r->qsoundMem=new unsigned char[16777216];
+  memset(r->qsoundMem,0,16777216);
 
   memPos=0;
   for (int i=0; i<song.sampleLen; i++) {
-    DivSample* s=song.sample[i];
+    DivSample* s=r->sample[i];
     int length=s->length8;
     if (length>65536-16) {
       length=65536-16;
@@ -520,18 +788,70 @@ void DivEngine::renderSamples() {
     }
     if (memPos+length>=16777216) {
       for (unsigned int i=0; i<16777216-(memPos+length); i++) {
-        qsoundMem[(memPos+i)^0x8000]=s->data8[i];
+        r->qsoundMem[(memPos+i)^0x8000]=s->data8[i];
       }
       logW("out of QSound PCM memory for sample %d!\n",i);
     } else {
       for (int i=0; i<length; i++) {
-        qsoundMem[(memPos+i)^0x8000]=s->data8[i];
+        r->qsoundMem[(memPos+i)^0x8000]=s->data8[i];
       }
     }
     s->offQSound=memPos^0x8000;
     memPos+=length+16;
   }
-  qsoundMemLen=memPos+256;
+  r->qsoundMemLen=memPos+256;
+  return r;
+}
+
+void DivEngine::applySampleRender(DivSampleRender* r) {
+  bool valid=(r->gen==sampleRenderGen && (int)r->sample.size()==song.sampleLen);
+  if (valid) for (int i=0; i<song.sampleLen; i++) {
+    DivSample* s=song.sample[i];
+    if (s!=r->source[i] || s->depth!=r->sample[i]->depth || s->samples!=r->sample[i]->samples) {
+      valid=false;
+      break;
+    }
+  }
+
+  if (valid) {
+    sPreview.sample=-1;
+    sPreview.pos=0;
+    for (int i=0; i<song.sampleLen; i++) {
+      song.sample[i]->swapRendered(r->sample[i]);
+    }
+    std::swap(adpcmAMem,r->adpcmAMem);
+    std::swap(adpcmAMemLen,r->adpcmAMemLen);
+    std::swap(adpcmBMem,r->adpcmBMem);
+    std::swap(adpcmBMemLen,r->adpcmBMemLen);
+    std::swap(qsoundMem,r->qsoundMem);
+    std::swap(qsoundMemLen,r->qsoundMemLen);
+  }
+  // otherwise it's out of date and is discarded.
+
+  // hand it back (along with the old data) to be freed. this runs on the
+  // audio thread, so don't log here. the queue can't fill up, since
+  // prepareSampleRender() empties it before every render.
+  sampleRenderDone.push(r);
+}
+
+void DivEngine::freeSampleRenders() {
+  DivSampleRender* r;
+  while (sampleRenderDone.pop(r)) {
+    sampleRendersPending--;
+    for (DivSample* i: r->sample) {
+      delete i;
+    }
+    r->source.clear();
+    r->sample.clear();
+    if (sampleRenderSpare==NULL) {
+      sampleRenderSpare=r;
+    } else {
+      if (r->adpcmAMem!=NULL) delete[] r->adpcmAMem;
+      if (r->adpcmBMem!=NULL) delete[] r->adpcmBMem;
+      if (r->qsoundMem!=NULL) delete[] r->qsoundMem;
+      delete r;
+    }
+  }
 }
 
 void DivEngine::createNew(const int* description) {
@@ -539,6 +859,7 @@ void DivEngine::createNew(const int* description) {
   isBusy.lock();
   song.unload();
   song=DivSong();
+  timeline.valid=false;
   if (description!=NULL) {
     if (description[0]!=0) {
       int index=0;
@@ -703,6 +1024,327 @@ void DivEngine::getCommandStream(std::vector<DivCommand>& where) {
   isBusy.unlock();
 }
 
+DivPlaybackSnapshot* DivEngine::takeSnapshot(bool withTime) {
+  DivPlaybackSnapshot* snap=new DivPlaybackSnapshot;
+  snap->chan.assign(chan,chan+chans);
+  for (int i=0; i<song.systemLen; i++) {
+    snap->dispatchState[i]=disCont[i].dispatch->getState();
+  }
+  snap->ticks=ticks;
+  snap->curRow=curRow;
+  snap->curOrder=curOrder;
+  snap->nextSpeed=nextSpeed;
+  snap->divider=divider;
+  snap->cycles=cycles;
+  snap->clockDrift=clockDrift;
+  snap->changeOrd=changeOrd;
+  snap->changePos=changePos;
+  snap->globalPitch=globalPitch;
+  snap->extValue=extValue;
+  snap->speed1=speed1;
+  snap->speed2=speed2;
+  snap->arpLen=song.arpLen;
+  snap->speedAB=speedAB;
+  snap->endOfSong=endOfSong;
+  snap->extValuePresent=extValuePresent;
+  snap->hasTime=withTime;
+  if (withTime) {
+    snap->totalSeconds=totalSeconds;
+    snap->totalTicks=totalTicks;
+    snap->totalTicksR=totalTicksR;
+  }
+  return snap;
+}
+
+void DivEngine::restoreSnapshot(DivPlaybackSnapshot* snap, bool withTime) {
+  for (size_t i=0; i<snap->chan.size(); i++) {
+    chan[i]=snap->chan[i];
+  }
+  for (int i=0; i<song.systemLen; i++) {
+    disCont[i].dispatch->setState(snap->dispatchState[i]);
+  }
+  ticks=snap->ticks;
+  curRow=snap->curRow;
+  curOrder=snap->curOrder;
+  nextSpeed=snap->nextSpeed;
+  divider=snap->divider;
+  cycles=snap->cycles;
+  clockDrift=snap->clockDrift;
+  changeOrd=snap->changeOrd;
+  changePos=snap->changePos;
+  globalPitch=snap->globalPitch;
+  extValue=snap->extValue;
+  speed1=snap->speed1;
+  speed2=snap->speed2;
+  song.arpLen=snap->arpLen;
+  speedAB=snap->speedAB;
+  endOfSong=snap->endOfSong;
+  extValuePresent=snap->extValuePresent;
+  if (withTime) {
+    totalSeconds=snap->totalSeconds;
+    totalTicks=snap->totalTicks;
+    totalTicksR=snap->totalTicksR;
+  }
+}
+
+void DivEngine::freeSnapshot(DivPlaybackSnapshot* snap) {
+  for (int i=0; i<song.systemLen; i++) {
+    if (disCont[i].dispatch!=NULL) disCont[i].dispatch->freeState(snap->dispatchState[i]);
+  }
+  delete snap;
+}
+
+void DivEngine::clearKeyframes() {
+  for (auto& i: keyframes) {
+    freeSnapshot(i.second);
+  }
+  keyframes.clear();
+}
+
+void DivEngine::storeKeyframe(bool withTime) {
+  auto existing=keyframes.find(curOrder);
+  if (existing==keyframes.end()) {
+    keyframes[curOrder]=takeSnapshot(withTime);
+  } else if (withTime && !existing->second->hasTime) {
+    freeSnapshot(existing->second);
+    existing->second=takeSnapshot(true);
+  }
+}
+
+void DivEngine::notifySongChange() {
+  postCmd(DivEngineCmd(DIV_ENGINE_CMD_SONG_CHANGE));
+}
+
+void DivEngine::notifyPatternChange(int chan, int pat) {
+  // not queued, so the event stream and timeline are up to date as soon
+  // as this returns. playback never has to rebuild them.
+  if (chan<0 || chan>=DIV_MAX_CHANS || pat<0 || pat>=128) return;
+  isBusy.lock();
+  if (song.pat[chan].data[pat]!=NULL) {
+    song.pat[chan].data[pat]->compileEvents();
+  }
+  cutTimeline(chan,pat);
+  isBusy.unlock();
+}
+
+void DivEngine::postCmd(const DivEngineCmd& c) {
+  cmdQueueLock.lock();
+  // these may replay the song up to the new position (see playSub()),
+  // which takes too long for the audio callback. it plays silence instead
+  // while they run here.
+  bool seeks=(c.cmd==DIV_ENGINE_CMD_PLAY || c.cmd==DIV_ENGINE_CMD_PLAY_TO_ROW || c.cmd==DIV_ENGINE_CMD_STEP_ONE || c.cmd==DIV_ENGINE_CMD_SET_ORDER);
+  if (!audioRunning || seeks || !cmdQueue.push(c)) {
+    // nobody is draining the queue (or it is full). run it here.
+    isBusy.lock();
+    runCmds();
+    runCmd(c);
+    isBusy.unlock();
+  }
+  cmdQueueLock.unlock();
+}
+
+void DivEngine::runCmds() {
+  DivEngineCmd c;
+  while (cmdQueue.pop(c)) {
+    runCmd(c);
+  }
+}
+
+void DivEngine::runCmd(const DivEngineCmd& c) {
+  switch (c.cmd) {
+    case DIV_ENGINE_CMD_NOTE_ON:
+    case DIV_ENGINE_CMD_NOTE_OFF:
+      // the song may have changed since
+      if (c.value>=chans) break;
+      if (c.cmd==DIV_ENGINE_CMD_NOTE_ON) {
+        pendingNotes.push(DivNoteEvent(c.value,c.value2,c.value3,c.value4,true));
+      } else {
+        pendingNotes.push(DivNoteEvent(c.value,-1,-1,-1,false));
+      }
+      if (!playing) {
+        reset();
+        freelance=true;
+        playing=true;
+      }
+      break;
+    case DIV_ENGINE_CMD_PLAY:
+      sPreview.sample=-1;
+      sPreview.wave=-1;
+      sPreview.pos=0;
+      if (stepPlay==0) {
+        freelance=false;
+        playSub(false);
+      } else {
+        stepPlay=0;
+      }
+      for (int i=0; i<DIV_MAX_CHANS; i++) {
+        keyHit[i]=false;
+      }
+      break;
+    case DIV_ENGINE_CMD_PLAY_TO_ROW:
+      sPreview.sample=-1;
+      sPreview.wave=-1;
+      sPreview.pos=0;
+      freelance=false;
+      playSub(false,c.value);
+      for (int i=0; i<DIV_MAX_CHANS; i++) {
+        keyHit[i]=false;
+      }
+      break;
+    case DIV_ENGINE_CMD_STEP_ONE:
+      if (!isPlaying()) {
+        freelance=false;
+        playSub(false,c.value);
+        for (int i=0; i<DIV_MAX_CHANS; i++) {
+          keyHit[i]=false;
+        }
+      }
+      stepPlay=2;
+      ticks=1;
+      break;
+    case DIV_ENGINE_CMD_STOP:
+      freelance=false;
+      playing=false;
+      extValuePresent=false;
+      stepPlay=0;
+      remainingLoops=-1;
+      sPreview.sample=-1;
+      sPreview.wave=-1;
+      sPreview.pos=0;
+      break;
+    case DIV_ENGINE_CMD_SET_ORDER:
+      curOrder=c.value;
+      if (c.value>=song.ordersLen) curOrder=0;
+      if (playing && !freelance) {
+        playSub(false);
+      }
+      break;
+    case DIV_ENGINE_CMD_SET_REPEAT_PATTERN:
+      repeatPattern=c.value;
+      break;
+    case DIV_ENGINE_CMD_SYNC_RESET:
+      reset();
+      break;
+    case DIV_ENGINE_CMD_HALT:
+      halted=true;
+      break;
+    case DIV_ENGINE_CMD_RESUME:
+      halted=false;
+      haltOn=DIV_HALT_NONE;
+      break;
+    case DIV_ENGINE_CMD_HALT_WHEN:
+      halted=false;
+      haltOn=(DivHaltPositions)c.value;
+      break;
+    case DIV_ENGINE_CMD_MUTE:
+      if (c.value>=chans) break;
+      isMuted[c.value]=c.value2;
+      if (disCont[dispatchOfChan[c.value]].dispatch!=NULL) {
+        disCont[dispatchOfChan[c.value]].dispatch->muteChannel(dispatchChanOfChan[c.value],isMuted[c.value]);
+      }
+      break;
+    case DIV_ENGINE_CMD_TOGGLE_MUTE:
+      runCmd(DivEngineCmd(DIV_ENGINE_CMD_MUTE,c.value,!isMuted[c.value]));
+      break;
+    case DIV_ENGINE_CMD_TOGGLE_SOLO: {
+      bool solo=false;
+      for (int i=0; i<chans; i++) {
+        if (i==c.value) {
+          solo=true;
+          continue;
+        } else {
+          if (!isMuted[i]) {
+            solo=false;
+            break;
+          }
+        }
+      }
+      for (int i=0; i<chans; i++) {
+        isMuted[i]=solo?false:(i!=c.value);
+        if (disCont[dispatchOfChan[i]].dispatch!=NULL) {
+          disCont[dispatchOfChan[i]].dispatch->muteChannel(dispatchChanOfChan[i],isMuted[i]);
+        }
+      }
+      break;
+    }
+    case DIV_ENGINE_CMD_UNMUTE_ALL:
+      for (int i=0; i<chans; i++) {
+        isMuted[i]=false;
+        if (disCont[dispatchOfChan[i]].dispatch!=NULL) {
+          disCont[dispatchOfChan[i]].dispatch->muteChannel(dispatchChanOfChan[i],isMuted[i]);
+        }
+      }
+      break;
+    case DIV_ENGINE_CMD_INS_CHANGE:
+      clearKeyframes();
+      for (int i=0; i<song.systemLen; i++) {
+        disCont[i].dispatch->notifyInsChange(c.value);
+      }
+      break;
+    case DIV_ENGINE_CMD_WAVE_CHANGE:
+      clearKeyframes();
+      for (int i=0; i<song.systemLen; i++) {
+        disCont[i].dispatch->notifyWaveChange(c.value);
+      }
+      break;
+    case DIV_ENGINE_CMD_SONG_CHANGE:
+      clearKeyframes();
+      break;
+    case DIV_ENGINE_CMD_PREVIEW_SAMPLE: {
+      int sample=c.value;
+      int note=c.value2;
+      if (sample<0 || sample>=(int)song.sample.size()) {
+        sPreview.sample=-1;
+        sPreview.pos=0;
+        break;
+      }
+      blip_clear(samp_bb);
+      double rate=song.sample[sample]->rate;
+      if (note>=0) {
+        rate=(song.tuning*pow(2.0,(double)(note+3)/12.0)*((double)song.sample[sample]->centerRate/8363.0));
+        if (rate<=0) rate=song.sample[sample]->rate;
+      }
+      blip_set_rates(samp_bb,rate,got.rate);
+      samp_prevSample=0;
+      sPreview.pos=0;
+      sPreview.sample=sample;
+      sPreview.wave=-1;
+      break;
+    }
+    case DIV_ENGINE_CMD_STOP_SAMPLE_PREVIEW:
+      sPreview.sample=-1;
+      sPreview.pos=0;
+      break;
+    case DIV_ENGINE_CMD_PREVIEW_WAVE: {
+      int wave=c.value;
+      int note=c.value2;
+      if (wave<0 || wave>=(int)song.wave.size()) {
+        sPreview.wave=-1;
+        sPreview.pos=0;
+        break;
+      }
+      if (song.wave[wave]->len<=0) {
+        break;
+      }
+      blip_clear(samp_bb);
+      blip_set_rates(samp_bb,song.wave[wave]->len*((song.tuning*0.0625)*pow(2.0,(double)(note+3)/12.0)),got.rate);
+      samp_prevSample=0;
+      sPreview.pos=0;
+      sPreview.sample=-1;
+      sPreview.wave=wave;
+      break;
+    }
+    case DIV_ENGINE_CMD_STOP_WAVE_PREVIEW:
+      sPreview.wave=-1;
+      sPreview.pos=0;
+      break;
+    case DIV_ENGINE_CMD_SWAP_SAMPLES:
+      clearKeyframes();
+      applySampleRender((DivSampleRender*)c.data);
+      break;
+  }
+}
+
 void DivEngine::playSub(bool preserveDrift, int goalRow) {
   for (int i=0; i<song.systemLen; i++) disCont[i].dispatch->setSkipRegisterWrites(false);
   reset();
@@ -727,9 +1369,27 @@ void DivEngine::playSub(bool preserveDrift, int goalRow) {
   }
   speedAB=false;
   playing=true;
+  // resume from the closest keyframe instead of replaying from the start.
+  // a keyframe without time counters can only be used when preserving them.
+  auto kf=keyframes.upper_bound(goal);
+  while (kf!=keyframes.begin()) {
+    --kf;
+    if (preserveDrift || kf->second->hasTime) {
+      restoreSnapshot(kf->second,!preserveDrift);
+      break;
+    }
+  }
+  // keyframes are only valid as long as the song hasn't jumped back
+  bool canStore=!endOfSong && pendingNotes.empty();
+  int lastKeyOrder=curOrder;
   for (int i=0; i<song.systemLen; i++) disCont[i].dispatch->setSkipRegisterWrites(true);
   while (playing && curOrder<goal) {
     if (nextTick(preserveDrift)) return;
+    if (endOfSong) canStore=false;
+    if (canStore && playing && curOrder>lastKeyOrder) {
+      lastKeyOrder=curOrder;
+      storeKeyframe(!preserveDrift);
+    }
   }
   int oldOrder=curOrder;
   while (playing && curRow<goalRow) {
@@ -775,80 +1435,31 @@ int DivEngine::calcFreq(int base, int pitch, bool period, int octave) {
 }
 
 void DivEngine::play() {
-  isBusy.lock();
-  sPreview.sample=-1;
-  sPreview.wave=-1;
-  sPreview.pos=0;
-  if (stepPlay==0) {
-    freelance=false;
-    playSub(false);
-  } else {
-    stepPlay=0;
-  }
-  for (int i=0; i<DIV_MAX_CHANS; i++) {
-    keyHit[i]=false;
-  }
-  isBusy.unlock();
+  postCmd(DivEngineCmd(DIV_ENGINE_CMD_PLAY));
 }
 
 void DivEngine::playToRow(int row) {
-  isBusy.lock();
-  sPreview.sample=-1;
-  sPreview.wave=-1;
-  sPreview.pos=0;
-  freelance=false;
-  playSub(false,row);
-  for (int i=0; i<DIV_MAX_CHANS; i++) {
-    keyHit[i]=false;
-  }
-  isBusy.unlock();
+  postCmd(DivEngineCmd(DIV_ENGINE_CMD_PLAY_TO_ROW,row));
 }
 
 void DivEngine::stepOne(int row) {
-  isBusy.lock();
-  if (!isPlaying()) {
-    freelance=false;
-    playSub(false,row);
-    for (int i=0; i<DIV_MAX_CHANS; i++) {
-      keyHit[i]=false;
-    }
-  }
-  stepPlay=2;
-  ticks=1;
-  isBusy.unlock();
+  postCmd(DivEngineCmd(DIV_ENGINE_CMD_STEP_ONE,row));
 }
 
 void DivEngine::stop() {
-  isBusy.lock();
-  freelance=false;
-  playing=false;
-  extValuePresent=false;
-  stepPlay=0;
-  remainingLoops=-1;
-  sPreview.sample=-1;
-  sPreview.wave=-1;
-  sPreview.pos=0;
-  isBusy.unlock();
+  postCmd(DivEngineCmd(DIV_ENGINE_CMD_STOP));
 }
 
 void DivEngine::halt() {
-  isBusy.lock();
-  halted=true;
-  isBusy.unlock();
+  postCmd(DivEngineCmd(DIV_ENGINE_CMD_HALT));
 }
 
 void DivEngine::resume() {
-  isBusy.lock();
-  halted=false;
-  haltOn=DIV_HALT_NONE;
-  isBusy.unlock();
+  postCmd(DivEngineCmd(DIV_ENGINE_CMD_RESUME));
 }
 
 void DivEngine::haltWhen(DivHaltPositions when) {
-  isBusy.lock();
-  halted=false;
-  haltOn=when;
-  isBusy.unlock();
+  postCmd(DivEngineCmd(DIV_ENGINE_CMD_HALT_WHEN,when));
 }
 
 bool DivEngine::isHalted() {
@@ -904,9 +1515,7 @@ void DivEngine::reset() {
 }
 
 void DivEngine::syncReset() {
-  isBusy.lock();
-  reset();
-  isBusy.unlock();
+  postCmd(DivEngineCmd(DIV_ENGINE_CMD_SYNC_RESET));
 }
 
 const int sampleRates[6]={
@@ -958,60 +1567,19 @@ int DivEngine::getEffectiveSampleRate(int rate) {
 }
 
 void DivEngine::previewSample(int sample, int note) {
-  isBusy.lock();
-  if (sample<0 || sample>=(int)song.sample.size()) {
-    sPreview.sample=-1;
-    sPreview.pos=0;
-    isBusy.unlock();
-    return;
-  }
-  blip_clear(samp_bb);
-  double rate=song.sample[sample]->rate;
-  if (note>=0) {
-    rate=(song.tuning*pow(2.0,(double)(note+3)/12.0)*((double)song.sample[sample]->centerRate/8363.0));
-    if (rate<=0) rate=song.sample[sample]->rate;
-  }
-  blip_set_rates(samp_bb,rate,got.rate);
-  samp_prevSample=0;
-  sPreview.pos=0;
-  sPreview.sample=sample;
-  sPreview.wave=-1;
-  isBusy.unlock();
+  postCmd(DivEngineCmd(DIV_ENGINE_CMD_PREVIEW_SAMPLE,sample,note));
 }
 
 void DivEngine::stopSamplePreview() {
-  isBusy.lock();
-  sPreview.sample=-1;
-  sPreview.pos=0;
-  isBusy.unlock();
+  postCmd(DivEngineCmd(DIV_ENGINE_CMD_STOP_SAMPLE_PREVIEW));
 }
 
 void DivEngine::previewWave(int wave, int note) {
-  isBusy.lock();
-  if (wave<0 || wave>=(int)song.wave.size()) {
-    sPreview.wave=-1;
-    sPreview.pos=0;
-    isBusy.unlock();
-    return;
-  }
-  if (song.wave[wave]->len<=0) {
-    isBusy.unlock();
-    return;
-  }
-  blip_clear(samp_bb);
-  blip_set_rates(samp_bb,song.wave[wave]->len*((song.tuning*0.0625)*pow(2.0,(double)(note+3)/12.0)),got.rate);
-  samp_prevSample=0;
-  sPreview.pos=0;
-  sPreview.sample=-1;
-  sPreview.wave=wave;
-  isBusy.unlock();
+  postCmd(DivEngineCmd(DIV_ENGINE_CMD_PREVIEW_WAVE,wave,note));
 }
 
 void DivEngine::stopWavePreview() {
-  isBusy.lock();
-  sPreview.wave=-1;
-  sPreview.pos=0;
-  isBusy.unlock();
+  postCmd(DivEngineCmd(DIV_ENGINE_CMD_STOP_WAVE_PREVIEW));
 }
 
 String DivEngine::getConfigPath() {
@@ -1066,9 +1634,7 @@ bool DivEngine::getRepeatPattern() {
 }
 
 void DivEngine::setRepeatPattern(bool value) {
-  isBusy.lock();
-  repeatPattern=value;
-  isBusy.unlock();
+  postCmd(DivEngineCmd(DIV_ENGINE_CMD_SET_REPEAT_PATTERN,value));
 }
 
 bool DivEngine::hasExtValue() {
@@ -1092,59 +1658,19 @@ bool DivEngine::isChannelMuted(int chan) {
 }
 
 void DivEngine::toggleMute(int chan) {
-  muteChannel(chan,!isMuted[chan]);
+  postCmd(DivEngineCmd(DIV_ENGINE_CMD_TOGGLE_MUTE,chan));
 }
 
 void DivEngine::toggleSolo(int chan) {
-  bool solo=false;
-  for (int i=0; i<chans; i++) {
-    if (i==chan) {
-      solo=true;
-      continue;
-    } else {
-      if (!isMuted[i]) {
-        solo=false;
-        break;
-      }
-    }
-  }
-  isBusy.lock();
-  if (!solo) {
-    for (int i=0; i<chans; i++) {
-      isMuted[i]=(i!=chan);
-      if (disCont[dispatchOfChan[i]].dispatch!=NULL) {
-        disCont[dispatchOfChan[i]].dispatch->muteChannel(dispatchChanOfChan[i],isMuted[i]);
-      }
-    }
-  } else {
-    for (int i=0; i<chans; i++) {
-      isMuted[i]=false;
-      if (disCont[dispatchOfChan[i]].dispatch!=NULL) {
-        disCont[dispatchOfChan[i]].dispatch->muteChannel(dispatchChanOfChan[i],isMuted[i]);
-      }
-    }
-  }
-  isBusy.unlock();
+  postCmd(DivEngineCmd(DIV_ENGINE_CMD_TOGGLE_SOLO,chan));
 }
 
 void DivEngine::muteChannel(int chan, bool mute) {
-  isBusy.lock();
-  isMuted[chan]=mute;
-  if (disCont[dispatchOfChan[chan]].dispatch!=NULL) {
-    disCont[dispatchOfChan[chan]].dispatch->muteChannel(dispatchChanOfChan[chan],isMuted[chan]);
-  }
-  isBusy.unlock();
+  postCmd(DivEngineCmd(DIV_ENGINE_CMD_MUTE,chan,mute));
 }
 
 void DivEngine::unmuteAll() {
-  isBusy.lock();
-  for (int i=0; i<chans; i++) {
-    isMuted[i]=false;
-    if (disCont[dispatchOfChan[i]].dispatch!=NULL) {
-      disCont[dispatchOfChan[i]].dispatch->muteChannel(dispatchChanOfChan[i],isMuted[i]);
-    }
-  }
-  isBusy.unlock();
+  postCmd(DivEngineCmd(DIV_ENGINE_CMD_UNMUTE_ALL));
 }
 
 int DivEngine::addInstrument(int refChan) {
@@ -1631,6 +2157,7 @@ bool DivEngine::addInstrumentFromFile(const char* path) {
 
 void DivEngine::delInstrument(int index) {
   isBusy.lock();
+  clearKeyframes();
   if (index>=0 && index<(int)song.ins.size()) {
     for (int i=0; i<song.systemLen; i++) {
       disCont[i].dispatch->notifyInsDeletion(song.ins[index]);
@@ -1641,11 +2168,12 @@ void DivEngine::delInstrument(int index) {
     for (int i=0; i<chans; i++) {
       for (int j=0; j<128; j++) {
         if (song.pat[i].data[j]==NULL) continue;
-        for (int k=0; k<song.patLen; k++) {
+        for (int k=0; k<song.pat[i].data[j]->data.rows; k++) {
           if (song.pat[i].data[j]->data[k][2]>index) {
             song.pat[i].data[j]->data[k][2]--;
           }
         }
+        song.pat[i].data[j]->compileEvents();
       }
     }
   }
@@ -1782,6 +2310,7 @@ bool DivEngine::addWaveFromFile(const char* path) {
 
 void DivEngine::delWave(int index) {
   isBusy.lock();
+  clearKeyframes();
   if (index>=0 && index<(int)song.wave.size()) {
     delete song.wave[index];
     song.wave.erase(song.wave.begin()+index);
@@ -1883,6 +2412,7 @@ bool DivEngine::addSampleFromFile(const char* path) {
 
 void DivEngine::delSample(int index) {
   isBusy.lock();
+  clearKeyframes();
   if (index>=0 && index<(int)song.sample.size()) {
     delete song.sample[index];
     song.sample.erase(song.sample.begin()+index);
@@ -1896,6 +2426,7 @@ void DivEngine::addOrder(bool duplicate, bool where) {
   unsigned char order[DIV_MAX_CHANS];
   if (song.ordersLen>=0x7e) return;
   isBusy.lock();
+  clearKeyframes();
   if (duplicate) {
     for (int i=0; i<DIV_MAX_CHANS; i++) {
       order[i]=song.orders.ord[i][curOrder];
@@ -1937,11 +2468,33 @@ void DivEngine::addOrder(bool duplicate, bool where) {
   isBusy.unlock();
 }
 
+void DivEngine::setPatLen(int len) {
+  if (len<1) len=1;
+  if (len>DIV_MAX_ROWS) len=DIV_MAX_ROWS;
+  isBusy.lock();
+  song.patLen=len;
+  for (int i=0; i<DIV_MAX_CHANS; i++) {
+    song.pat[i].resizePatterns(len);
+  }
+  isBusy.unlock();
+}
+
+void DivEngine::setEffectRows(int chan, int rows) {
+  if (chan<0 || chan>=DIV_MAX_CHANS) return;
+  if (rows<1) rows=1;
+  if (rows>8) rows=8;
+  isBusy.lock();
+  song.pat[chan].effectRows=rows;
+  song.pat[chan].resizePatterns(song.patLen);
+  isBusy.unlock();
+}
+
 void DivEngine::deepCloneOrder(bool where) {
   unsigned char order[DIV_MAX_CHANS];
   if (song.ordersLen>=0x7e) return;
   warnings="";
   isBusy.lock();
+  clearKeyframes();
   for (int i=0; i<chans; i++) {
     bool didNotFind=true;
     logD("channel %d\n",i);
@@ -1954,7 +2507,10 @@ void DivEngine::deepCloneOrder(bool where) {
         order[i]=j;
         DivPattern* oldPat=song.pat[i].getPattern(origOrd,false);
         DivPattern* pat=song.pat[i].getPattern(j,true);
-        memcpy(pat->data,oldPat->data,256*32*sizeof(short));
+        for (int k=0; k<pat->data.rows; k++) {
+          memcpy(pat->data[k],oldPat->data[k],pat->data.cols*sizeof(short));
+        }
+        pat->compileEvents();
         logD("found at %d\n",j);
         didNotFind=false;
         break;
@@ -1988,6 +2544,7 @@ void DivEngine::deepCloneOrder(bool where) {
 void DivEngine::deleteOrder() {
   if (song.ordersLen<=1) return;
   isBusy.lock();
+  clearKeyframes();
   for (int i=0; i<DIV_MAX_CHANS; i++) {
     for (int j=curOrder; j<song.ordersLen; j++) {
       song.orders.ord[i][j]=song.orders.ord[i][j+1];
@@ -2003,6 +2560,7 @@ void DivEngine::deleteOrder() {
 
 void DivEngine::moveOrderUp() {
   isBusy.lock();
+  clearKeyframes();
   if (curOrder<1) {
     isBusy.unlock();
     return;
@@ -2021,6 +2579,7 @@ void DivEngine::moveOrderUp() {
 
 void DivEngine::moveOrderDown() {
   isBusy.lock();
+  clearKeyframes();
   if (curOrder>=song.ordersLen-1) {
     isBusy.unlock();
     return;
@@ -2041,13 +2600,14 @@ void DivEngine::exchangeIns(int one, int two) {
   for (int i=0; i<chans; i++) {
     for (int j=0; j<128; j++) {
       if (song.pat[i].data[j]==NULL) continue;
-      for (int k=0; k<song.patLen; k++) {
+      for (int k=0; k<song.pat[i].data[j]->data.rows; k++) {
         if (song.pat[i].data[j]->data[k][2]==one) {
           song.pat[i].data[j]->data[k][2]=two;
         } else if (song.pat[i].data[j]->data[k][2]==two) {
           song.pat[i].data[j]->data[k][2]=one;
         }
       }
+      song.pat[i].data[j]->compileEvents();
     }
   }
 }
@@ -2055,6 +2615,7 @@ void DivEngine::exchangeIns(int one, int two) {
 bool DivEngine::moveInsUp(int which) {
   if (which<1 || which>=(int)song.ins.size()) return false;
   isBusy.lock();
+  clearKeyframes();
   DivInstrument* prev=song.ins[which];
   song.ins[which]=song.ins[which-1];
   song.ins[which-1]=prev;
@@ -2066,6 +2627,7 @@ bool DivEngine::moveInsUp(int which) {
 bool DivEngine::moveWaveUp(int which) {
   if (which<1 || which>=(int)song.wave.size()) return false;
   isBusy.lock();
+  clearKeyframes();
   DivWavetable* prev=song.wave[which];
   song.wave[which]=song.wave[which-1];
   song.wave[which-1]=prev;
@@ -2076,6 +2638,7 @@ bool DivEngine::moveWaveUp(int which) {
 bool DivEngine::moveSampleUp(int which) {
   if (which<1 || which>=(int)song.sample.size()) return false;
   isBusy.lock();
+  clearKeyframes();
   DivSample* prev=song.sample[which];
   song.sample[which]=song.sample[which-1];
   song.sample[which-1]=prev;
@@ -2086,6 +2649,7 @@ bool DivEngine::moveSampleUp(int which) {
 bool DivEngine::moveInsDown(int which) {
   if (which<0 || which>=((int)song.ins.size())-1) return false;
   isBusy.lock();
+  clearKeyframes();
   DivInstrument* prev=song.ins[which];
   song.ins[which]=song.ins[which+1];
   song.ins[which+1]=prev;
@@ -2097,6 +2661,7 @@ bool DivEngine::moveInsDown(int which) {
 bool DivEngine::moveWaveDown(int which) {
   if (which<0 || which>=((int)song.wave.size())-1) return false;
   isBusy.lock();
+  clearKeyframes();
   DivWavetable* prev=song.wave[which];
   song.wave[which]=song.wave[which+1];
   song.wave[which+1]=prev;
@@ -2107,6 +2672,7 @@ bool DivEngine::moveWaveDown(int which) {
 bool DivEngine::moveSampleDown(int which) {
   if (which<0 || which>=((int)song.sample.size())-1) return false;
   isBusy.lock();
+  clearKeyframes();
   DivSample* prev=song.sample[which];
   song.sample[which]=song.sample[which+1];
   song.sample[which+1]=prev;
@@ -2116,40 +2682,21 @@ bool DivEngine::moveSampleDown(int which) {
 
 void DivEngine::noteOn(int chan, int ins, int note, int vol) {
   if (chan<0 || chan>=chans) return;
-  isBusy.lock();
-  pendingNotes.push(DivNoteEvent(chan,ins,note,vol,true));
-  if (!playing) {
-    reset();
-    freelance=true;
-    playing=true;
-  }
-  isBusy.unlock();
+  postCmd(DivEngineCmd(DIV_ENGINE_CMD_NOTE_ON,chan,ins,note,vol));
 }
 
 void DivEngine::noteOff(int chan) {
   if (chan<0 || chan>=chans) return;
-  isBusy.lock();
-  pendingNotes.push(DivNoteEvent(chan,-1,-1,-1,false));
-  if (!playing) {
-    reset();
-    freelance=true;
-    playing=true;
-  }
-  isBusy.unlock();
+  postCmd(DivEngineCmd(DIV_ENGINE_CMD_NOTE_OFF,chan));
 }
 
 void DivEngine::setOrder(unsigned char order) {
-  isBusy.lock();
-  curOrder=order;
-  if (order>=song.ordersLen) curOrder=0;
-  if (playing && !freelance) {
-    playSub(false);
-  }
-  isBusy.unlock();
+  postCmd(DivEngineCmd(DIV_ENGINE_CMD_SET_ORDER,order));
 }
 
 void DivEngine::setSysFlags(int system, unsigned int flags, bool restart) {
   isBusy.lock();
+  clearKeyframes();
   song.systemFlags[system]=flags;
   disCont[system].dispatch->setFlags(song.systemFlags[system]);
   disCont[system].setRates(got.rate);
@@ -2161,6 +2708,7 @@ void DivEngine::setSysFlags(int system, unsigned int flags, bool restart) {
 
 void DivEngine::setSongRate(int hz, bool pal) {
   isBusy.lock();
+  clearKeyframes();
   song.pal=!pal;
   song.hz=hz;
   song.customTempo=(song.hz!=50 && song.hz!=60);
@@ -2181,6 +2729,10 @@ void DivEngine::setAudio(DivAudioEngines which) {
   audioEngine=which;
 }
 
+void DivEngine::setRenderThreads(int count) {
+  forcePoolThreads=count;
+}
+
 void DivEngine::setView(DivStatusView which) {
   view=which;
 }
@@ -2239,7 +2791,9 @@ void DivEngine::rescanAudioDevices() {
 void DivEngine::initDispatch() {
   isBusy.lock();
   for (int i=0; i<song.systemLen; i++) {
-    disCont[i].init(song.system[i],this,getChannelCount(song.system[i]),got.rate,song.systemFlags[i]);
+    disCont[i].init(song.system[i],this,getChannelCount(song.system[i]),got.rate,song.systemFlags[i],maxBufSize);
+    disCont[i].sysIndex=i;
+    disCont[i].sysName=getSystemName(song.system[i]);
     disCont[i].setRates(got.rate);
     disCont[i].setQuality(lowQuality);
   }
@@ -2249,6 +2803,8 @@ void DivEngine::initDispatch() {
 
 void DivEngine::quitDispatch() {
   isBusy.lock();
+  runCmds();
+  clearKeyframes();
   for (int i=0; i<song.systemLen; i++) {
     disCont[i].quit();
   }
@@ -2318,6 +2874,18 @@ bool DivEngine::initAudioBackend() {
 
   lowQuality=getConfInt("audioQuality",0);
   forceMono=getConfInt("forceMono",0);
+  renderAhead=getConfInt("renderAhead",0);
+  if (renderAhead<0) renderAhead=0;
+  if (renderAhead>32) renderAhead=32;
+
+  int newPoolThreads=(forcePoolThreads>=0)?forcePoolThreads:getConfInt("renderPoolThreads",0);
+  if (newPoolThreads<0) newPoolThreads=0;
+  if (newPoolThreads>32) newPoolThreads=32;
+  if (newPoolThreads!=renderPoolThreads) {
+    renderPool.quit();
+    renderPool.init(newPoolThreads);
+    renderPoolThreads=newPoolThreads;
+  }
 
   switch (audioEngine) {
     case DIV_AUDIO_JACK:
@@ -2362,6 +2930,21 @@ bool DivEngine::initAudioBackend() {
     return false;
   }
 
+  // the dummy backend never calls back
+  cmdQueueLock.lock();
+  audioRunning=(audioEngine!=DIV_AUDIO_DUMMY);
+  cmdQueueLock.unlock();
+
+  if (renderAhead>0 && audioEngine!=DIV_AUDIO_DUMMY) {
+    logD("rendering %d buffers ahead\n",renderAhead);
+    renderAheadSize=got.bufsize;
+    renderRing[0].init((renderAhead+1)*renderAheadSize);
+    renderRing[1].init((renderAhead+1)*renderAheadSize);
+    renderStarted=false;
+    renderQuit=false;
+    renderThread=new std::thread(_runRenderThread,this);
+  }
+
   return true;
 }
 
@@ -2372,6 +2955,24 @@ bool DivEngine::deinitAudioBackend() {
     output=NULL;
     audioEngine=DIV_AUDIO_NULL;
   }
+  if (renderThread!=NULL) {
+    renderLock.lock();
+    renderQuit=true;
+    renderLock.unlock();
+    renderWake.notify_one();
+    renderThread->join();
+    delete renderThread;
+    renderThread=NULL;
+    renderRing[0].quit();
+    renderRing[1].quit();
+  }
+  cmdQueueLock.lock();
+  audioRunning=false;
+  cmdQueueLock.unlock();
+  // run whatever the audio thread didn't get to
+  isBusy.lock();
+  runCmds();
+  isBusy.unlock();
   return true;
 }
 
@@ -2421,16 +3022,30 @@ bool DivEngine::init() {
     haveAudio=true;
   }
 
-  samp_bb=blip_new(32768);
+  if (!initState()) return false;
+
+  if (!haveAudio) {
+    return false;
+  } else {
+    if (!output->setRun(true)) {
+      logE("error while activating!\n");
+      return false;
+    }
+  }
+  return true;
+}
+
+bool DivEngine::initState() {
+  samp_bb=blip_new(maxBufSize);
   if (samp_bb==NULL) {
     logE("not enough memory!\n");
     return false;
   }
 
-  samp_bbOut=new short[32768];
+  samp_bbOut=new short[maxBufSize];
 
-  samp_bbIn=new short[32768];
-  samp_bbInLen=32768;
+  samp_bbIn=new short[maxBufSize];
+  samp_bbInLen=maxBufSize;
   
   blip_set_rates(samp_bb,44100,got.rate);
 
@@ -2443,27 +3058,71 @@ bool DivEngine::init() {
     keyHit[i]=false;
   }
 
-  oscBuf[0]=new float[32768];
-  oscBuf[1]=new float[32768];
+  oscBuf[0]=new float[maxBufSize];
+  oscBuf[1]=new float[maxBufSize];
 
   initDispatch();
   reset();
   active=true;
-
-  if (!haveAudio) {
-    return false;
-  } else {
-    if (!output->setRun(true)) {
-      logE("error while activating!\n");
-      return false;
-    }
-  }
   return true;
 }
 
+bool DivEngine::initClone(DivEngine* parent, const unsigned char* songData, size_t len) {
+  // songData is shared between clones and only read from
+  if (!loadData(songData,len)) return false;
+  audioEngine=DIV_AUDIO_DUMMY;
+  got=parent->got;
+  maxBufSize=EXPORT_BUFSIZE;
+  lowQuality=parent->lowQuality;
+  forceMono=parent->forceMono;
+  // the clone is only driven by its export thread
+  exporting=true;
+  return initState();
+}
+
+void DivEngine::quitClone() {
+  quitDispatch();
+  freeSampleRenders();
+  if (sampleRenderSpare!=NULL) {
+    if (sampleRenderSpare->adpcmAMem!=NULL) delete[] sampleRenderSpare->adpcmAMem;
+    if (sampleRenderSpare->adpcmBMem!=NULL) delete[] sampleRenderSpare->adpcmBMem;
+    if (sampleRenderSpare->qsoundMem!=NULL) delete[] sampleRenderSpare->qsoundMem;
+    delete sampleRenderSpare;
+    sampleRenderSpare=NULL;
+  }
+  if (adpcmAMem!=NULL) delete[] adpcmAMem;
+  if (adpcmBMem!=NULL) delete[] adpcmBMem;
+  if (qsoundMem!=NULL) delete[] qsoundMem;
+  adpcmAMem=NULL;
+  adpcmBMem=NULL;
+  qsoundMem=NULL;
+  if (samp_bb!=NULL) {
+    blip_delete(samp_bb);
+    samp_bb=NULL;
+  }
+  delete[] samp_bbIn;
+  delete[] samp_bbOut;
+  delete[] oscBuf[0];
+  delete[] oscBuf[1];
+  if (metroTick!=NULL) delete[] metroTick;
+  metroTick=NULL;
+  song.unload();
+  active=false;
+}
+
 bool DivEngine::quit() {
   deinitAudioBackend();
   quitDispatch();
+  renderPool.quit();
+  renderPoolThreads=0;
+  freeSampleRenders();
+  if (sampleRenderSpare!=NULL) {
+    if (sampleRenderSpare->adpcmAMem!=NULL) delete[] sampleRenderSpare->adpcmAMem;
+    if (sampleRenderSpare->adpcmBMem!=NULL) delete[] sampleRenderSpare->adpcmBMem;
+    if (sampleRenderSpare->qsoundMem!=NULL) delete[] sampleRenderSpare->qsoundMem;
+    delete sampleRenderSpare;
+    sampleRenderSpare=NULL;
+  }
   logI("saving config.\n");
   saveConf();
   active=false;
@@ -25,8 +25,14 @@
 #include "safeWriter.h"
 #include "../audio/taAudio.h"
 #include "blip_buf.h"
+#include "workPool.h"
+#include "lockFreeQueue.h"
+#include "perfCounter.h"
+#include "trace.h"
+#include <atomic>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 #include <map>
 #include <queue>
 
@@ -67,6 +73,19 @@ enum DivHaltPositions {
   DIV_HALT_BREAKPOINT
 };
 
+enum DivPerfStages {
+  // the whole of nextBuf()
+  DIV_PERF_BUFFER=0,
+  // nextTick(), including system ticks
+  DIV_PERF_TICK,
+  // mixing systems into the output
+  DIV_PERF_MIX,
+  // per-system stages
+  DIV_PERF_SYS_TICK,
+  DIV_PERF_SYS_ACQUIRE,
+  DIV_PERF_SYS_FILL_BUF
+};
+
 struct DivChannelState {
   std::vector<DivDelayedCommand> delayed;
   int note, oldNote, pitch, portaSpeed, portaNote;
@@ -129,32 +148,250 @@ struct DivNoteEvent {
     on(o) {}
 };
 
+enum DivEngineCmds {
+  DIV_ENGINE_CMD_NOTE_ON=0, // (chan, ins, note, vol)
+  DIV_ENGINE_CMD_NOTE_OFF, // (chan)
+  DIV_ENGINE_CMD_PLAY,
+  DIV_ENGINE_CMD_PLAY_TO_ROW, // (row)
+  DIV_ENGINE_CMD_STEP_ONE, // (row)
+  DIV_ENGINE_CMD_STOP,
+  DIV_ENGINE_CMD_SET_ORDER, // (order)
+  DIV_ENGINE_CMD_SET_REPEAT_PATTERN, // (value)
+  DIV_ENGINE_CMD_SYNC_RESET,
+  DIV_ENGINE_CMD_HALT,
+  DIV_ENGINE_CMD_RESUME,
+  DIV_ENGINE_CMD_HALT_WHEN, // (when)
+  DIV_ENGINE_CMD_MUTE, // (chan, mute)
+  DIV_ENGINE_CMD_TOGGLE_MUTE, // (chan)
+  DIV_ENGINE_CMD_TOGGLE_SOLO, // (chan)
+  DIV_ENGINE_CMD_UNMUTE_ALL,
+  DIV_ENGINE_CMD_INS_CHANGE, // (ins)
+  DIV_ENGINE_CMD_WAVE_CHANGE, // (wave)
+  DIV_ENGINE_CMD_SONG_CHANGE,
+  DIV_ENGINE_CMD_PREVIEW_SAMPLE, // (sample, note)
+  DIV_ENGINE_CMD_STOP_SAMPLE_PREVIEW,
+  DIV_ENGINE_CMD_PREVIEW_WAVE, // (wave, note)
+  DIV_ENGINE_CMD_STOP_WAVE_PREVIEW,
+  DIV_ENGINE_CMD_SWAP_SAMPLES // (data: DivSampleRender*)
+};
+
+// a request from another thread, executed by the audio thread at the start
+// of the next buffer.
+struct DivEngineCmd {
+  DivEngineCmds cmd;
+  int value, value2, value3, value4;
+  void* data;
+  DivEngineCmd(DivEngineCmds c=DIV_ENGINE_CMD_STOP, int v=0, int v2=0, int v3=0, int v4=0, void* d=NULL):
+    cmd(c),
+    value(v),
+    value2(v2),
+    value3(v3),
+    value4(v4),
+    data(d) {}
+};
+
+// samples and sample memories rendered away from the audio thread.
+// the audio thread swaps them with the current ones and hands this back with
+// the old data, which is then freed or reused by the next render.
+struct DivSampleRender {
+  // the song samples these were rendered from
+  std::vector<DivSample*> source;
+  std::vector<DivSample*> sample;
+  unsigned char* adpcmAMem;
+  size_t adpcmAMemLen;
+  unsigned char* adpcmBMem;
+  size_t adpcmBMemLen;
+  unsigned char* qsoundMem;
+  size_t qsoundMemLen;
+  int gen;
+
+  DivSampleRender():
+    adpcmAMem(NULL),
+    adpcmAMemLen(0),
+    adpcmBMem(NULL),
+    adpcmBMemLen(0),
+    qsoundMem(NULL),
+    qsoundMemLen(0),
+    gen(0) {}
+};
+
+// playback state at the start of an order.
+// used to seek without replaying the song from the beginning.
+struct DivPlaybackSnapshot {
+  std::vector<DivChannelState> chan;
+  void* dispatchState[32];
+  int ticks, curRow, curOrder, nextSpeed, divider, cycles, clockDrift;
+  int changeOrd, changePos, totalSeconds, totalTicks, totalTicksR, globalPitch;
+  unsigned char extValue, speed1, speed2, arpLen;
+  bool speedAB, endOfSong, extValuePresent;
+  // whether the time counters are valid (they aren't when taken during a loop)
+  bool hasTime;
+
+  DivPlaybackSnapshot():
+    dispatchState{NULL},
+    ticks(0),
+    curRow(0),
+    curOrder(0),
+    nextSpeed(3),
+    divider(60),
+    cycles(0),
+    clockDrift(0),
+    changeOrd(-1),
+    changePos(0),
+    totalSeconds(0),
+    totalTicks(0),
+    totalTicksR(0),
+    globalPitch(0),
+    extValue(0),
+    speed1(3),
+    speed2(3),
+    arpLen(1),
+    speedAB(false),
+    endOfSong(false),
+    extValuePresent(false),
+    hasTime(false) {}
+};
+
+// a row in the song timeline, with the timing state when it starts.
+struct DivTimelineRow {
+  // seconds since the start of the song
+  double time;
+  int order, row, divider;
+  unsigned char speed1, speed2;
+  bool speedAB;
+};
+
+// the rows of the song in play order, up to where it ends or loops.
+// it is built on demand, and cut back to the first row of an order using a
+// pattern when that pattern is edited.
+struct DivTimeline {
+  std::vector<DivTimelineRow> rows;
+  // (order<<8)|row -> index in rows, or -1 if not reached yet
+  std::vector<int> rowIndex;
+  // the row after the last one in rows
+  DivTimelineRow next;
+  // whether rows holds the whole song
+  bool complete;
+  // whether the song stops (FFxx) instead of looping
+  bool stops;
+  // where playback goes after the end, and the order it jumps back from
+  // (-1 if it runs past the last order instead)
+  int loopOrder, loopRow, loopEnd;
+  // time at which the song ends or loops
+  double duration;
+  // song settings it was built for
+  bool valid;
+  int patLen, ordersLen, chans, timeBase, hz;
+  unsigned char speed1, speed2;
+  bool pal, customTempo;
+  unsigned char effectRows[DIV_MAX_CHANS];
+  DivOrders orders;
+
+  DivTimeline():
+    complete(false),
+    stops(false),
+    loopOrder(0),
+    loopRow(0),
+    loopEnd(-1),
+    duration(0.0),
+    valid(false),
+    patLen(0),
+    ordersLen(0),
+    chans(0),
+    timeBase(0),
+    hz(0),
+    speed1(0),
+    speed2(0),
+    pal(false),
+    customTempo(false) {}
+};
+
 struct DivDispatchContainer {
   DivDispatch* dispatch;
   blip_buffer_t* bb[2];
-  size_t bbInLen;
+  size_t bbInLen, bbOutLen;
   int temp[2], prevSample[2];
   short* bbIn[2];
   short* bbOut[2];
   bool lowQuality;
+  // output of dispatches which render with acquireDirect()
+  DivDeltaBuf deltaBuf;
+  // bbIn is only rendered up to here. the rest holds the last output level
+  size_t activeLen;
+  // systems at the same rate which are resampled together in this
+  // container's blip buffers. see DivEngine::nextBuf().
+  // members don't resample on their own, so their bbOut is freed meanwhile.
+  DivDispatchContainer* groupMembers[32];
+  short groupVol[32][2];
+  int groupLen;
+  // the sum is scaled down by 2^(groupShift-12) to fit in 16-bit
+  int groupShift;
+  int* groupIn[2];
+  size_t groupInLen;
+  int groupPrev[2];
+  size_t jobRunTotal, jobOffset, jobSize;
+  DivPerfCounter perfTick, perfAcquire, perfFillBuf;
+  // for trace spans
+  int sysIndex;
+  const char* sysName;
 
   void setRates(double gotRate);
   void setQuality(bool lowQual);
   void acquire(size_t offset, size_t count);
   void flush(size_t count);
   void fillBuf(size_t runtotal, size_t offset, size_t size);
+  void fillGroupBuf(size_t runtotal, size_t offset, size_t size);
+  void joinGroup();
+  void leaveGroup();
+  void queueAcquire(DivWorkPool& pool, size_t offset, size_t count);
+  void queueFillBuf(DivWorkPool& pool, size_t runtotal, size_t offset, size_t size);
+  void queueFillGroupBuf(DivWorkPool& pool, size_t runtotal, size_t offset, size_t size);
   void clear();
-  void init(DivSystem sys, DivEngine* eng, int chanCount, double gotRate, unsigned int flags);
+  void init(DivSystem sys, DivEngine* eng, int chanCount, double gotRate, unsigned int flags, size_t bufSize=32768);
   void quit();
   DivDispatchContainer():
     dispatch(NULL),
     bb{NULL,NULL},
     bbInLen(0),
+    bbOutLen(0),
     temp{0,0},
     prevSample{0,0},
     bbIn{NULL,NULL},
     bbOut{NULL,NULL},
-    lowQuality(false) {}
+    lowQuality(false),
+    activeLen(0),
+    groupLen(0),
+    groupShift(12),
+    groupIn{NULL,NULL},
+    groupInLen(0),
+    groupPrev{0,0},
+    jobRunTotal(0),
+    jobOffset(0),
+    jobSize(0),
+    sysIndex(0),
+    sysName("") {}
+};
+
+struct DivBenchmarkResult {
+  double rate;
+  unsigned int bufsize;
+  size_t buffers;
+  // seconds of audio rendered, and how long it took
+  double audioTime, renderTime;
+  // time per buffer
+  double bufMean, bufP99, bufMax;
+  // time spent in each system's acquire()
+  std::vector<double> sysTime;
+
+  DivBenchmarkResult():
+    rate(0),
+    bufsize(0),
+    buffers(0),
+    audioTime(0),
+    renderTime(0),
+    bufMean(0),
+    bufP99(0),
+    bufMax(0) {}
 };
 
 class DivEngine {
@@ -163,9 +400,12 @@ class DivEngine {
   TAAudioDesc want, got;
   String exportPath;
   std::thread* exportThread;
+  std::thread* renderThread;
   int chans;
   bool active;
   bool lowQuality;
+  // cleared by the export thread while nextBuf may be running
+  std::atomic<bool> shareBlip;
   bool playing;
   bool freelance;
   bool speedAB;
@@ -181,6 +421,10 @@ class DivEngine {
   int ticks, curRow, curOrder, remainingLoops, nextSpeed, divider;
   int cycles, clockDrift, stepPlay;
   int changeOrd, changePos, totalSeconds, totalTicks, totalTicksR, totalCmds, lastCmds, cmdsPerSecond, globalPitch;
+  int renderPoolThreads, forcePoolThreads;
+  // number of buffers rendered ahead of the audio callback. 0 disables.
+  int renderAhead;
+  unsigned int renderAheadSize;
   unsigned char extValue;
   unsigned char speed1, speed2;
   DivStatusView view;
@@ -190,8 +434,45 @@ class DivEngine {
   DivAudioExportModes exportMode;
   std::map<String,String> conf;
   std::queue<DivNoteEvent> pendingNotes;
+  // see postCmd(). the audio thread only ever pops from cmdQueue and pushes to
+  // sampleRenderDone.
+  DivLockFreeQueue<DivEngineCmd,1024> cmdQueue;
+  DivLockFreeQueue<DivSampleRender*,1024> sampleRenderDone;
+  // serializes producers. never taken by the audio thread.
+  std::mutex cmdQueueLock;
+  // whether an audio callback is running and draining cmdQueue.
+  // only changed with cmdQueueLock held.
+  bool audioRunning;
+  DivSampleRender* sampleRenderSpare;
+  int sampleRenderGen, sampleRendersPending;
+  // order -> playback state when first reaching that order
+  std::map<int,DivPlaybackSnapshot*> keyframes;
+  DivTimeline timeline;
   bool isMuted[DIV_MAX_CHANS];
   std::mutex isBusy;
+  DivWorkPool renderPool;
+  // render-ahead mode: renderThread runs nextBuf and fills these, and the
+  // audio callback only copies out of them.
+  DivLockFreeRing<float> renderRing[2];
+  std::mutex renderLock;
+  std::condition_variable renderWake;
+  std::atomic<bool> renderStarted, renderQuit;
+  // export state. exportSong is a copy of the song for cloned engines.
+  unsigned char* exportSong;
+  size_t exportSongLen;
+  int exportLoops;
+  // length of the export in seconds, including loops (0 if unknown)
+  double exportLength;
+  std::atomic<int> exportNextChan, exportChansDone;
+  std::atomic<bool> exportHalt;
+  std::atomic<float> exportProgress;
+  String exportError;
+  // largest buffer nextBuf may be asked for. clones only render export blocks.
+  unsigned int maxBufSize;
+  DivPerfCounter perfBuf, perfTick, perfMix;
+  // set by resetPerfCounters(). the counters are cleared by commitPerf(),
+  // on the thread that updates them.
+  std::atomic<bool> perfResetPending;
   String configPath;
   String configFile;
   String lastError;
@@ -236,11 +517,53 @@ class DivEngine {
   bool perSystemPostEffect(int ch, unsigned char effect, unsigned char effectVal);
   void recalcChans();
   void renderSamples();
+  DivSampleRender* prepareSampleRender();
+  void applySampleRender(DivSampleRender* r);
+  void freeSampleRenders();
+  void commitPerf();
+  void clearPerfCounters();
+  // set up this engine to render a copy of parent's song for export.
+  // songData is only read from and stays with the caller. the copy has no audio
+  // output and doesn't use config.
+  bool initClone(DivEngine* parent, const unsigned char* songData, size_t len);
+  void quitClone();
+  // allocations and state shared by init() and initClone()
+  bool initState();
+  // how much of the song has been played so far, from 0 to 1
+  float getRenderProgress(int loops);
   void reset();
   void playSub(bool preserveDrift, int goalRow=0);
 
-  bool loadDMF(unsigned char* file, size_t len);
-  bool loadFur(unsigned char* file, size_t len);
+  DivPlaybackSnapshot* takeSnapshot(bool withTime);
+  void restoreSnapshot(DivPlaybackSnapshot* snap, bool withTime);
+  void freeSnapshot(DivPlaybackSnapshot* snap);
+  void clearKeyframes();
+  // store a keyframe for the current order if there isn't one yet.
+  // only call this while playSub() replays the song with register writes
+  // skipped; dispatch state taken during normal playback differs from it.
+  void storeKeyframe(bool withTime);
+  // these shall be called with isBusy locked.
+  // start the timeline over if the song settings changed.
+  void checkTimeline();
+  // add the next row to the timeline. returns false once it is complete.
+  bool stepTimeline();
+  // drop the timeline from the first row using a pattern onwards.
+  void cutTimeline(int chan, int pat);
+  double getRowTimeUnlocked(int order, int row);
+
+  // queue a command for the audio thread, or run it now if there isn't one.
+  // seeks always run on the calling thread.
+  void postCmd(const DivEngineCmd& c);
+  // these shall be called with isBusy locked.
+  void runCmd(const DivEngineCmd& c);
+  void runCmds();
+
+  bool loadDMF(const unsigned char* file, size_t len);
+  bool loadFur(const unsigned char* file, size_t len);
+  // load a song from memory (compressed or not). f is not taken over.
+  bool loadData(const unsigned char* f, size_t length);
+  // load an uncompressed song. file is not taken over.
+  bool loadSong(const unsigned char* file, size_t len);
 
   bool initAudioBackend();
   bool deinitAudioBackend();
@@ -257,14 +580,21 @@ class DivEngine {
     float oscSize;
 
     void runExportThread();
+    // render channel stems in a cloned engine until none are left
+    void runExportChanJob();
+    void runRenderThread();
+    // audio callback. renders or copies from the render-ahead buffer.
+    void processAudio(float** in, float** out, int inChans, int outChans, unsigned int size);
     void nextBuf(float** in, float** out, int inChans, int outChans, unsigned int size);
     DivInstrument* getIns(int index);
     DivWavetable* getWave(int index);
     DivSample* getSample(int index);
     // start fresh
     void createNew(const int* description);
-    // load a file.
+    // load a file. f is deleted afterwards.
     bool load(unsigned char* f, size_t length);
+    // load a file from disk by mapping it into memory.
+    bool loadFile(const char* path);
     // save as .dmf.
     SafeWriter* saveDMF(unsigned char version);
     // save as .fur.
@@ -273,17 +603,38 @@ class DivEngine {
     // specify system to build ROM for.
     SafeWriter* buildROM(int sys);
     // dump to VGM.
-    SafeWriter* saveVGM(bool* sysToExport=NULL, bool loop=true);
+    // if f is not NULL, the data is written to it as it is generated.
+    SafeWriter* saveVGM(bool* sysToExport=NULL, bool loop=true, FILE* f=NULL);
+    // dump to a VGM file. it is written next to the destination first and
+    // only moved over it once complete. on failure getLastError() says why.
+    bool saveVGMFile(const char* path, bool* sysToExport=NULL, bool loop=true);
     // export to an audio file
     bool saveAudio(const char* path, int loops, DivAudioExportModes mode);
     // wait for audio export to finish
     void waitAudioFile();
+    // get audio export progress, from 0 to 1
+    float getExportProgress();
+    // get the error which stopped the last audio export, if any
+    String getExportError();
     // stop audio file export
     bool haltAudioFile();
+    // render the song as fast as possible and measure how long it takes
+    bool benchmark(DivBenchmarkResult& result, unsigned int bufsize, int loops);
+    // get a timing counter. sys is only used by per-system stages.
+    // returns NULL if out of range.
+    const DivPerfCounter* getPerfCounter(DivPerfStages stage, int sys=0);
+    // get the average and peak time spent rendering a buffer, relative to its duration
+    void getPerfLoad(float& avg, float& peak);
+    // reset all timing counters. takes effect at the end of the next buffer.
+    void resetPerfCounters();
     // notify instrument parameter change
     void notifyInsChange(int ins);
     // notify wavetable change
     void notifyWaveChange(int wave);
+    // notify song data change (patterns, orders or song settings)
+    void notifySongChange();
+    // notify pattern data change. must be called after editing a pattern.
+    void notifyPatternChange(int chan, int pat);
 
     // returns whether a system is VGM compatible
     bool isVGMExportable(DivSystem which);
@@ -317,6 +668,15 @@ class DivEngine {
     // find song loop position
     void walkSong(int& loopOrder, int& loopRow, int& loopEnd);
 
+    // get the time (in seconds) at which a row starts. -1 if it is never reached.
+    double getRowTime(int order, int row);
+
+    // find the row playing at a time (in seconds). returns false if the song is over by then.
+    bool getRowAtTime(double time, int& order, int& row);
+
+    // get the time (in seconds) at which the song ends or loops, and where the loop starts (-1 if it doesn't loop).
+    double getSongLength(double* loopStart=NULL);
+
     // play
     void play();
 
@@ -486,6 +846,12 @@ class DivEngine {
     // add order
     void addOrder(bool duplicate, bool where);
 
+    // set the pattern length
+    void setPatLen(int len);
+
+    // set the number of effect columns of a channel
+    void setEffectRows(int chan, int rows);
+
     // deep clone orders
     void deepCloneOrder(bool where);
 
@@ -544,6 +910,9 @@ class DivEngine {
     // set the audio system.
     void setAudio(DivAudioEngines which);
 
+    // set the render pool thread count, overriding the config (-1 uses it).
+    void setRenderThreads(int count);
+
     // set the view mode.
     void setView(DivStatusView which);
 
@@ -636,9 +1005,11 @@ class DivEngine {
     DivEngine():
       output(NULL),
       exportThread(NULL),
+      renderThread(NULL),
       chans(0),
       active(false),
       lowQuality(false),
+      shareBlip(true),
       playing(false),
       freelance(false),
       speedAB(false),
@@ -668,12 +1039,32 @@ class DivEngine {
       totalCmds(0),
       lastCmds(0),
       cmdsPerSecond(0),
+      renderPoolThreads(0),
+      forcePoolThreads(-1),
+      renderAhead(0),
+      renderAheadSize(0),
       extValue(0),
       speed1(3),
       speed2(3),
       view(DIV_STATUS_NOTHING),
       haltOn(DIV_HALT_NONE),
       audioEngine(DIV_AUDIO_NULL),
+      audioRunning(false),
+      sampleRenderSpare(NULL),
+      sampleRenderGen(0),
+      sampleRendersPending(0),
+      renderStarted(false),
+      renderQuit(false),
+      exportSong(NULL),
+      exportSongLen(0),
+      exportLoops(1),
+      exportLength(0.0),
+      exportNextChan(0),
+      exportChansDone(0),
+      exportHalt(false),
+      exportProgress(0.0f),
+      maxBufSize(32768),
+      perfResetPending(false),
       samp_bbInLen(0),
       samp_temp(0),
       samp_prevSample(0),
@@ -19,6 +19,7 @@
 
 #include "engine.h"
 #include "../ta-log.h"
+#include "../fileutils.h"
 #include "song.h"
 #include <zlib.h>
 #include <fmt/printf.h>
@@ -27,20 +28,80 @@
 #define DIV_DMF_MAGIC ".DelekDefleMask."
 #define DIV_FUR_MAGIC "-Furnace module-"
 
-struct InflateBlock {
-  unsigned char* buf;
-  size_t len;
-  size_t blockSize;
-  InflateBlock(size_t s) {
-    buf=new unsigned char[s];
-    len=s;
-    blockSize=0;
+// inflate a whole zlib stream into a buffer which grows as needed.
+// returns the buffer (outLen bytes long), or NULL on error.
+static unsigned char* inflateSong(const unsigned char* in, size_t inLen, size_t& outLen, String& error) {
+  z_stream zl;
+  memset(&zl,0,sizeof(z_stream));
+
+  zl.avail_in=inLen;
+  zl.next_in=(Bytef*)in;
+  zl.zalloc=NULL;
+  zl.zfree=NULL;
+  zl.opaque=NULL;
+
+  int nextErr;
+  nextErr=inflateInit(&zl);
+  if (nextErr!=Z_OK) {
+    if (zl.msg==NULL) {
+      logE("zlib error: unknown! %d\n",nextErr);
+    } else {
+      logE("zlib error: %s\n",zl.msg);
+    }
+    inflateEnd(&zl);
+    error="not a .dmf song";
+    return NULL;
+  }
+
+  // songs usually inflate to a few times their compressed size
+  size_t bufLen=MAX(DIV_READ_SIZE,inLen*4);
+  unsigned char* out=new unsigned char[bufLen];
+  size_t total=0;
+  while (true) {
+    if (total>=bufLen) {
+      unsigned char* newOut=new unsigned char[bufLen*2];
+      memcpy(newOut,out,total);
+      delete[] out;
+      out=newOut;
+      bufLen*=2;
+    }
+    zl.next_out=out+total;
+    zl.avail_out=bufLen-total;
+    size_t avail=zl.avail_out;
+
+    nextErr=inflate(&zl,Z_SYNC_FLUSH);
+    if (nextErr!=Z_OK && nextErr!=Z_STREAM_END) {
+      if (zl.msg==NULL) {
+        logE("zlib error: unknown error! %d\n",nextErr);
+        error="unknown decompression error";
+      } else {
+        logE("zlib inflate: %s\n",zl.msg);
+        error=fmt::sprintf("decompression error: %s",zl.msg);
+      }
+      delete[] out;
+      inflateEnd(&zl);
+      return NULL;
+    }
+    total+=avail-zl.avail_out;
+    if (nextErr==Z_STREAM_END) {
+      break;
+    }
   }
-  ~InflateBlock() {
-    delete[] buf;
-    len=0;
+  nextErr=inflateEnd(&zl);
+  if (nextErr!=Z_OK) {
+    if (zl.msg==NULL) {
+      logE("zlib end error: unknown error! %d\n",nextErr);
+      error="unknown decompression finish error";
+    } else {
+      logE("zlib end: %s\n",zl.msg);
+      error=fmt::sprintf("decompression finish error: %s",zl.msg);
+    }
+    delete[] out;
+    return NULL;
   }
-};
+  outLen=total;
+  return out;
+}
 
 static double samplePitches[11]={
   0.1666666666, 0.2, 0.25, 0.333333333, 0.5,
@@ -48,7 +109,7 @@ static double samplePitches[11]={
   2, 3, 4, 5, 6
 };
 
-bool DivEngine::loadDMF(unsigned char* file, size_t len) {
+bool DivEngine::loadDMF(const unsigned char* file, size_t len) {
   SafeReader reader=SafeReader(file,len);
   warnings="";
   try {
@@ -64,7 +125,6 @@ bool DivEngine::loadDMF(unsigned char* file, size_t len) {
     if (!reader.seek(16,SEEK_SET)) {
       logE("premature end of file!\n");
       lastError="incomplete file";
-      delete[] file;
       return false;
     }
     ds.version=(unsigned char)reader.readC();
@@ -72,7 +132,6 @@ bool DivEngine::loadDMF(unsigned char* file, size_t len) {
     if (ds.version>0x19) {
       logE("this version is not supported by Furnace yet!\n");
       lastError="this version is not supported by Furnace yet";
-      delete[] file;
       return false;
     }
     unsigned char sys=0;
@@ -88,7 +147,6 @@ bool DivEngine::loadDMF(unsigned char* file, size_t len) {
     if (ds.system[0]==DIV_SYSTEM_NULL) {
       logE("invalid system 0x%.2x!",sys);
       lastError="system not supported. running old version?";
-      delete[] file;
       return false;
     }
     
@@ -186,6 +244,14 @@ bool DivEngine::loadDMF(unsigned char* file, size_t len) {
     } else {
       ds.patLen=(unsigned char)reader.readC();
     }
+    if (ds.patLen<1 || ds.patLen>DIV_MAX_ROWS) {
+      logE("invalid pattern length %d!\n",ds.patLen);
+      lastError="file is corrupt or unreadable at pattern length";
+      return false;
+    }
+    for (int i=0; i<DIV_MAX_CHANS; i++) {
+      ds.pat[i].resizePatterns(ds.patLen);
+    }
     ds.ordersLen=(unsigned char)reader.readC();
 
     if (ds.version<20 && ds.version>3) {
@@ -295,7 +361,6 @@ bool DivEngine::loadDMF(unsigned char* file, size_t len) {
         if (ins->fm.ops!=2 && ins->fm.ops!=4) {
           logE("invalid op count %d. did we read it wrong?\n",ins->fm.ops);
           lastError="file is corrupt or unreadable at operators";
-          delete[] file;
           return false;
         }
         ins->fm.ams=reader.readC();
@@ -520,7 +585,6 @@ bool DivEngine::loadDMF(unsigned char* file, size_t len) {
         if (wave->len>33) {
           logE("invalid wave length %d. are we doing something wrong?\n",wave->len);
           lastError="file is corrupt or unreadable at wavetables";
-          delete[] file;
           return false;
         }
         logD("%d length %d\n",i,wave->len);
@@ -547,9 +611,9 @@ bool DivEngine::loadDMF(unsigned char* file, size_t len) {
       if (chan.effectRows>4 || chan.effectRows<1) {
         logE("invalid effect row count %d. are you sure everything is ok?\n",chan.effectRows);
         lastError="file is corrupt or unreadable at effect rows";
-        delete[] file;
         return false;
       }
+      chan.resizePatterns(ds.patLen);
       for (int j=0; j<ds.ordersLen; j++) {
         DivPattern* pat=chan.getPattern(ds.orders.ord[i][j],true);
         for (int k=0; k<ds.patLen; k++) {
@@ -622,7 +686,6 @@ bool DivEngine::loadDMF(unsigned char* file, size_t len) {
       if (length<0) {
         logE("invalid sample length %d. are we doing something wrong?\n",length);
         lastError="file is corrupt or unreadable at samples";
-        delete[] file;
         return false;
       }
       if (ds.version>0x16) {
@@ -720,10 +783,15 @@ bool DivEngine::loadDMF(unsigned char* file, size_t len) {
       ds.system[1]=DIV_SYSTEM_VRC7;
     }
 
+    for (int i=0; i<DIV_MAX_CHANS; i++) {
+      ds.pat[i].compileEvents();
+    }
+
     if (active) quitDispatch();
     isBusy.lock();
     song.unload();
     song=ds;
+    timeline.valid=false;
     recalcChans();
     renderSamples();
     isBusy.unlock();
@@ -734,14 +802,12 @@ bool DivEngine::loadDMF(unsigned char* file, size_t len) {
   } catch (EndOfFileException e) {
     logE("premature end of file!\n");
     lastError="incomplete file";
-    delete[] file;
     return false;
   }
-  delete[] file;
   return true;
 }
 
-bool DivEngine::loadFur(unsigned char* file, size_t len) {
+bool DivEngine::loadFur(const unsigned char* file, size_t len) {
   int insPtr[256];
   int wavePtr[256];
   int samplePtr[256];
@@ -756,7 +822,6 @@ bool DivEngine::loadFur(unsigned char* file, size_t len) {
     if (!reader.seek(16,SEEK_SET)) {
       logE("premature end of file!\n");
       lastError="incomplete file";
-      delete[] file;
       return false;
     }
     ds.version=reader.readS();
@@ -811,7 +876,6 @@ bool DivEngine::loadFur(unsigned char* file, size_t len) {
     if (strcmp(magic,"INFO")!=0) {
       logE("invalid info header!\n");
       lastError="invalid info header!";
-      delete[] file;
       return false;
     }
     reader.readI();
@@ -825,6 +889,11 @@ bool DivEngine::loadFur(unsigned char* file, size_t len) {
     if (ds.hz!=50 && ds.hz!=60) ds.customTempo=true;
 
     ds.patLen=reader.readS();
+    if (ds.patLen<1 || ds.patLen>DIV_MAX_ROWS) {
+      logE("invalid pattern length %d!\n",ds.patLen);
+      lastError="invalid pattern length!";
+      return false;
+    }
     ds.ordersLen=reader.readS();
 
     ds.hilightA=reader.readC();
@@ -995,6 +1064,9 @@ bool DivEngine::loadFur(unsigned char* file, size_t len) {
     for (int i=0; i<tchans; i++) {
       ds.pat[i].effectRows=reader.readC();
     }
+    for (int i=0; i<DIV_MAX_CHANS; i++) {
+      ds.pat[i].resizePatterns(ds.patLen);
+    }
 
     if (ds.version>=39) {
       for (int i=0; i<tchans; i++) {
@@ -1030,7 +1102,6 @@ bool DivEngine::loadFur(unsigned char* file, size_t len) {
       if (ins->readInsData(reader,ds.version)!=DIV_DATA_SUCCESS) {
         lastError="invalid instrument header/data!";
         delete ins;
-        delete[] file;
         return false;
       }
 
@@ -1045,7 +1116,6 @@ bool DivEngine::loadFur(unsigned char* file, size_t len) {
       if (wave->readWaveData(reader,ds.version)!=DIV_DATA_SUCCESS) {
         lastError="invalid wavetable header/data!";
         delete wave;
-        delete[] file;
         return false;
       }
 
@@ -1062,7 +1132,6 @@ bool DivEngine::loadFur(unsigned char* file, size_t len) {
       if (strcmp(magic,"SMPL")!=0) {
         logE("%d: invalid sample header!\n",i);
         lastError="invalid sample header!";
-        delete[] file;
         return false;
       }
       reader.readI();
@@ -1142,7 +1211,6 @@ bool DivEngine::loadFur(unsigned char* file, size_t len) {
       if (strcmp(magic,"PATR")!=0) {
         logE("%x: invalid pattern header!\n",i);
         lastError="invalid pattern header!";
-        delete[] file;
         return false;
       }
       reader.readI();
@@ -1174,10 +1242,15 @@ bool DivEngine::loadFur(unsigned char* file, size_t len) {
       }
     }
 
+    for (int i=0; i<DIV_MAX_CHANS; i++) {
+      ds.pat[i].compileEvents();
+    }
+
     if (active) quitDispatch();
     isBusy.lock();
     song.unload();
     song=ds;
+    timeline.valid=false;
     recalcChans();
     renderSamples();
     isBusy.unlock();
@@ -1188,129 +1261,70 @@ bool DivEngine::loadFur(unsigned char* file, size_t len) {
   } catch (EndOfFileException e) {
     logE("premature end of file!\n");
     lastError="incomplete file";
-    delete[] file;
     return false;
   }
-  delete[] file;
   return true;
 }
 
-bool DivEngine::load(unsigned char* f, size_t slen) {
-  unsigned char* file;
-  size_t len;
+bool DivEngine::loadData(const unsigned char* f, size_t slen) {
   if (slen<16) {
     logE("too small!");
     lastError="file is too small";
-    delete[] f;
     return false;
   }
   if (memcmp(f,DIV_DMF_MAGIC,16)!=0 && memcmp(f,DIV_FUR_MAGIC,16)!=0) {
     logD("loading as zlib...\n");
-    // try zlib
-    z_stream zl;
-    memset(&zl,0,sizeof(z_stream));
-
-    zl.avail_in=slen;
-    zl.next_in=(Bytef*)f;
-    zl.zalloc=NULL;
-    zl.zfree=NULL;
-    zl.opaque=NULL;
-
-    int nextErr;
-    nextErr=inflateInit(&zl);
-    if (nextErr!=Z_OK) {
-      if (zl.msg==NULL) {
-        logE("zlib error: unknown! %d\n",nextErr);
-      } else {
-        logE("zlib error: %s\n",zl.msg);
-      }
-      inflateEnd(&zl);
-      delete[] f;
-      lastError="not a .dmf song";
-      return false;
-    }
-
-    std::vector<InflateBlock*> blocks;
-    while (true) {
-      InflateBlock* ib=new InflateBlock(DIV_READ_SIZE);
-      zl.next_out=ib->buf;
-      zl.avail_out=ib->len;
-
-      nextErr=inflate(&zl,Z_SYNC_FLUSH);
-      if (nextErr!=Z_OK && nextErr!=Z_STREAM_END) {
-        if (zl.msg==NULL) {
-          logE("zlib error: unknown error! %d\n",nextErr);
-          lastError="unknown decompression error";
-        } else {
-          logE("zlib inflate: %s\n",zl.msg);
-          lastError=fmt::sprintf("decompression error: %s",zl.msg);
-        }
-        for (InflateBlock* i: blocks) delete i;
-        blocks.clear();
-        delete ib;
-        inflateEnd(&zl);
-        delete[] f;
-        return false;
-      }
-      ib->blockSize=ib->len-zl.avail_out;
-      blocks.push_back(ib);
-      if (nextErr==Z_STREAM_END) {
-        break;
-      }
-    }
-    nextErr=inflateEnd(&zl);
-    if (nextErr!=Z_OK) {
-      if (zl.msg==NULL) {
-        logE("zlib end error: unknown error! %d\n",nextErr);
-        lastError="unknown decompression finish error";
-      } else {
-        logE("zlib end: %s\n",zl.msg);
-        lastError=fmt::sprintf("decompression finish error: %s",zl.msg);
-      }
-      for (InflateBlock* i: blocks) delete i;
-      blocks.clear();
-      delete[] f;
+    size_t len=0;
+    unsigned char* file=inflateSong(f,slen,len,lastError);
+    if (file==NULL) {
       return false;
     }
-
-    size_t finalSize=0;
-    size_t curSeek=0;
-    for (InflateBlock* i: blocks) {
-      finalSize+=i->blockSize;
-    }
-    if (finalSize<1) {
+    if (len<1) {
       logE("compressed too small!\n");
       lastError="file too small";
-      for (InflateBlock* i: blocks) delete i;
-      blocks.clear();
-      delete[] f;
+      delete[] file;
       return false;
     }
-    file=new unsigned char[finalSize];
-    for (InflateBlock* i: blocks) {
-      memcpy(&file[curSeek],i->buf,i->blockSize);
-      curSeek+=i->blockSize;
-      delete i;
-    }
-    blocks.clear();
-    len=finalSize;
-    delete[] f;
-  } else {
-    logD("loading as uncompressed\n");
-    file=(unsigned char*)f;
-    len=slen;
+    bool ret=loadSong(file,len);
+    delete[] file;
+    return ret;
   }
-  if (memcmp(file,DIV_DMF_MAGIC,16)==0) {
-    return loadDMF(file,len); 
-  } else if (memcmp(file,DIV_FUR_MAGIC,16)==0) {
-    return loadFur(file,len);
+  logD("loading as uncompressed\n");
+  return loadSong(f,slen);
+}
+
+bool DivEngine::loadSong(const unsigned char* file, size_t len) {
+  if (len>=16) {
+    if (memcmp(file,DIV_DMF_MAGIC,16)==0) {
+      return loadDMF(file,len);
+    } else if (memcmp(file,DIV_FUR_MAGIC,16)==0) {
+      return loadFur(file,len);
+    }
   }
   logE("not a valid module!\n");
   lastError="not a compatible song";
-  delete[] file;
   return false;
 }
 
+bool DivEngine::load(unsigned char* f, size_t slen) {
+  bool ret=loadData(f,slen);
+  delete[] f;
+  return ret;
+}
+
+bool DivEngine::loadFile(const char* path) {
+  PSFileMapping m;
+  if (!ps_mapFile(path,m)) {
+    logE("could not open %s: %s\n",path,strerror(errno));
+    lastError=fmt::sprintf("could not open file: %s",strerror(errno));
+    return false;
+  }
+  // the mapping is only read from. sample data is copied out of it once
+  bool ret=loadData(m.data,m.len);
+  ps_unmapFile(m);
+  return ret;
+}
+
 SafeWriter* DivEngine::saveFur() {
   int insPtr[256];
   int wavePtr[256];
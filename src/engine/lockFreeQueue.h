@@ -0,0 +1,150 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2022 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef _LOCKFREEQUEUE_H
+#define _LOCKFREEQUEUE_H
+#include <atomic>
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * a fixed-size single-producer single-consumer ring buffer.
+ * push() shall only be called from one thread and pop() from another one.
+ * neither of them locks or allocates.
+ * size must be a power of two.
+ */
+template<typename T, size_t size> class DivLockFreeQueue {
+  static_assert((size&(size-1))==0,"queue size must be a power of two");
+  T data[size];
+  std::atomic<size_t> readPos, writePos;
+
+  public:
+    /**
+     * add an item. returns false if the queue is full.
+     */
+    bool push(const T& item) {
+      size_t pos=writePos.load(std::memory_order_relaxed);
+      if (pos-readPos.load(std::memory_order_acquire)>=size) return false;
+      data[pos&(size-1)]=item;
+      writePos.store(pos+1,std::memory_order_release);
+      return true;
+    }
+
+    /**
+     * take the oldest item. returns false if the queue is empty.
+     */
+    bool pop(T& item) {
+      size_t pos=readPos.load(std::memory_order_relaxed);
+      if (pos==writePos.load(std::memory_order_acquire)) return false;
+      item=data[pos&(size-1)];
+      readPos.store(pos+1,std::memory_order_release);
+      return true;
+    }
+
+    bool empty() {
+      return readPos.load(std::memory_order_acquire)==writePos.load(std::memory_order_acquire);
+    }
+
+    DivLockFreeQueue():
+      readPos(0),
+      writePos(0) {}
+};
+
+/**
+ * a single-producer single-consumer ring buffer of plain data which is read
+ * and written in blocks. its size is set at runtime.
+ * write() shall only be called from one thread and read() from another one.
+ */
+template<typename T> class DivLockFreeRing {
+  T* data;
+  size_t size;
+  std::atomic<size_t> readPos, writePos;
+
+  public:
+    /**
+     * allocate the buffer. the size is rounded up to a power of two.
+     */
+    void init(size_t minSize) {
+      quit();
+      size=1;
+      while (size<minSize) size<<=1;
+      data=new T[size];
+      readPos=0;
+      writePos=0;
+    }
+
+    void quit() {
+      if (data!=NULL) {
+        delete[] data;
+        data=NULL;
+      }
+      size=0;
+    }
+
+    size_t readable() {
+      return writePos.load(std::memory_order_acquire)-readPos.load(std::memory_order_relaxed);
+    }
+
+    size_t writable() {
+      return size-(writePos.load(std::memory_order_relaxed)-readPos.load(std::memory_order_acquire));
+    }
+
+    /**
+     * write up to count items. returns how many were written.
+     */
+    size_t write(const T* what, size_t count) {
+      size_t pos=writePos.load(std::memory_order_relaxed);
+      size_t avail=size-(pos-readPos.load(std::memory_order_acquire));
+      if (count>avail) count=avail;
+      size_t start=pos&(size-1);
+      size_t first=(start+count>size)?(size-start):count;
+      memcpy(data+start,what,first*sizeof(T));
+      memcpy(data,what+first,(count-first)*sizeof(T));
+      writePos.store(pos+count,std::memory_order_release);
+      return count;
+    }
+
+    /**
+     * read up to count items. returns how many were read.
+     */
+    size_t read(T* where, size_t count) {
+      size_t pos=readPos.load(std::memory_order_relaxed);
+      size_t avail=writePos.load(std::memory_order_acquire)-pos;
+      if (count>avail) count=avail;
+      size_t start=pos&(size-1);
+      size_t first=(start+count>size)?(size-start):count;
+      memcpy(where,data+start,first*sizeof(T));
+      memcpy(where+first,data,(count-first)*sizeof(T));
+      readPos.store(pos+count,std::memory_order_release);
+      return count;
+    }
+
+    DivLockFreeRing():
+      data(NULL),
+      size(0),
+      readPos(0),
+      writePos(0) {}
+
+    ~DivLockFreeRing() {
+      quit();
+    }
+};
+
+#endif
@@ -0,0 +1,192 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2022 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "mix.h"
+
+// SSE2 is part of x86-64, so it needs no flags or runtime checks there
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+#include <emmintrin.h>
+#define DIV_MIX_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define DIV_MIX_NEON
+#endif
+
+void divMixAll(float* outL, float* outR, float* oscL, float* oscR, const DivMixSource* src, int count, bool mono, size_t len) {
+  size_t i=0;
+#if defined(DIV_MIX_SSE2)
+  __m128 half=_mm_set1_ps(0.5f);
+  for (; i+8<=len; i+=8) {
+    __m128 l0=_mm_loadu_ps(outL+i);
+    __m128 l1=_mm_loadu_ps(outL+i+4);
+    __m128 r0=_mm_loadu_ps(outR+i);
+    __m128 r1=_mm_loadu_ps(outR+i+4);
+    for (int j=0; j<count; j++) {
+      const DivMixSource& s=src[j];
+      __m128 gl=_mm_set1_ps(s.gainL);
+      __m128 gr=_mm_set1_ps(s.gainR);
+      __m128i a16=_mm_loadu_si128((const __m128i*)(s.inL+i));
+      // sign-extend by unpacking into the high half and shifting back
+      __m128 a0=_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(a16,a16),16));
+      __m128 a1=_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(a16,a16),16));
+      __m128 b0=a0;
+      __m128 b1=a1;
+      if (s.inR!=NULL) {
+        __m128i b16=_mm_loadu_si128((const __m128i*)(s.inR+i));
+        b0=_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(b16,b16),16));
+        b1=_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(b16,b16),16));
+      }
+      l0=_mm_add_ps(l0,_mm_mul_ps(a0,gl));
+      l1=_mm_add_ps(l1,_mm_mul_ps(a1,gl));
+      r0=_mm_add_ps(r0,_mm_mul_ps(b0,gr));
+      r1=_mm_add_ps(r1,_mm_mul_ps(b1,gr));
+    }
+    _mm_storeu_ps(oscL+i,l0);
+    _mm_storeu_ps(oscL+i+4,l1);
+    _mm_storeu_ps(oscR+i,r0);
+    _mm_storeu_ps(oscR+i+4,r1);
+    if (mono) {
+      l0=_mm_mul_ps(_mm_add_ps(l0,r0),half);
+      l1=_mm_mul_ps(_mm_add_ps(l1,r1),half);
+      r0=l0;
+      r1=l1;
+    }
+    _mm_storeu_ps(outL+i,l0);
+    _mm_storeu_ps(outL+i+4,l1);
+    _mm_storeu_ps(outR+i,r0);
+    _mm_storeu_ps(outR+i+4,r1);
+  }
+#elif defined(DIV_MIX_NEON)
+  for (; i+8<=len; i+=8) {
+    float32x4_t l0=vld1q_f32(outL+i);
+    float32x4_t l1=vld1q_f32(outL+i+4);
+    float32x4_t r0=vld1q_f32(outR+i);
+    float32x4_t r1=vld1q_f32(outR+i+4);
+    for (int j=0; j<count; j++) {
+      const DivMixSource& s=src[j];
+      int16x8_t a16=vld1q_s16(s.inL+i);
+      float32x4_t a0=vcvtq_f32_s32(vmovl_s16(vget_low_s16(a16)));
+      float32x4_t a1=vcvtq_f32_s32(vmovl_s16(vget_high_s16(a16)));
+      float32x4_t b0=a0;
+      float32x4_t b1=a1;
+      if (s.inR!=NULL) {
+        int16x8_t b16=vld1q_s16(s.inR+i);
+        b0=vcvtq_f32_s32(vmovl_s16(vget_low_s16(b16)));
+        b1=vcvtq_f32_s32(vmovl_s16(vget_high_s16(b16)));
+      }
+      l0=vmlaq_n_f32(l0,a0,s.gainL);
+      l1=vmlaq_n_f32(l1,a1,s.gainL);
+      r0=vmlaq_n_f32(r0,b0,s.gainR);
+      r1=vmlaq_n_f32(r1,b1,s.gainR);
+    }
+    vst1q_f32(oscL+i,l0);
+    vst1q_f32(oscL+i+4,l1);
+    vst1q_f32(oscR+i,r0);
+    vst1q_f32(oscR+i+4,r1);
+    if (mono) {
+      l0=vmulq_n_f32(vaddq_f32(l0,r0),0.5f);
+      l1=vmulq_n_f32(vaddq_f32(l1,r1),0.5f);
+      r0=l0;
+      r1=l1;
+    }
+    vst1q_f32(outL+i,l0);
+    vst1q_f32(outL+i+4,l1);
+    vst1q_f32(outR+i,r0);
+    vst1q_f32(outR+i+4,r1);
+  }
+#endif
+  for (; i<len; i++) {
+    float l=outL[i];
+    float r=outR[i];
+    for (int j=0; j<count; j++) {
+      const DivMixSource& s=src[j];
+      l+=(float)s.inL[i]*s.gainL;
+      r+=(float)((s.inR!=NULL)?s.inR[i]:s.inL[i])*s.gainR;
+    }
+    oscL[i]=l;
+    oscR[i]=r;
+    if (mono) {
+      l=(l+r)*0.5f;
+      r=l;
+    }
+    outL[i]=l;
+    outR[i]=r;
+  }
+}
+
+void divMixVoice(int* outL, int* outR, const short* in, short volL, short volR, int shift, size_t len) {
+  size_t i=0;
+#if defined(DIV_MIX_SSE2)
+  __m128i vl=_mm_set1_epi16(volL);
+  __m128i vr=_mm_set1_epi16(volR);
+  __m128i sh=_mm_cvtsi32_si128(shift);
+  for (; i+8<=len; i+=8) {
+    __m128i s=_mm_loadu_si128((const __m128i*)(in+i));
+    // 16x16->32 multiply from the low and high halves of the products
+    __m128i lLo=_mm_mullo_epi16(s,vl);
+    __m128i lHi=_mm_mulhi_epi16(s,vl);
+    __m128i rLo=_mm_mullo_epi16(s,vr);
+    __m128i rHi=_mm_mulhi_epi16(s,vr);
+    __m128i l0=_mm_sra_epi32(_mm_unpacklo_epi16(lLo,lHi),sh);
+    __m128i l1=_mm_sra_epi32(_mm_unpackhi_epi16(lLo,lHi),sh);
+    __m128i r0=_mm_sra_epi32(_mm_unpacklo_epi16(rLo,rHi),sh);
+    __m128i r1=_mm_sra_epi32(_mm_unpackhi_epi16(rLo,rHi),sh);
+    _mm_storeu_si128((__m128i*)(outL+i),_mm_add_epi32(_mm_loadu_si128((const __m128i*)(outL+i)),l0));
+    _mm_storeu_si128((__m128i*)(outL+i+4),_mm_add_epi32(_mm_loadu_si128((const __m128i*)(outL+i+4)),l1));
+    _mm_storeu_si128((__m128i*)(outR+i),_mm_add_epi32(_mm_loadu_si128((const __m128i*)(outR+i)),r0));
+    _mm_storeu_si128((__m128i*)(outR+i+4),_mm_add_epi32(_mm_loadu_si128((const __m128i*)(outR+i+4)),r1));
+  }
+#elif defined(DIV_MIX_NEON)
+  int16x4_t vl=vdup_n_s16(volL);
+  int16x4_t vr=vdup_n_s16(volR);
+  int32x4_t sh=vdupq_n_s32(-shift);
+  for (; i+8<=len; i+=8) {
+    int16x8_t s=vld1q_s16(in+i);
+    vst1q_s32(outL+i,vaddq_s32(vld1q_s32(outL+i),vshlq_s32(vmull_s16(vget_low_s16(s),vl),sh)));
+    vst1q_s32(outL+i+4,vaddq_s32(vld1q_s32(outL+i+4),vshlq_s32(vmull_s16(vget_high_s16(s),vl),sh)));
+    vst1q_s32(outR+i,vaddq_s32(vld1q_s32(outR+i),vshlq_s32(vmull_s16(vget_low_s16(s),vr),sh)));
+    vst1q_s32(outR+i+4,vaddq_s32(vld1q_s32(outR+i+4),vshlq_s32(vmull_s16(vget_high_s16(s),vr),sh)));
+  }
+#endif
+  for (; i<len; i++) {
+    outL[i]+=(in[i]*volL)>>shift;
+    outR[i]+=(in[i]*volR)>>shift;
+  }
+}
+
+void divMixClamp(short* out, const int* in, size_t len) {
+  size_t i=0;
+#if defined(DIV_MIX_SSE2)
+  for (; i+8<=len; i+=8) {
+    __m128i a=_mm_loadu_si128((const __m128i*)(in+i));
+    __m128i b=_mm_loadu_si128((const __m128i*)(in+i+4));
+    _mm_storeu_si128((__m128i*)(out+i),_mm_packs_epi32(a,b));
+  }
+#elif defined(DIV_MIX_NEON)
+  for (; i+8<=len; i+=8) {
+    vst1q_s16(out+i,vcombine_s16(vqmovn_s32(vld1q_s32(in+i)),vqmovn_s32(vld1q_s32(in+i+4))));
+  }
+#endif
+  for (; i<len; i++) {
+    int s=in[i];
+    if (s<-32768) s=-32768;
+    if (s>32767) s=32767;
+    out[i]=s;
+  }
+}
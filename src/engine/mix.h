@@ -0,0 +1,54 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2022 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _MIX_H
+#define _MIX_H
+#include <stddef.h>
+
+// mix kernels for the end of nextBuf() and for PCM voice mixing.
+// the SIMD variant is picked at compile time (SSE2 or NEON), with a scalar
+// fallback.
+
+// one system's output for divMixAll(). inR is NULL for mono sources.
+// the gains include the conversion to float (divide by 32768).
+struct DivMixSource {
+  const short* inL;
+  const short* inR;
+  float gainL, gainR;
+};
+
+/**
+ * add all sources to a stereo float buffer (which may already hold other
+ * audio), copy the result to the scope buffers and optionally downmix it
+ * to mono, in one pass over the output.
+ */
+void divMixAll(float* outL, float* outR, float* oscL, float* oscR, const DivMixSource* src, int count, bool mono, size_t len);
+
+/**
+ * add a run of voice samples to 32-bit stereo accumulators.
+ * each sample is multiplied by the side's volume, then shifted right by shift.
+ */
+void divMixVoice(int* outL, int* outR, const short* in, short volL, short volR, int shift, size_t len);
+
+/**
+ * saturate 32-bit accumulators to 16-bit output.
+ */
+void divMixClamp(short* out, const int* in, size_t len);
+
+#endif
@@ -19,20 +19,90 @@
 
 #include "engine.h"
 
+// the pattern returned for empty slots.
 static DivPattern emptyPat;
 
-DivPattern::DivPattern() {
-  memset(data,-1,256*32*sizeof(short));
-  for (int i=0; i<256; i++) {
-    data[i][0]=0;
-    data[i][1]=0;
+// blank the columns from..to of a row.
+static void clearRow(short* row, int from, int to) {
+  for (int i=from; i<to; i++) {
+    row[i]=(i<2)?0:-1;
   }
 }
 
+DivPattern::DivPattern(int rows, int cols) {
+  data.rows=rows;
+  data.cols=cols;
+  data.buf=new short[rows*cols];
+  for (int i=0; i<rows; i++) {
+    clearRow(data[i],0,cols);
+  }
+  compileEvents();
+}
+
+DivPattern::~DivPattern() {
+  delete[] data.buf;
+}
+
+void DivPattern::resize(int rows, int cols) {
+  if (rows<=data.rows && cols<=data.cols) return;
+  if (rows<data.rows) rows=data.rows;
+  if (cols<data.cols) cols=data.cols;
+  short* newBuf=new short[rows*cols];
+  for (int i=0; i<rows; i++) {
+    short* row=newBuf+i*cols;
+    if (i<data.rows) {
+      memcpy(row,data[i],data.cols*sizeof(short));
+      clearRow(row,data.cols,cols);
+    } else {
+      clearRow(row,0,cols);
+    }
+  }
+  delete[] data.buf;
+  data.buf=newBuf;
+  data.rows=rows;
+  data.cols=cols;
+  compileEvents();
+}
+
+void DivPattern::compileEvents() {
+  int fxRows=(data.cols-4)>>1;
+  events.clear();
+  eventRow.resize(data.rows+1);
+  for (int i=0; i<data.rows; i++) {
+    const short* row=data[i];
+    eventRow[i]=events.size();
+    if (!(row[0]==0 && row[1]==0)) {
+      events.push_back(DivPatternEvent(0,row[0],row[1]));
+    }
+    if (row[2]!=-1) {
+      events.push_back(DivPatternEvent(2,row[2],0));
+    }
+    if (row[3]!=-1) {
+      events.push_back(DivPatternEvent(3,row[3],0));
+    }
+    for (int j=0; j<fxRows; j++) {
+      if (row[4+(j<<1)]!=-1) {
+        events.push_back(DivPatternEvent(4+(j<<1),row[4+(j<<1)],(row[5+(j<<1)]==-1)?0:row[5+(j<<1)]));
+      }
+    }
+  }
+  eventRow[data.rows]=events.size();
+}
+
+const DivPatternEvent* DivPattern::getEvents(int row, int& count) {
+  // a jump (0Dxx) may land past the pattern length
+  if (row<0 || row>=data.rows) {
+    count=0;
+    return events.data();
+  }
+  count=eventRow[row+1]-eventRow[row];
+  return events.data()+eventRow[row];
+}
+
 DivPattern* DivChannelData::getPattern(int index, bool create) {
   if (data[index]==NULL) {
     if (create) {
-      data[index]=new DivPattern;
+      data[index]=new DivPattern(patRows,4+effectRows*2);
     } else {
       return &emptyPat;
     }
@@ -40,6 +110,29 @@ DivPattern* DivChannelData::getPattern(int index, bool create) {
   return data[index];
 }
 
+DivPattern* DivChannelData::getPatternForRow(int index, int row) {
+  DivPattern* ret=getPattern(index,false);
+  if (row<0 || row>=ret->data.rows) return &emptyPat;
+  return ret;
+}
+
+void DivChannelData::resizePatterns(int rows) {
+  patRows=rows;
+  for (int i=0; i<128; i++) {
+    if (data[i]!=NULL) {
+      data[i]->resize(rows,4+effectRows*2);
+    }
+  }
+}
+
+void DivChannelData::compileEvents() {
+  for (int i=0; i<128; i++) {
+    if (data[i]!=NULL) {
+      data[i]->compileEvents();
+    }
+  }
+}
+
 void DivChannelData::wipePatterns() {
   for (int i=0; i<128; i++) {
     if (data[i]!=NULL) {
@@ -51,7 +144,15 @@ void DivChannelData::wipePatterns() {
 
 void DivPattern::copyOn(DivPattern *dest) {
   dest->name=name;
-  memcpy(dest->data,data,sizeof(data));
+  if (dest->data.rows!=data.rows || dest->data.cols!=data.cols) {
+    delete[] dest->data.buf;
+    dest->data.buf=new short[data.rows*data.cols];
+    dest->data.rows=data.rows;
+    dest->data.cols=data.cols;
+  }
+  memcpy(dest->data.buf,data.buf,data.rows*data.cols*sizeof(short));
+  dest->events=events;
+  dest->eventRow=eventRow;
 }
 
 SafeReader* DivPattern::compile(int len, int fxRows) {
@@ -67,6 +168,8 @@ SafeReader* DivPattern::compile(int len, int fxRows) {
   memset(lastEffect,-1,8*sizeof(short));
   memset(lastEffectVal,-1,8*sizeof(short));
 
+  if (len>data.rows) len=data.rows;
+  if (fxRows>(data.cols-4)/2) fxRows=(data.cols-4)/2;
   for (int i=0; i<len; i++) {
     unsigned char mask=0;
     if (data[i][0]!=-1) {
@@ -130,6 +233,7 @@ SafeReader* DivPattern::compile(int len, int fxRows) {
 }
 
 DivChannelData::DivChannelData():
-  effectRows(1) {
+  effectRows(1),
+  patRows(64) {
   memset(data,0,128*sizeof(void*));
 }
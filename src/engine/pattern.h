@@ -17,18 +17,66 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <vector>
 #include "safeReader.h"
 
+#define DIV_MAX_ROWS 256
+#define DIV_MAX_COLS 32
+
+// pattern storage. rows are laid out back to back and only hold the
+// columns in use (4 plus 2 per effect column), so data[ROW][TYPE] stays
+// valid for ROW<rows and TYPE<cols.
+struct DivPatternData {
+  short* buf;
+  int rows, cols;
+  short* operator[](int row) {
+    return buf+row*cols;
+  }
+  const short* operator[](int row) const {
+    return buf+row*cols;
+  }
+};
+
+// a non-empty cell of a pattern row, as seen by playback.
+// col is the data column (0: note, 2: instrument, 3: volume, 4+: effect).
+// for notes a/b are the note and octave, for effects the effect and its
+// value (0 if empty), and for the rest a is the value.
+struct DivPatternEvent {
+  unsigned char col;
+  short a, b;
+  DivPatternEvent(unsigned char c, short _a, short _b):
+    col(c),
+    a(_a),
+    b(_b) {}
+};
+
 struct DivPattern {
   String name;
-  short data[256][32];
+  DivPatternData data;
+  // playback event stream. events of row i are events[eventRow[i]] to
+  // events[eventRow[i+1]-1], in column order.
+  // playback only reads it. whoever changes data must call compileEvents()
+  // afterwards, with the engine locked if the pattern is in use.
+  std::vector<DivPatternEvent> events;
+  std::vector<unsigned int> eventRow;
+  // get the events of a row.
+  const DivPatternEvent* getEvents(int row, int& count);
+  void compileEvents();
   void copyOn(DivPattern* dest);
+  // grow storage to at least rows by cols, keeping its contents.
+  void resize(int rows, int cols);
   SafeReader* compile(int len=256, int fxRows=1);
-  DivPattern();
+  DivPattern(int rows=DIV_MAX_ROWS, int cols=DIV_MAX_COLS);
+  ~DivPattern();
+  // owns data.buf. use copyOn() instead.
+  DivPattern(const DivPattern&)=delete;
+  DivPattern& operator=(const DivPattern&)=delete;
 };
 
 struct DivChannelData {
   unsigned char effectRows;
+  // rows allocated for new patterns. should be the song's pattern length.
+  int patRows;
   // data goes as follows: data[ROW][TYPE]
   // TYPE is:
   // 0: note
@@ -38,6 +86,13 @@ struct DivChannelData {
   // 4-5+: effect/effect value
   DivPattern* data[128];
   DivPattern* getPattern(int index, bool create);
+  // like getPattern(index,false), but returns an empty pattern if row is
+  // past the pattern's storage (e.g. after a jump with 0Dxx).
+  DivPattern* getPatternForRow(int index, int row);
+  // set the row count and grow all patterns to fit it and effectRows.
+  void resizePatterns(int rows);
+  // rebuild the event streams of all patterns (e.g. after loading).
+  void compileEvents();
   void wipePatterns();
   DivChannelData();
 };
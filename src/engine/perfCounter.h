@@ -0,0 +1,98 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2022 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef _PERFCOUNTER_H
+#define _PERFCOUNTER_H
+#include <chrono>
+#include <stdint.h>
+
+// how many buffers a peak is held for
+#define DIV_PERF_PEAK_WINDOW 128
+
+/**
+ * measures time spent in a section of the audio path.
+ * wrap the section in begin()/end() (as many times as needed), then call
+ * commit() once per buffer.
+ * all times are in nanoseconds per buffer.
+ * only one thread may update a counter at a time, and that includes
+ * reset(). reading from another thread is fine for display purposes.
+ */
+struct DivPerfCounter {
+  std::chrono::steady_clock::time_point start;
+  // time accumulated in the current buffer
+  uint64_t cur;
+  // time of the last buffer, rolling average and peak
+  uint64_t last, avg, peak;
+  // peak of the window in progress
+  uint64_t nextPeak;
+  // total time since the last reset
+  uint64_t total;
+  int window;
+
+  void begin() {
+    start=std::chrono::steady_clock::now();
+  }
+
+  void end() {
+    cur+=std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-start).count();
+  }
+
+  // drop time measured outside of the audio path (e.g. while seeking)
+  void discard() {
+    cur=0;
+  }
+
+  void commit() {
+    last=cur;
+    // exponential moving average over roughly 16 buffers
+    avg=avg-(avg>>4)+(cur>>4);
+    // the peak is held for at least one window
+    if (cur>peak) peak=cur;
+    if (cur>nextPeak) nextPeak=cur;
+    if (++window>=DIV_PERF_PEAK_WINDOW) {
+      peak=nextPeak;
+      nextPeak=0;
+      window=0;
+    }
+    total+=cur;
+    cur=0;
+  }
+
+  void reset() {
+    cur=0;
+    last=0;
+    avg=0;
+    peak=0;
+    nextPeak=0;
+    total=0;
+    window=0;
+  }
+
+  DivPerfCounter():
+    cur(0),
+    last(0),
+    avg(0),
+    peak(0),
+    nextPeak(0),
+    total(0),
+    window(0) {}
+};
+
+#endif
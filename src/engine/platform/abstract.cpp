@@ -22,6 +22,20 @@
 void DivDispatch::acquire(short* bufL, short* bufR, size_t start, size_t len) {
 }
 
+bool DivDispatch::isDirect() {
+  return false;
+}
+
+void DivDispatch::acquireDirect(DivDeltaBuf& out, size_t start, size_t len) {
+}
+
+bool DivDispatch::isQuiet() {
+  return false;
+}
+
+void DivDispatch::skipQuiet(size_t len) {
+}
+
 void DivDispatch::tick() {
 }
 
@@ -48,6 +62,9 @@ void* DivDispatch::getState() {
 void DivDispatch::setState(void* state) {
 }
 
+void DivDispatch::freeState(void* state) {
+}
+
 void DivDispatch::muteChannel(int ch, bool mute) {
 }
 
@@ -19,6 +19,8 @@
 
 #include "amiga.h"
 #include "../engine.h"
+#include "../mix.h"
+#include <string.h>
 #include <math.h>
 
 #define AMIGA_DIVIDER 8
@@ -64,49 +66,75 @@ const char** DivPlatformAmiga::getRegisterSheet() {
 }
 
 void DivPlatformAmiga::acquire(short* bufL, short* bufR, size_t start, size_t len) {
-  for (size_t h=start; h<start+len; h++) {
-    bufL[h]=0;
-    bufR[h]=0;
-    for (int i=0; i<4; i++) {
-      if (chan[i].sample>=0 && chan[i].sample<parent->song.sampleLen) {
-        chan[i].audSub-=AMIGA_DIVIDER;
-        if (chan[i].audSub<0) {
-          DivSample* s=parent->getSample(chan[i].sample);
-          if (s->samples>0) {
-            chan[i].audDat=s->data8[chan[i].audPos++];
-            if (chan[i].audPos>=s->samples || chan[i].audPos>=131071) {
-              if (s->loopStart>=0 && s->loopStart<=(int)s->samples) {
-                chan[i].audPos=s->loopStart;
-              } else {
-                chan[i].sample=-1;
-              }
+  if (mixBufLen<len) {
+    mixBufLen=len;
+    delete[] mixBuf[0];
+    delete[] mixBuf[1];
+    delete[] voiceBuf;
+    mixBuf[0]=new int[mixBufLen];
+    mixBuf[1]=new int[mixBufLen];
+    voiceBuf=new short[mixBufLen];
+  }
+  memset(mixBuf[0],0,len*sizeof(int));
+  memset(mixBuf[1],0,len*sizeof(int));
+
+  // render one voice at a time. the output only changes when a new byte is
+  // fetched, so fill the runs in between at once
+  for (int i=0; i<4; i++) {
+    Channel& ch=chan[i];
+    if (ch.sample>=0 && ch.sample<parent->song.sampleLen) {
+      DivSample* s=parent->getSample(ch.sample);
+      size_t h=0;
+      while (h<len) {
+        size_t steps=(ch.audSub>=0)?((ch.audSub/AMIGA_DIVIDER)+1):1;
+        if (ch.sample<0 || steps>len-h) {
+          // no fetch until the end of this buffer
+          if (ch.sample>=0) ch.audSub-=AMIGA_DIVIDER*(len-h);
+          for (; h<len; h++) voiceBuf[h]=ch.audDat;
+          break;
+        }
+        for (size_t j=h; j<h+steps-1; j++) voiceBuf[j]=ch.audDat;
+        h+=steps-1;
+        ch.audSub-=AMIGA_DIVIDER*steps;
+        if (s->samples>0) {
+          ch.audDat=s->data8[ch.audPos++];
+          if (ch.audPos>=s->samples || ch.audPos>=131071) {
+            if (s->loopStart>=0 && s->loopStart<=(int)s->samples) {
+              ch.audPos=s->loopStart;
+            } else {
+              ch.sample=-1;
             }
-          } else {
-            chan[i].sample=-1;
           }
-          if (chan[i].freq<124) {
-            if (++chan[i].busClock>=512) {
-              unsigned int rAmount=(124-chan[i].freq)*2;
-              if (chan[i].audPos>=rAmount) {
-                chan[i].audPos-=rAmount;
-              }
-              chan[i].busClock=0;
+        } else {
+          ch.sample=-1;
+        }
+        if (ch.freq<124) {
+          if (++ch.busClock>=512) {
+            unsigned int rAmount=(124-ch.freq)*2;
+            if (ch.audPos>=rAmount) {
+              ch.audPos-=rAmount;
             }
+            ch.busClock=0;
           }
-          chan[i].audSub+=MAX(114,chan[i].freq);
-        }
-      }
-      if (!isMuted[i]) {
-        if (i==0 || i==3) {
-          bufL[h]+=((chan[i].audDat*chan[i].outVol)*sep1)>>7;
-          bufR[h]+=((chan[i].audDat*chan[i].outVol)*sep2)>>7;
-        } else {
-          bufL[h]+=((chan[i].audDat*chan[i].outVol)*sep2)>>7;
-          bufR[h]+=((chan[i].audDat*chan[i].outVol)*sep1)>>7;
         }
+        ch.audSub+=MAX(114,ch.freq);
+        voiceBuf[h++]=ch.audDat;
       }
+    } else {
+      // a stopped voice holds its last byte
+      if (ch.audDat==0) continue;
+      for (size_t h=0; h<len; h++) voiceBuf[h]=ch.audDat;
+    }
+    if (isMuted[i] || ch.outVol==0) continue;
+    if (i==0 || i==3) {
+      divMixVoice(mixBuf[0],mixBuf[1],voiceBuf,ch.outVol*sep1,ch.outVol*sep2,7,len);
+    } else {
+      divMixVoice(mixBuf[0],mixBuf[1],voiceBuf,ch.outVol*sep2,ch.outVol*sep1,7,len);
     }
   }
+
+  divMixClamp(bufL+start,mixBuf[0],len);
+  divMixClamp(bufR+start,mixBuf[1],len);
 }
 
 void DivPlatformAmiga::tick() {
@@ -306,12 +334,37 @@ void* DivPlatformAmiga::getChanState(int ch) {
   return &chan[ch];
 }
 
+void* DivPlatformAmiga::getState() {
+  State* s=new State;
+  for (int i=0; i<4; i++) s->chan[i]=chan[i];
+  return s;
+}
+
+void DivPlatformAmiga::setState(void* state) {
+  if (state==NULL) return;
+  State* s=(State*)state;
+  for (int i=0; i<4; i++) chan[i]=s->chan[i];
+}
+
+void DivPlatformAmiga::freeState(void* state) {
+  delete (State*)state;
+}
+
 void DivPlatformAmiga::reset() {
   for (int i=0; i<4; i++) {
     chan[i]=DivPlatformAmiga::Channel();
   }
 }
 
+bool DivPlatformAmiga::isQuiet() {
+  // a stopped channel keeps outputting its last sample
+  for (int i=0; i<4; i++) {
+    if (chan[i].sample>=0 && chan[i].sample<parent->song.sampleLen) return false;
+    if (chan[i].audDat!=0 && chan[i].outVol!=0 && !isMuted[i]) return false;
+  }
+  return true;
+}
+
 bool DivPlatformAmiga::isStereo() {
   return true;
 }
@@ -356,10 +409,17 @@ int DivPlatformAmiga::init(DivEngine* p, int channels, int sugRate, unsigned int
   for (int i=0; i<4; i++) {
     isMuted[i]=false;
   }
+  mixBufLen=65536;
+  mixBuf[0]=new int[mixBufLen];
+  mixBuf[1]=new int[mixBufLen];
+  voiceBuf=new short[mixBufLen];
   setFlags(flags);
   reset();
   return 6;
 }
 
 void DivPlatformAmiga::quit() {
+  delete[] mixBuf[0];
+  delete[] mixBuf[1];
+  delete[] voiceBuf;
 }
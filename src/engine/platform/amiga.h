@@ -68,16 +68,27 @@ class DivPlatformAmiga: public DivDispatch {
 
   int sep1, sep2;
 
+  int* mixBuf[2];
+  short* voiceBuf;
+  size_t mixBufLen;
+
+  struct State {
+    Channel chan[4];
+  };
   friend void putDispatchChan(void*,int,int);
 
   public:
     void acquire(short* bufL, short* bufR, size_t start, size_t len);
     int dispatch(DivCommand c);
     void* getChanState(int chan);
+    void* getState();
+    void setState(void* state);
+    void freeState(void* state);
     void reset();
     void forceIns();
     void tick();
     void muteChannel(int ch, bool mute);
+    bool isQuiet();
     bool isStereo();
     bool keyOffAffectsArp(int ch);
     void setFlags(unsigned int flags);
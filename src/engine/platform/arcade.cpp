@@ -135,7 +135,7 @@ const char* DivPlatformArcade::getEffectName(unsigned char effect) {
 }
 
 void DivPlatformArcade::acquire_nuked(short* bufL, short* bufR, size_t start, size_t len) {
-  static int o[2];
+  int o[2];
 
   for (size_t h=start; h<start+len; h++) {
     if (!writes.empty() && !fm.write_busy) {
@@ -168,10 +168,14 @@ void DivPlatformArcade::acquire_nuked(short* bufL, short* bufR, size_t start, si
 }
 
 void DivPlatformArcade::acquire_ymfm(short* bufL, short* bufR, size_t start, size_t len) {
-  static int os[2];
-
-  for (size_t h=start; h<start+len; h++) {
-    os[0]=0; os[1]=0;
+  int os[2];
+  size_t h=start;
+  size_t end=start+len;
+
+  while (h<end) {
+    // apply the next write if it's due, then run the core until the one
+    // after it.
+    size_t blockEnd=end;
     if (!writes.empty()) {
       if (--delay<1) {
         QueuedWrite& w=writes.front();
@@ -181,20 +185,26 @@ void DivPlatformArcade::acquire_ymfm(short* bufL, short* bufR, size_t start, siz
         writes.pop();
         delay=1;
       }
+      if (!writes.empty()) {
+        if (h+delay<end) blockEnd=h+delay;
+        delay-=(int)(blockEnd-h)-1;
+      }
     }
-    
-    fm_ymfm->generate(&out_ymfm);
 
-    os[0]=out_ymfm.data[0];
-    if (os[0]<-32768) os[0]=-32768;
-    if (os[0]>32767) os[0]=32767;
+    for (; h<blockEnd; h++) {
+      fm_ymfm->generate(&out_ymfm);
 
-    os[1]=out_ymfm.data[1];
-    if (os[1]<-32768) os[1]=-32768;
-    if (os[1]>32767) os[1]=32767;
-  
-    bufL[h]=os[0];
-    bufR[h]=os[1];
+      os[0]=out_ymfm.data[0];
+      if (os[0]<-32768) os[0]=-32768;
+      if (os[0]>32767) os[0]=32767;
+
+      os[1]=out_ymfm.data[1];
+      if (os[1]<-32768) os[1]=-32768;
+      if (os[1]>32767) os[1]=32767;
+
+      bufL[h]=os[0];
+      bufR[h]=os[1];
+    }
   }
 }
 
@@ -674,6 +684,30 @@ void* DivPlatformArcade::getChanState(int ch) {
   return &chan[ch];
 }
 
+void* DivPlatformArcade::getState() {
+  State* s=new State;
+  for (int i=0; i<8; i++) s->chan[i]=chan[i];
+  s->amDepth=amDepth;
+  s->pmDepth=pmDepth;
+  memcpy(s->oldWrites,oldWrites,256*sizeof(short));
+  memcpy(s->pendingWrites,pendingWrites,256*sizeof(short));
+  return s;
+}
+
+void DivPlatformArcade::setState(void* state) {
+  if (state==NULL) return;
+  State* s=(State*)state;
+  for (int i=0; i<8; i++) chan[i]=s->chan[i];
+  amDepth=s->amDepth;
+  pmDepth=s->pmDepth;
+  memcpy(oldWrites,s->oldWrites,256*sizeof(short));
+  memcpy(pendingWrites,s->pendingWrites,256*sizeof(short));
+}
+
+void DivPlatformArcade::freeState(void* state) {
+  delete (State*)state;
+}
+
 unsigned char* DivPlatformArcade::getRegisterPool() {
   return regPool;
 }
@@ -691,7 +725,7 @@ void DivPlatformArcade::poke(std::vector<DivRegWrite>& wlist) {
 }
 
 void DivPlatformArcade::reset() {
-  while (!writes.empty()) writes.pop();
+  writes.clear();
   memset(regPool,0,256);
   if (useYMFM) {
     fm_ymfm->reset();
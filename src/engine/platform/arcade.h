@@ -21,7 +21,7 @@
 #define _ARCADE_H
 #include "../dispatch.h"
 #include "../instrument.h"
-#include <queue>
+#include "writeQueue.h"
 #include "../../../extern/opm/opm.h"
 #include "sound/ymfm/ymfm_opm.h"
 #include "../macroInt.h"
@@ -49,9 +49,10 @@ class DivPlatformArcade: public DivDispatch {
       unsigned short addr;
       unsigned char val;
       bool addrOrVal;
+      QueuedWrite(): addr(0), val(0), addrOrVal(false) {}
       QueuedWrite(unsigned short a, unsigned char v): addr(a), val(v), addrOrVal(false) {}
     };
-    std::queue<QueuedWrite> writes;
+    DivWriteQueue<QueuedWrite> writes;
     opm_t fm;
     int delay, baseFreqOff;
     int pcmL, pcmR, pcmCycles;
@@ -77,12 +78,22 @@ class DivPlatformArcade: public DivDispatch {
     void acquire_nuked(short* bufL, short* bufR, size_t start, size_t len);
     void acquire_ymfm(short* bufL, short* bufR, size_t start, size_t len);
   
+    struct State {
+      Channel chan[8];
+      unsigned char amDepth;
+      unsigned char pmDepth;
+      short oldWrites[256];
+      short pendingWrites[256];
+    };
     friend void putDispatchChan(void*,int,int);
   
   public:
     void acquire(short* bufL, short* bufR, size_t start, size_t len);
     int dispatch(DivCommand c);
     void* getChanState(int chan);
+    void* getState();
+    void setState(void* state);
+    void freeState(void* state);
     unsigned char* getRegisterPool();
     int getRegisterPoolSize();
     void reset();
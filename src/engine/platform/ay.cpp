@@ -82,7 +82,7 @@ const char* DivPlatformAY8910::getEffectName(unsigned char effect) {
   return NULL;
 }
 
-void DivPlatformAY8910::acquire(short* bufL, short* bufR, size_t start, size_t len) {
+void DivPlatformAY8910::runCore(size_t len) {
   if (ayBufLen<len) {
     ayBufLen=len;
     for (int i=0; i<3; i++) {
@@ -98,6 +98,10 @@ void DivPlatformAY8910::acquire(short* bufL, short* bufR, size_t start, size_t l
     writes.pop();
   }
   ay->sound_stream_update(ayBuf,len);
+}
+
+void DivPlatformAY8910::acquire(short* bufL, short* bufR, size_t start, size_t len) {
+  runCore(len);
   if (sunsoft) {
     for (size_t i=0; i<len; i++) {
       bufL[i+start]=ayBuf[0][i];
@@ -116,6 +120,36 @@ void DivPlatformAY8910::acquire(short* bufL, short* bufR, size_t start, size_t l
   }
 }
 
+bool DivPlatformAY8910::isDirect() {
+  return true;
+}
+
+void DivPlatformAY8910::acquireDirect(DivDeltaBuf& out, size_t start, size_t len) {
+  // only apply the pending writes
+  runCore(0);
+  size_t h=start;
+  size_t end=start+len;
+  while (h<end) {
+    ay->sound_stream_update(ayBuf,1);
+    if (sunsoft) {
+      out.put(0,h,ayBuf[0][0]);
+    } else if (stereo) {
+      out.put(0,h,(short)(ayBuf[0][0]+ayBuf[1][0]));
+      out.put(1,h,(short)(ayBuf[1][0]+ayBuf[2][0]));
+    } else {
+      out.put(0,h,(short)(ayBuf[0][0]+ayBuf[1][0]+ayBuf[2][0]));
+    }
+    h++;
+    // nothing changes until a counter expires, so skip to the sample before that
+    size_t skip=ay->samples_to_next_event()-1;
+    if (skip>end-h) skip=end-h;
+    if (skip>0) {
+      ay->skip_samples(skip);
+      h+=skip;
+    }
+  }
+}
+
 void DivPlatformAY8910::tick() {
   // PSG
   for (int i=0; i<3; i++) {
@@ -401,6 +435,46 @@ void* DivPlatformAY8910::getChanState(int ch) {
   return &chan[ch];
 }
 
+void* DivPlatformAY8910::getState() {
+  State* s=new State;
+  for (int i=0; i<3; i++) s->chan[i]=chan[i];
+  s->dacMode=dacMode;
+  s->dacPeriod=dacPeriod;
+  s->dacRate=dacRate;
+  s->dacPos=dacPos;
+  s->dacSample=dacSample;
+  s->sampleBank=sampleBank;
+  s->ayEnvMode=ayEnvMode;
+  s->ayEnvPeriod=ayEnvPeriod;
+  s->ayEnvSlideLow=ayEnvSlideLow;
+  s->ayEnvSlide=ayEnvSlide;
+  memcpy(s->oldWrites,oldWrites,16*sizeof(short));
+  memcpy(s->pendingWrites,pendingWrites,16*sizeof(short));
+  return s;
+}
+
+void DivPlatformAY8910::setState(void* state) {
+  if (state==NULL) return;
+  State* s=(State*)state;
+  for (int i=0; i<3; i++) chan[i]=s->chan[i];
+  dacMode=s->dacMode;
+  dacPeriod=s->dacPeriod;
+  dacRate=s->dacRate;
+  dacPos=s->dacPos;
+  dacSample=s->dacSample;
+  sampleBank=s->sampleBank;
+  ayEnvMode=s->ayEnvMode;
+  ayEnvPeriod=s->ayEnvPeriod;
+  ayEnvSlideLow=s->ayEnvSlideLow;
+  ayEnvSlide=s->ayEnvSlide;
+  memcpy(oldWrites,s->oldWrites,16*sizeof(short));
+  memcpy(pendingWrites,s->pendingWrites,16*sizeof(short));
+}
+
+void DivPlatformAY8910::freeState(void* state) {
+  delete (State*)state;
+}
+
 unsigned char* DivPlatformAY8910::getRegisterPool() {
   return regPool;
 }
@@ -410,7 +484,7 @@ int DivPlatformAY8910::getRegisterPoolSize() {
 }
 
 void DivPlatformAY8910::reset() {
-  while (!writes.empty()) writes.pop();
+  writes.clear();
   ay->device_reset();
   memset(regPool,0,16);
   for (int i=0; i<3; i++) {
@@ -443,10 +517,23 @@ void DivPlatformAY8910::reset() {
   extMode=false;
 }
 
-bool DivPlatformAY8910::isStereo() {
+bool DivPlatformAY8910::isQuiet() {
+  // a channel with amplitude 0 and no envelope outputs a constant level
+  if (!writes.empty()) return false;
+  for (int i=0; i<3; i++) {
+    if (regPool[0x08+i]&0x1f) return false;
+  }
   return true;
 }
 
+void DivPlatformAY8910::skipQuiet(size_t len) {
+  ay->advance(len);
+}
+
+bool DivPlatformAY8910::isStereo() {
+  return stereo && !sunsoft;
+}
+
 bool DivPlatformAY8910::keyOffAffectsArp(int ch) {
   return true;
 }
@@ -21,7 +21,7 @@
 #define _AY_H
 #include "../dispatch.h"
 #include "../macroInt.h"
-#include <queue>
+#include "writeQueue.h"
 #include "sound/ay8910.h"
 
 class DivPlatformAY8910: public DivDispatch {
@@ -43,9 +43,10 @@ class DivPlatformAY8910: public DivDispatch {
       unsigned short addr;
       unsigned char val;
       bool addrOrVal;
+      QueuedWrite(): addr(0), val(0), addrOrVal(false) {}
       QueuedWrite(unsigned short a, unsigned char v): addr(a), val(v), addrOrVal(false) {}
     };
-    std::queue<QueuedWrite> writes;
+    DivWriteQueue<QueuedWrite> writes;
     ay8910_device* ay;
     unsigned char regPool[16];
     unsigned char lastBusy;
@@ -71,12 +72,35 @@ class DivPlatformAY8910: public DivDispatch {
     short* ayBuf[3];
     size_t ayBufLen;
 
+    struct State {
+      Channel chan[3];
+      bool dacMode;
+      int dacPeriod;
+      int dacRate;
+      int dacPos;
+      int dacSample;
+      unsigned char sampleBank;
+      unsigned char ayEnvMode;
+      unsigned short ayEnvPeriod;
+      short ayEnvSlideLow;
+      short ayEnvSlide;
+      short oldWrites[16];
+      short pendingWrites[16];
+    };
+    void runCore(size_t len);
     friend void putDispatchChan(void*,int,int);
   
   public:
     void acquire(short* bufL, short* bufR, size_t start, size_t len);
+    bool isDirect();
+    void acquireDirect(DivDeltaBuf& out, size_t start, size_t len);
+    bool isQuiet();
+    void skipQuiet(size_t len);
     int dispatch(DivCommand c);
     void* getChanState(int chan);
+    void* getState();
+    void setState(void* state);
+    void freeState(void* state);
     unsigned char* getRegisterPool();
     int getRegisterPoolSize();
     void reset();
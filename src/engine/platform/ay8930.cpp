@@ -463,6 +463,40 @@ void* DivPlatformAY8930::getChanState(int ch) {
   return &chan[ch];
 }
 
+void* DivPlatformAY8930::getState() {
+  State* s=new State;
+  for (int i=0; i<3; i++) s->chan[i]=chan[i];
+  s->ayNoiseAnd=ayNoiseAnd;
+  s->ayNoiseOr=ayNoiseOr;
+  s->bank=bank;
+  for (int i=0; i<3; i++) s->ayEnvMode[i]=ayEnvMode[i];
+  for (int i=0; i<3; i++) s->ayEnvPeriod[i]=ayEnvPeriod[i];
+  for (int i=0; i<3; i++) s->ayEnvSlideLow[i]=ayEnvSlideLow[i];
+  for (int i=0; i<3; i++) s->ayEnvSlide[i]=ayEnvSlide[i];
+  memcpy(s->oldWrites,oldWrites,32*sizeof(short));
+  memcpy(s->pendingWrites,pendingWrites,32*sizeof(short));
+  return s;
+}
+
+void DivPlatformAY8930::setState(void* state) {
+  if (state==NULL) return;
+  State* s=(State*)state;
+  for (int i=0; i<3; i++) chan[i]=s->chan[i];
+  ayNoiseAnd=s->ayNoiseAnd;
+  ayNoiseOr=s->ayNoiseOr;
+  bank=s->bank;
+  for (int i=0; i<3; i++) ayEnvMode[i]=s->ayEnvMode[i];
+  for (int i=0; i<3; i++) ayEnvPeriod[i]=s->ayEnvPeriod[i];
+  for (int i=0; i<3; i++) ayEnvSlideLow[i]=s->ayEnvSlideLow[i];
+  for (int i=0; i<3; i++) ayEnvSlide[i]=s->ayEnvSlide[i];
+  memcpy(oldWrites,s->oldWrites,32*sizeof(short));
+  memcpy(pendingWrites,s->pendingWrites,32*sizeof(short));
+}
+
+void DivPlatformAY8930::freeState(void* state) {
+  delete (State*)state;
+}
+
 unsigned char* DivPlatformAY8930::getRegisterPool() {
   return regPool;
 }
@@ -472,7 +506,7 @@ int DivPlatformAY8930::getRegisterPoolSize() {
 }
 
 void DivPlatformAY8930::reset() {
-  while (!writes.empty()) writes.pop();
+  writes.clear();
   ay->device_reset();
   memset(regPool,0,32);
   for (int i=0; i<3; i++) {
@@ -504,6 +538,18 @@ void DivPlatformAY8930::reset() {
   immWrite(0x1a,0x00); // or mask
 }
 
+bool DivPlatformAY8930::isQuiet() {
+  if (!writes.empty()) return false;
+  for (int i=0; i<3; i++) {
+    if (regPool[0x08+i]&0x3f) return false;
+  }
+  return true;
+}
+
+void DivPlatformAY8930::skipQuiet(size_t len) {
+  ay->advance(len);
+}
+
 bool DivPlatformAY8930::isStereo() {
   return true;
 }
@@ -21,7 +21,7 @@
 #define _AY8930_H
 #include "../dispatch.h"
 #include "../macroInt.h"
-#include <queue>
+#include "writeQueue.h"
 #include "sound/ay8910.h"
 
 class DivPlatformAY8930: public DivDispatch {
@@ -43,9 +43,10 @@ class DivPlatformAY8930: public DivDispatch {
       unsigned short addr;
       unsigned char val;
       bool addrOrVal;
+      QueuedWrite(): addr(0), val(0), addrOrVal(false) {}
       QueuedWrite(unsigned short a, unsigned char v): addr(a), val(v), addrOrVal(false) {}
     };
-    std::queue<QueuedWrite> writes;
+    DivWriteQueue<QueuedWrite> writes;
     ay8930_device* ay;
     unsigned char regPool[32];
     unsigned char ayNoiseAnd, ayNoiseOr;
@@ -64,12 +65,27 @@ class DivPlatformAY8930: public DivDispatch {
     short* ayBuf[3];
     size_t ayBufLen;
 
+    struct State {
+      Channel chan[3];
+      unsigned char ayNoiseAnd;
+      unsigned char ayNoiseOr;
+      bool bank;
+      unsigned char ayEnvMode[3];
+      unsigned short ayEnvPeriod[3];
+      short ayEnvSlideLow[3];
+      short ayEnvSlide[3];
+      short oldWrites[32];
+      short pendingWrites[32];
+    };
     friend void putDispatchChan(void*,int,int);
   
   public:
     void acquire(short* bufL, short* bufR, size_t start, size_t len);
     int dispatch(DivCommand c);
     void* getChanState(int chan);
+    void* getState();
+    void setState(void* state);
+    void freeState(void* state);
     unsigned char* getRegisterPool();
     int getRegisterPoolSize();
     void reset();
@@ -77,6 +93,8 @@ class DivPlatformAY8930: public DivDispatch {
     void tick();
     void muteChannel(int ch, bool mute);
     void setFlags(unsigned int flags);
+    bool isQuiet();
+    void skipQuiet(size_t len);
     bool isStereo();
     bool keyOffAffectsArp(int ch);
     void notifyInsDeletion(void* ins);
@@ -19,6 +19,7 @@
 
 #include "c64.h"
 #include "../engine.h"
+#include "../../ta-log.h"
 #include <math.h>
 
 #define rWrite(a,v) if (!skipRegisterWrites) {sid.write(a,v); regPool[(a)&0x1f]=v; if (dumpWrites) {addWrite(a,v);} }
@@ -109,6 +110,16 @@ const char* DivPlatformC64::getEffectName(unsigned char effect) {
 }
 
 void DivPlatformC64::acquire(short* bufL, short* bufR, size_t start, size_t len) {
+  if (sampleMode!=0) {
+    // let reSID produce samples at the output rate by itself.
+    // it stops once len samples are out, so give it a bit more than needed.
+    cycle_count delta=(cycle_count)(len*(double)chipClock/rate)+(chipClock/rate)+2;
+    int out=sid.clock(delta,bufL+start,len);
+    for (size_t i=(out<0)?0:out; i<len; i++) {
+      bufL[i+start]=(i>0)?bufL[i+start-1]:sid.output();
+    }
+    return;
+  }
   for (size_t i=start; i<start+len; i++) {
     sid.clock();
     bufL[i]=sid.output();
@@ -467,6 +478,32 @@ void* DivPlatformC64::getChanState(int ch) {
   return &chan[ch];
 }
 
+void* DivPlatformC64::getState() {
+  State* s=new State;
+  for (int i=0; i<3; i++) s->chan[i]=chan[i];
+  s->filtControl=filtControl;
+  s->filtRes=filtRes;
+  s->vol=vol;
+  s->filtCut=filtCut;
+  s->resetTime=resetTime;
+  return s;
+}
+
+void DivPlatformC64::setState(void* state) {
+  if (state==NULL) return;
+  State* s=(State*)state;
+  for (int i=0; i<3; i++) chan[i]=s->chan[i];
+  filtControl=s->filtControl;
+  filtRes=s->filtRes;
+  vol=s->vol;
+  filtCut=s->filtCut;
+  resetTime=s->resetTime;
+}
+
+void DivPlatformC64::freeState(void* state) {
+  delete (State*)state;
+}
+
 unsigned char* DivPlatformC64::getRegisterPool() {
   return regPool;
 }
@@ -510,11 +547,35 @@ void DivPlatformC64::setChipModel(bool is6581) {
 
 void DivPlatformC64::setFlags(unsigned int flags) {
   if (flags&1) {
-    rate=COLOR_PAL*2.0/9.0;
+    chipClock=COLOR_PAL*2.0/9.0;
   } else {
-    rate=COLOR_NTSC*2.0/7.0;
+    chipClock=COLOR_NTSC*2.0/7.0;
+  }
+  rate=chipClock;
+
+  // bits 4-5: emulation mode
+  // 0: clock every cycle (accurate)
+  // 1: reSID fast sampling
+  // 2: reSID interpolated sampling
+  // 3: reSID resampling
+  sampleMode=(flags>>4)&3;
+  if (sampleMode!=0) {
+    sampling_method method=SAMPLE_FAST;
+    switch (sampleMode) {
+      case 2:
+        method=SAMPLE_INTERPOLATE;
+        break;
+      case 3:
+        method=SAMPLE_RESAMPLE_FAST;
+        break;
+    }
+    if (sid.set_sampling_parameters(chipClock,method,sampleRate)) {
+      rate=sampleRate;
+    } else {
+      logW("C64: could not set sampling parameters for rate %d! using accurate mode.\n",sampleRate);
+      sampleMode=0;
+    }
   }
-  chipClock=rate;
 }
 
 int DivPlatformC64::init(DivEngine* p, int channels, int sugRate, unsigned int flags) {
@@ -524,6 +585,7 @@ int DivPlatformC64::init(DivEngine* p, int channels, int sugRate, unsigned int f
   for (int i=0; i<3; i++) {
     isMuted[i]=false;
   }
+  sampleRate=sugRate;
   setFlags(flags);
 
   reset();
@@ -68,10 +68,20 @@ class DivPlatformC64: public DivDispatch {
 
   unsigned char filtControl, filtRes, vol;
   int filtCut, resetTime;
+  unsigned char sampleMode;
+  int sampleRate;
 
   SID sid;
   unsigned char regPool[32];
 
+  struct State {
+    Channel chan[3];
+    unsigned char filtControl;
+    unsigned char filtRes;
+    unsigned char vol;
+    int filtCut;
+    int resetTime;
+  };
   friend void putDispatchChan(void*,int,int);
 
   void updateFilter();
@@ -79,6 +89,9 @@ class DivPlatformC64: public DivDispatch {
     void acquire(short* bufL, short* bufR, size_t start, size_t len);
     int dispatch(DivCommand c);
     void* getChanState(int chan);
+    void* getState();
+    void setState(void* state);
+    void freeState(void* state);
     unsigned char* getRegisterPool();
     int getRegisterPoolSize();
     void reset();
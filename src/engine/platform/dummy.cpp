@@ -54,6 +54,22 @@ void* DivPlatformDummy::getChanState(int ch) {
   return &chan[ch];
 }
 
+void* DivPlatformDummy::getState() {
+  State* s=new State;
+  for (int i=0; i<128; i++) s->chan[i]=chan[i];
+  return s;
+}
+
+void DivPlatformDummy::setState(void* state) {
+  if (state==NULL) return;
+  State* s=(State*)state;
+  for (int i=0; i<128; i++) chan[i]=s->chan[i];
+}
+
+void DivPlatformDummy::freeState(void* state) {
+  delete (State*)state;
+}
+
 int DivPlatformDummy::dispatch(DivCommand c) {
   switch (c.cmd) {
     case DIV_CMD_NOTE_ON:
@@ -34,12 +34,18 @@ class DivPlatformDummy: public DivDispatch {
   Channel chan[128];
   bool isMuted[128];
   unsigned char chans;
+  struct State {
+    Channel chan[128];
+  };
   friend void putDispatchChan(void*,int,int);
   public:
     void acquire(short* bufL, short* bufR, size_t start, size_t len);
     void muteChannel(int ch, bool mute);
     int dispatch(DivCommand c);
     void* getChanState(int chan);
+    void* getState();
+    void setState(void* state);
+    void freeState(void* state);
     void reset();
     void tick();
     int init(DivEngine* parent, int channels, int sugRate, unsigned int flags);
@@ -84,12 +84,58 @@ const char* DivPlatformGB::getEffectName(unsigned char effect) {
 
 void DivPlatformGB::acquire(short* bufL, short* bufR, size_t start, size_t len) {
   for (size_t i=start; i<start+len; i++) {
-    GB_advance_cycles(gb,16);
+    GB_advance_cycles(gb,cyclesPerSample);
     bufL[i]=gb->apu_output.final_sample.left;
     bufR[i]=gb->apu_output.final_sample.right;
   }
 }
 
+bool DivPlatformGB::isDirect() {
+  return true;
+}
+
+bool DivPlatformGB::isIdle() {
+  // no channel is playing and nothing else moves the output
+  if (gb->apu_output.highpass_mode!=GB_HIGHPASS_OFF) return false;
+  if (gb->apu_output.interference_volume!=0) return false;
+  if (gb->apu.channel_4_dmg_delayed_start) return false;
+  for (int i=0; i<GB_N_CHANNELS; i++) {
+    if (gb->apu.is_active[i]) return false;
+    if (gb->model<GB_MODEL_AGB && gb->apu_output.dac_discharge[i]!=(GB_apu_is_DAC_enabled(gb,i)?1.0:0.0)) return false;
+  }
+  return true;
+}
+
+void DivPlatformGB::acquireDirect(DivDeltaBuf& out, size_t start, size_t len) {
+  // GB_advance_cycles() takes at most 127 cycles
+  const size_t maxRun=127/cyclesPerSample;
+  bool idle=false;
+  size_t i=start;
+  while (i<start+len) {
+    if (idle) {
+      // the output holds, so only run the timers and channel counters.
+      // the sample clock is kept in step with rendering every sample.
+      size_t run=MIN(maxRun,start+len-i);
+      double sampleCycles=gb->apu_output.sample_cycles;
+      for (size_t j=0; j<run; j++) {
+        sampleCycles+=cyclesPerSample*(gb->cgb_double_speed?1:2);
+        if (sampleCycles>=gb->apu_output.cycles_per_sample) sampleCycles-=gb->apu_output.cycles_per_sample;
+      }
+      GB_advance_cycles(gb,run*cyclesPerSample);
+      gb->apu_output.sample_cycles=sampleCycles;
+      i+=run;
+      continue;
+    }
+    // a sample rendered while idle throughout is what every following one would be
+    bool wasIdle=isIdle();
+    GB_advance_cycles(gb,cyclesPerSample);
+    out.put(0,i,gb->apu_output.final_sample.left);
+    out.put(1,i,gb->apu_output.final_sample.right);
+    idle=wasIdle && isIdle();
+    i++;
+  }
+}
+
 void DivPlatformGB::updateWave() {
   DivWavetable* wt=parent->getWave(chan[2].wave);
   rWrite(0x1a,0);
@@ -394,6 +440,24 @@ void* DivPlatformGB::getChanState(int ch) {
   return &chan[ch];
 }
 
+void* DivPlatformGB::getState() {
+  State* s=new State;
+  for (int i=0; i<4; i++) s->chan[i]=chan[i];
+  s->lastPan=lastPan;
+  return s;
+}
+
+void DivPlatformGB::setState(void* state) {
+  if (state==NULL) return;
+  State* s=(State*)state;
+  for (int i=0; i<4; i++) chan[i]=s->chan[i];
+  lastPan=s->lastPan;
+}
+
+void DivPlatformGB::freeState(void* state) {
+  delete (State*)state;
+}
+
 unsigned char* DivPlatformGB::getRegisterPool() {
   return regPool;
 }
@@ -463,12 +527,20 @@ int DivPlatformGB::init(DivEngine* p, int channels, int sugRate, unsigned int fl
   dumpWrites=false;
   skipRegisterWrites=false;
   chipClock=4194304;
-  rate=chipClock/16;
   gb=new GB_gameboy_t;
+  setFlags(flags);
   reset();
   return 4;
 }
 
+void DivPlatformGB::setFlags(unsigned int flags) {
+  // bit 4: fast emulation (output every 32 cycles instead of 16)
+  // SameBoy averages the output over each sample, so this is still filtered.
+  cyclesPerSample=(flags&16)?32:16;
+  rate=chipClock/cyclesPerSample;
+  GB_set_sample_rate(gb,rate);
+}
+
 void DivPlatformGB::quit() {
   delete gb;
 }
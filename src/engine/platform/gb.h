@@ -53,17 +53,28 @@ class DivPlatformGB: public DivDispatch {
   Channel chan[4];
   bool isMuted[4];
   unsigned char lastPan;
+  unsigned char cyclesPerSample;
 
   GB_gameboy_t* gb;
   unsigned char regPool[128];
   
   unsigned char procMute();
   void updateWave();
+  struct State {
+    Channel chan[4];
+    unsigned char lastPan;
+  };
+  bool isIdle();
   friend void putDispatchChan(void*,int,int);
   public:
     void acquire(short* bufL, short* bufR, size_t start, size_t len);
+    bool isDirect();
+    void acquireDirect(DivDeltaBuf& out, size_t start, size_t len);
     int dispatch(DivCommand c);
     void* getChanState(int chan);
+    void* getState();
+    void setState(void* state);
+    void freeState(void* state);
     unsigned char* getRegisterPool();
     int getRegisterPoolSize();
     void reset();
@@ -71,6 +82,7 @@ class DivPlatformGB: public DivDispatch {
     void tick();
     void muteChannel(int ch, bool mute);
     bool isStereo();
+    void setFlags(unsigned int flags);
     void notifyInsChange(int ins);
     void notifyWaveChange(int wave);
     void notifyInsDeletion(void* ins);
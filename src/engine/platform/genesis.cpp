@@ -82,8 +82,8 @@ const char* DivPlatformGenesis::getEffectName(unsigned char effect) {
 }
 
 void DivPlatformGenesis::acquire_nuked(short* bufL, short* bufR, size_t start, size_t len) {
-  static short o[2];
-  static int os[2];
+  short o[2];
+  int os[2];
 
   for (size_t h=start; h<start+len; h++) {
     if (dacMode && dacSample!=-1) {
@@ -147,7 +147,7 @@ void DivPlatformGenesis::acquire_nuked(short* bufL, short* bufR, size_t start, s
 }
 
 void DivPlatformGenesis::acquire_ymfm(short* bufL, short* bufR, size_t start, size_t len) {
-  static int os[2];
+  int os[2];
 
   for (size_t h=start; h<start+len; h++) {
     if (dacMode && dacSample!=-1) {
@@ -767,6 +767,47 @@ void* DivPlatformGenesis::getChanState(int ch) {
   return &chan[ch];
 }
 
+void DivPlatformGenesis::saveState(State* s) {
+  for (int i=0; i<10; i++) s->chan[i]=chan[i];
+  s->dacMode=dacMode;
+  s->dacPeriod=dacPeriod;
+  s->dacRate=dacRate;
+  s->dacPos=dacPos;
+  s->dacSample=dacSample;
+  s->sampleBank=sampleBank;
+  s->lfoValue=lfoValue;
+  memcpy(s->oldWrites,oldWrites,512*sizeof(short));
+  memcpy(s->pendingWrites,pendingWrites,512*sizeof(short));
+}
+
+void DivPlatformGenesis::loadState(State* s) {
+  for (int i=0; i<10; i++) chan[i]=s->chan[i];
+  dacMode=s->dacMode;
+  dacPeriod=s->dacPeriod;
+  dacRate=s->dacRate;
+  dacPos=s->dacPos;
+  dacSample=s->dacSample;
+  sampleBank=s->sampleBank;
+  lfoValue=s->lfoValue;
+  memcpy(oldWrites,s->oldWrites,512*sizeof(short));
+  memcpy(pendingWrites,s->pendingWrites,512*sizeof(short));
+}
+
+void* DivPlatformGenesis::getState() {
+  State* s=new State;
+  saveState(s);
+  return s;
+}
+
+void DivPlatformGenesis::setState(void* state) {
+  if (state==NULL) return;
+  loadState((State*)state);
+}
+
+void DivPlatformGenesis::freeState(void* state) {
+  delete (State*)state;
+}
+
 unsigned char* DivPlatformGenesis::getRegisterPool() {
   return regPool;
 }
@@ -776,7 +817,7 @@ int DivPlatformGenesis::getRegisterPoolSize() {
 }
 
 void DivPlatformGenesis::reset() {
-  while (!writes.empty()) writes.pop();
+  writes.clear();
   memset(regPool,0,512);
   if (useYMFM) {
     fm_ymfm->reset();
@@ -20,7 +20,7 @@
 #ifndef _GENESIS_H
 #define _GENESIS_H
 #include "../dispatch.h"
-#include <queue>
+#include "writeQueue.h"
 #include "../../../extern/Nuked-OPN2/ym3438.h"
 #include "sound/ymfm/ymfm_opn.h"
 
@@ -66,9 +66,10 @@ class DivPlatformGenesis: public DivDispatch {
       unsigned short addr;
       unsigned char val;
       bool addrOrVal;
+      QueuedWrite(): addr(0), val(0), addrOrVal(false) {}
       QueuedWrite(unsigned short a, unsigned char v): addr(a), val(v), addrOrVal(false) {}
     };
-    std::queue<QueuedWrite> writes;
+    DivWriteQueue<QueuedWrite> writes;
     ym3438_t fm;
     int delay;
     unsigned char lastBusy;
@@ -95,6 +96,20 @@ class DivPlatformGenesis: public DivDispatch {
     int octave(int freq);
     int toFreq(int freq);
 
+    struct State {
+      Channel chan[10];
+      bool dacMode;
+      int dacPeriod;
+      int dacRate;
+      unsigned int dacPos;
+      int dacSample;
+      unsigned char sampleBank;
+      unsigned char lfoValue;
+      short oldWrites[512];
+      short pendingWrites[512];
+    };
+    void saveState(State* s);
+    void loadState(State* s);
     friend void putDispatchChan(void*,int,int);
 
     void acquire_nuked(short* bufL, short* bufR, size_t start, size_t len);
@@ -104,6 +119,9 @@ class DivPlatformGenesis: public DivDispatch {
     void acquire(short* bufL, short* bufR, size_t start, size_t len);
     int dispatch(DivCommand c);
     void* getChanState(int chan);
+    void* getState();
+    void setState(void* state);
+    void freeState(void* state);
     unsigned char* getRegisterPool();
     int getRegisterPoolSize();
     void reset();
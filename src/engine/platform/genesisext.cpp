@@ -329,6 +329,24 @@ void* DivPlatformGenesisExt::getChanState(int ch) {
   return &chan[ch];
 }
 
+void* DivPlatformGenesisExt::getState() {
+  ExtState* s=new ExtState;
+  saveState(s);
+  for (int i=0; i<4; i++) s->opChan[i]=opChan[i];
+  return s;
+}
+
+void DivPlatformGenesisExt::setState(void* state) {
+  if (state==NULL) return;
+  ExtState* s=(ExtState*)state;
+  loadState(s);
+  for (int i=0; i<4; i++) opChan[i]=s->opChan[i];
+}
+
+void DivPlatformGenesisExt::freeState(void* state) {
+  delete (ExtState*)state;
+}
+
 void DivPlatformGenesisExt::reset() {
   DivPlatformGenesis::reset();
 
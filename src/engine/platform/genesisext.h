@@ -35,10 +35,16 @@ class DivPlatformGenesisExt: public DivPlatformGenesis {
   };
   OpChannel opChan[4];
   bool isOpMuted[4];
+  struct ExtState: public State {
+    OpChannel opChan[4];
+  };
   friend void putDispatchChan(void*,int,int);
   public:
     int dispatch(DivCommand c);
     void* getChanState(int chan);
+    void* getState();
+    void setState(void* state);
+    void freeState(void* state);
     void reset();
     void forceIns();
     void tick();
@@ -281,6 +281,22 @@ void* DivPlatformLynx::getChanState(int ch) {
   return &chan[ch];
 }
 
+void* DivPlatformLynx::getState() {
+  State* s=new State;
+  for (int i=0; i<4; i++) s->chan[i]=chan[i];
+  return s;
+}
+
+void DivPlatformLynx::setState(void* state) {
+  if (state==NULL) return;
+  State* s=(State*)state;
+  for (int i=0; i<4; i++) chan[i]=s->chan[i];
+}
+
+void DivPlatformLynx::freeState(void* state) {
+  delete (State*)state;
+}
+
 unsigned char* DivPlatformLynx::getRegisterPool()
 {
   return const_cast<unsigned char*>( mikey->getRegisterPool() );
@@ -71,11 +71,17 @@ class DivPlatformLynx: public DivDispatch {
   Channel chan[4];
   bool isMuted[4];
   std::unique_ptr<Lynx::Mikey> mikey;
+  struct State {
+    Channel chan[4];
+  };
   friend void putDispatchChan(void*,int,int);
   public:
     void acquire(short* bufL, short* bufR, size_t start, size_t len);
     int dispatch(DivCommand c);
     void* getChanState(int chan);
+    void* getState();
+    void setState(void* state);
+    void freeState(void* state);
     unsigned char* getRegisterPool();
     int getRegisterPoolSize();
     void reset();
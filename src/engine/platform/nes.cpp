@@ -71,35 +71,41 @@ const char* DivPlatformNES::getEffectName(unsigned char effect) {
 }
 
 void DivPlatformNES::acquire(short* bufL, short* bufR, size_t start, size_t len) {
+  int batch=1<<batchShift;
   for (size_t i=start; i<start+len; i++) {
-    if (dacSample!=-1) {
-      dacPeriod+=dacRate;
-      if (dacPeriod>=rate) {
-        DivSample* s=parent->getSample(dacSample);
-        if (s->samples>0) {
-          if (!isMuted[4]) {
-            rWrite(0x4011,((unsigned char)s->data8[dacPos]+0x80)>>1);
-          }
-          if (++dacPos>=s->samples) {
-            if (s->loopStart>=0 && s->loopStart<=(int)s->samples) {
-              dacPos=s->loopStart;
-            } else {
-              dacSample=-1;
+    // in fast mode, several cycles are averaged into one sample
+    int sum=0;
+    for (int j=0; j<batch; j++) {
+      if (dacSample!=-1) {
+        dacPeriod+=dacRate;
+        if (dacPeriod>=chipClock) {
+          DivSample* s=parent->getSample(dacSample);
+          if (s->samples>0) {
+            if (!isMuted[4]) {
+              rWrite(0x4011,((unsigned char)s->data8[dacPos]+0x80)>>1);
             }
+            if (++dacPos>=s->samples) {
+              if (s->loopStart>=0 && s->loopStart<=(int)s->samples) {
+                dacPos=s->loopStart;
+              } else {
+                dacSample=-1;
+              }
+            }
+            dacPeriod-=chipClock;
+          } else {
+            dacSample=-1;
           }
-          dacPeriod-=rate;
-        } else {
-          dacSample=-1;
         }
       }
+    
+      apu_tick(nes,NULL);
+      nes->apu.odd_cycle=!nes->apu.odd_cycle;
+      if (nes->apu.clocked) {
+        nes->apu.clocked=false;
+      }
+      sum+=pulse_output(nes)+tnd_output(nes)-128;
     }
-  
-    apu_tick(nes,NULL);
-    nes->apu.odd_cycle=!nes->apu.odd_cycle;
-    if (nes->apu.clocked) {
-      nes->apu.clocked=false;
-    }
-    int sample=(pulse_output(nes)+tnd_output(nes)-128)<<7;
+    int sample=(sum<<7)>>batchShift;
     if (sample>32767) sample=32767;
     if (sample<-32768) sample=-32768;
     bufL[i]=sample;
@@ -443,6 +449,32 @@ void* DivPlatformNES::getChanState(int ch) {
   return &chan[ch];
 }
 
+void* DivPlatformNES::getState() {
+  State* s=new State;
+  for (int i=0; i<5; i++) s->chan[i]=chan[i];
+  s->dacPeriod=dacPeriod;
+  s->dacRate=dacRate;
+  s->dacPos=dacPos;
+  s->dacSample=dacSample;
+  s->sampleBank=sampleBank;
+  return s;
+}
+
+void DivPlatformNES::setState(void* state) {
+  if (state==NULL) return;
+  State* s=(State*)state;
+  for (int i=0; i<5; i++) chan[i]=s->chan[i];
+  dacPeriod=s->dacPeriod;
+  dacRate=s->dacRate;
+  dacPos=s->dacPos;
+  dacSample=s->dacSample;
+  sampleBank=s->sampleBank;
+}
+
+void DivPlatformNES::freeState(void* state) {
+  delete (State*)state;
+}
+
 unsigned char* DivPlatformNES::getRegisterPool() {
   return regPool;
 }
@@ -480,20 +512,22 @@ bool DivPlatformNES::keyOffAffectsArp(int ch) {
 }
 
 void DivPlatformNES::setFlags(unsigned int flags) {
-  if (flags==2) { // Dendy
-    rate=COLOR_PAL*2.0/5.0;
+  if ((flags&3)==2) { // Dendy
+    chipClock=COLOR_PAL*2.0/5.0;
     apuType=2;
     nes->apu.type=apuType;
-  } else if (flags==1) { // PAL
-    rate=COLOR_PAL*3.0/8.0;
+  } else if ((flags&3)==1) { // PAL
+    chipClock=COLOR_PAL*3.0/8.0;
     apuType=1;
     nes->apu.type=apuType;
   } else { // NTSC
-    rate=COLOR_NTSC/2.0;
+    chipClock=COLOR_NTSC/2.0;
     apuType=0;
     nes->apu.type=apuType;
   }
-  chipClock=rate;
+  // bit 4: fast emulation (output every 8 cycles)
+  batchShift=(flags&16)?3:0;
+  rate=chipClock>>batchShift;
 }
 
 void DivPlatformNES::notifyInsDeletion(void* ins) {
@@ -512,7 +546,7 @@ void DivPlatformNES::poke(std::vector<DivRegWrite>& wlist) {
 
 int DivPlatformNES::init(DivEngine* p, int channels, int sugRate, unsigned int flags) {
   parent=p;
-  apuType=flags;
+  apuType=flags&3;
   dumpWrites=false;
   skipRegisterWrites=false;
   nes=new struct NESAPU;
@@ -58,15 +58,27 @@ class DivPlatformNES: public DivDispatch {
   int dacSample;
   unsigned char sampleBank;
   unsigned char apuType;
+  unsigned char batchShift;
   struct NESAPU* nes;
   unsigned char regPool[128];
 
+  struct State {
+    Channel chan[5];
+    int dacPeriod;
+    int dacRate;
+    unsigned int dacPos;
+    int dacSample;
+    unsigned char sampleBank;
+  };
   friend void putDispatchChan(void*,int,int);
 
   public:
     void acquire(short* bufL, short* bufR, size_t start, size_t len);
     int dispatch(DivCommand c);
     void* getChanState(int chan);
+    void* getState();
+    void setState(void* state);
+    void freeState(void* state);
     unsigned char* getRegisterPool();
     int getRegisterPoolSize();
     void reset();
@@ -71,8 +71,8 @@ const unsigned char drumSlot[11]={
 };
 
 void DivPlatformOPLL::acquire_nuked(short* bufL, short* bufR, size_t start, size_t len) {
-  static int o[2];
-  static int os;
+  int o[2];
+  int os;
 
   for (size_t h=start; h<start+len; h++) {
     os=0;
@@ -108,10 +108,39 @@ void DivPlatformOPLL::acquire_nuked(short* bufL, short* bufR, size_t start, size
 }
 
 void DivPlatformOPLL::acquire_ymfm(short* bufL, short* bufR, size_t start, size_t len) {
+  int os;
+  // the drum channels can't be muted in proper drums mode (same as Nuked)
+  unsigned int chanMask=0;
+  for (int i=0; i<9; i++) {
+    if ((i>=6 && properDrums) || !isMuted[i]) chanMask|=1<<i;
+  }
+
+  for (size_t h=start; h<start+len; h++) {
+    if (!writes.empty()) {
+      QueuedWrite& w=writes.front();
+      fm_ymfm->write(0,w.addr);
+      fm_ymfm->write(1,w.val);
+      regPool[w.addr&0xff]=w.val;
+      writes.pop();
+    }
+
+    fm_ymfm->generate(&out_ymfm,1,chanMask);
+
+    // match the level of the Nuked core (which averages over the
+    // multiplexed channel outputs)
+    os=(out_ymfm.data[0]+out_ymfm.data[1])*25;
+    if (os<-32768) os=-32768;
+    if (os>32767) os=32767;
+    bufL[h]=os;
+  }
 }
 
 void DivPlatformOPLL::acquire(short* bufL, short* bufR, size_t start, size_t len) {
-  acquire_nuked(bufL,bufR,start,len);
+  if (useYMFM) {
+    acquire_ymfm(bufL,bufR,start,len);
+  } else {
+    acquire_nuked(bufL,bufR,start,len);
+  }
 }
 
 void DivPlatformOPLL::tick() {
@@ -704,6 +733,34 @@ void* DivPlatformOPLL::getChanState(int ch) {
   return &chan[ch];
 }
 
+void* DivPlatformOPLL::getState() {
+  State* s=new State;
+  for (int i=0; i<11; i++) s->chan[i]=chan[i];
+  s->lastCustomMemory=lastCustomMemory;
+  s->drumState=drumState;
+  for (int i=0; i<5; i++) s->drumVol[i]=drumVol[i];
+  s->drums=drums;
+  memcpy(s->oldWrites,oldWrites,256*sizeof(short));
+  memcpy(s->pendingWrites,pendingWrites,256*sizeof(short));
+  return s;
+}
+
+void DivPlatformOPLL::setState(void* state) {
+  if (state==NULL) return;
+  State* s=(State*)state;
+  for (int i=0; i<11; i++) chan[i]=s->chan[i];
+  lastCustomMemory=s->lastCustomMemory;
+  drumState=s->drumState;
+  for (int i=0; i<5; i++) drumVol[i]=s->drumVol[i];
+  drums=s->drums;
+  memcpy(oldWrites,s->oldWrites,256*sizeof(short));
+  memcpy(pendingWrites,s->pendingWrites,256*sizeof(short));
+}
+
+void DivPlatformOPLL::freeState(void* state) {
+  delete (State*)state;
+}
+
 unsigned char* DivPlatformOPLL::getRegisterPool() {
   return regPool;
 }
@@ -713,9 +770,11 @@ int DivPlatformOPLL::getRegisterPoolSize() {
 }
 
 void DivPlatformOPLL::reset() {
-  while (!writes.empty()) writes.pop();
+  writes.clear();
   memset(regPool,0,256);
-  if (vrc7) {
+  if (useYMFM) {
+    fm_ymfm->reset();
+  } else if (vrc7) {
     OPLL_Reset(&fm,opll_type_ds1001);
   } else {
     OPLL_Reset(&fm,opll_type_ym2413);
@@ -812,8 +871,37 @@ void DivPlatformOPLL::setFlags(unsigned int flags) {
   } else {
     chipClock=COLOR_NTSC;
   }
-  rate=chipClock/36;
-  patchSet=flags>>4;
+  if (useYMFM) {
+    rate=chipClock/72;
+  } else {
+    rate=chipClock/36;
+  }
+
+  // the ymfm core has its patch set baked in, so recreate it on change
+  unsigned char newPatchSet=flags>>4;
+  if (useYMFM && (fm_ymfm==NULL || newPatchSet!=patchSet)) {
+    if (fm_ymfm!=NULL) delete fm_ymfm;
+    if (vrc7) {
+      fm_ymfm=new ymfm::ds1001(iface);
+    } else {
+      switch (newPatchSet) {
+        case 1:
+          fm_ymfm=new ymfm::ymf281(iface);
+          break;
+        case 2:
+          fm_ymfm=new ymfm::ym2423(iface);
+          break;
+        case 3:
+          fm_ymfm=new ymfm::ds1001(iface);
+          break;
+        default:
+          fm_ymfm=new ymfm::ym2413(iface);
+          break;
+      }
+    }
+    fm_ymfm->reset();
+  }
+  patchSet=newPatchSet;
 }
 
 int DivPlatformOPLL::init(DivEngine* p, int channels, int sugRate, unsigned int flags) {
@@ -821,6 +909,7 @@ int DivPlatformOPLL::init(DivEngine* p, int channels, int sugRate, unsigned int
   dumpWrites=false;
   skipRegisterWrites=false;
   patchSet=0;
+  fm_ymfm=NULL;
   for (int i=0; i<11; i++) {
     isMuted[i]=false;
   }
@@ -831,6 +920,10 @@ int DivPlatformOPLL::init(DivEngine* p, int channels, int sugRate, unsigned int
 }
 
 void DivPlatformOPLL::quit() {
+  if (fm_ymfm!=NULL) {
+    delete fm_ymfm;
+    fm_ymfm=NULL;
+  }
 }
 
 DivPlatformOPLL::~DivPlatformOPLL() {
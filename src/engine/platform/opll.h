@@ -21,12 +21,17 @@
 #define _OPLL_H
 #include "../dispatch.h"
 #include "../macroInt.h"
-#include <queue>
+#include "writeQueue.h"
+#include "sound/ymfm/ymfm_opl.h"
 
 extern "C" {
 #include "../../../extern/Nuked-OPLL/opll.h"
 }
 
+class DivOPLLInterface: public ymfm::ymfm_interface {
+
+};
+
 class DivPlatformOPLL: public DivDispatch {
   protected:
     struct Channel {
@@ -63,10 +68,14 @@ class DivPlatformOPLL: public DivDispatch {
       unsigned short addr;
       unsigned char val;
       bool addrOrVal;
+      QueuedWrite(): addr(0), val(0), addrOrVal(false) {}
       QueuedWrite(unsigned short a, unsigned char v): addr(a), val(v), addrOrVal(false) {}
     };
-    std::queue<QueuedWrite> writes;
+    DivWriteQueue<QueuedWrite> writes;
     opll_t fm;
+    ymfm::ym2413* fm_ymfm;
+    ymfm::ym2413::output_data out_ymfm;
+    DivOPLLInterface iface;
     int delay, lastCustomMemory;
     unsigned char lastBusy;
     unsigned char drumState;
@@ -87,6 +96,15 @@ class DivPlatformOPLL: public DivDispatch {
     int octave(int freq);
     int toFreq(int freq);
 
+    struct State {
+      Channel chan[11];
+      int lastCustomMemory;
+      unsigned char drumState;
+      unsigned char drumVol[5];
+      bool drums;
+      short oldWrites[256];
+      short pendingWrites[256];
+    };
     friend void putDispatchChan(void*,int,int);
 
     void acquire_nuked(short* bufL, short* bufR, size_t start, size_t len);
@@ -96,6 +114,9 @@ class DivPlatformOPLL: public DivDispatch {
     void acquire(short* bufL, short* bufR, size_t start, size_t len);
     int dispatch(DivCommand c);
     void* getChanState(int chan);
+    void* getState();
+    void setState(void* state);
+    void freeState(void* state);
     unsigned char* getRegisterPool();
     int getRegisterPoolSize();
     void reset();
@@ -74,43 +74,51 @@ const char* DivPlatformPCE::getEffectName(unsigned char effect) {
   return NULL;
 }
 
-void DivPlatformPCE::acquire(short* bufL, short* bufR, size_t start, size_t len) {
-  for (size_t h=start; h<start+len; h++) {
-    // PCM part
-    for (int i=0; i<6; i++) {
-      if (chan[i].pcm && chan[i].dacSample!=-1) {
-        chan[i].dacPeriod+=chan[i].dacRate;
-        if (chan[i].dacPeriod>rate) {
-          DivSample* s=parent->getSample(chan[i].dacSample);
-          if (s->samples<=0) {
+void DivPlatformPCE::runPCM() {
+  for (int i=0; i<6; i++) {
+    if (chan[i].pcm && chan[i].dacSample!=-1) {
+      chan[i].dacPeriod+=chan[i].dacRate;
+      if (chan[i].dacPeriod>rate) {
+        DivSample* s=parent->getSample(chan[i].dacSample);
+        if (s->samples<=0) {
+          chan[i].dacSample=-1;
+          continue;
+        }
+        chWrite(i,0x07,0);
+        chWrite(i,0x04,0xdf);
+        chWrite(i,0x06,(((unsigned char)s->data8[chan[i].dacPos]+0x80)>>3));
+        chan[i].dacPos++;
+        if (chan[i].dacPos>=s->samples) {
+          if (s->loopStart>=0 && s->loopStart<=(int)s->samples) {
+            chan[i].dacPos=s->loopStart;
+          } else {
             chan[i].dacSample=-1;
-            continue;
-          }
-          chWrite(i,0x07,0);
-          chWrite(i,0x04,0xdf);
-          chWrite(i,0x06,(((unsigned char)s->data8[chan[i].dacPos]+0x80)>>3));
-          chan[i].dacPos++;
-          if (chan[i].dacPos>=s->samples) {
-            if (s->loopStart>=0 && s->loopStart<=(int)s->samples) {
-              chan[i].dacPos=s->loopStart;
-            } else {
-              chan[i].dacSample=-1;
-            }
           }
-          chan[i].dacPeriod-=rate;
         }
+        chan[i].dacPeriod-=rate;
       }
     }
+  }
+}
+
+void DivPlatformPCE::runWrites() {
+  cycles=0;
+  while (!writes.empty() && cycles<24) {
+    QueuedWrite w=writes.front();
+    pce->Write(cycles,w.addr,w.val);
+    regPool[w.addr&0x0f]=w.val;
+    //cycles+=2;
+    writes.pop();
+  }
+}
+
+void DivPlatformPCE::acquireOne(short& outL, short& outR) {
+  {
+    // PCM part
+    runPCM();
   
     // PCE part
-    cycles=0;
-    while (!writes.empty() && cycles<24) {
-      QueuedWrite w=writes.front();
-      pce->Write(cycles,w.addr,w.val);
-      regPool[w.addr&0x0f]=w.val;
-      //cycles+=2;
-      writes.pop();
-    }
+    runWrites();
     memset(tempL,0,24*sizeof(int));
     memset(tempR,0,24*sizeof(int));
     pce->Update(24);
@@ -125,11 +133,59 @@ void DivPlatformPCE::acquire(short* bufL, short* bufR, size_t start, size_t len)
     if (tempR[0]>32767) tempR[0]=32767;
     
     //printf("tempL: %d tempR: %d\n",tempL,tempR);
-    bufL[h]=tempL[0];
-    bufR[h]=tempR[0];
+    outL=tempL[0];
+    outR=tempR[0];
   }
 }
 
+void DivPlatformPCE::acquire(short* bufL, short* bufR, size_t start, size_t len) {
+  for (size_t h=start; h<start+len; h++) {
+    acquireOne(bufL[h],bufR[h]);
+  }
+}
+
+bool DivPlatformPCE::isDirect() {
+  return true;
+}
+
+void pceLevelChanged(void* data, int32_t timestamp, int ch, int32_t l, int32_t r) {
+  DivPlatformPCE* p=(DivPlatformPCE*)data;
+  // a change within a sample shows up at the start of the next one
+  size_t pos=p->directPos+(timestamp+23)/24;
+  l=(l>>1)+(l>>2);
+  r=(r>>1)+(r>>2);
+  p->directOut->add(0,pos,l-p->chanLevel[ch][0]);
+  p->directOut->add(1,pos,r-p->chanLevel[ch][1]);
+  p->chanLevel[ch][0]=l;
+  p->chanLevel[ch][1]=r;
+}
+
+void DivPlatformPCE::acquireDirect(DivDeltaBuf& out, size_t start, size_t len) {
+  bool pcm=false;
+  for (int i=0; i<6; i++) {
+    if (chan[i].pcm && chan[i].dacSample!=-1) pcm=true;
+  }
+  directOut=&out;
+  pce->SetLevelFunc(pceLevelChanged,this);
+  if (pcm) {
+    // samples are written on every output sample
+    for (size_t h=start; h<start+len; h++) {
+      directPos=h;
+      runPCM();
+      runWrites();
+      pce->Update(24);
+      pce->ResetTS(0);
+    }
+  } else {
+    // the PSG reports every level change with its time, so run it in one go
+    directPos=start;
+    runWrites();
+    pce->Update(24*len);
+    pce->ResetTS(0);
+  }
+  pce->SetLevelFunc(NULL,NULL);
+}
+
 void DivPlatformPCE::updateWave(int ch) {
   DivWavetable* wt=parent->getWave(chan[ch].wave);
   chWrite(ch,0x04,0x5f);
@@ -446,6 +502,28 @@ void* DivPlatformPCE::getChanState(int ch) {
   return &chan[ch];
 }
 
+void* DivPlatformPCE::getState() {
+  State* s=new State;
+  for (int i=0; i<6; i++) s->chan[i]=chan[i];
+  s->sampleBank=sampleBank;
+  s->lfoMode=lfoMode;
+  s->lfoSpeed=lfoSpeed;
+  return s;
+}
+
+void DivPlatformPCE::setState(void* state) {
+  if (state==NULL) return;
+  State* s=(State*)state;
+  for (int i=0; i<6; i++) chan[i]=s->chan[i];
+  sampleBank=s->sampleBank;
+  lfoMode=s->lfoMode;
+  lfoSpeed=s->lfoSpeed;
+}
+
+void DivPlatformPCE::freeState(void* state) {
+  delete (State*)state;
+}
+
 unsigned char* DivPlatformPCE::getRegisterPool() {
   return regPool;
 }
@@ -455,7 +533,7 @@ int DivPlatformPCE::getRegisterPoolSize() {
 }
 
 void DivPlatformPCE::reset() {
-  while (!writes.empty()) writes.pop();
+  writes.clear();
   memset(regPool,0,128);
   for (int i=0; i<6; i++) {
     chan[i]=DivPlatformPCE::Channel();
@@ -532,6 +610,9 @@ int DivPlatformPCE::init(DivEngine* p, int channels, int sugRate, unsigned int f
     isMuted[i]=false;
   }
   setFlags(flags);
+  memset(chanLevel,0,6*2*sizeof(int));
+  directOut=NULL;
+  directPos=0;
   pce=new PCE_PSG(tempL,tempR,PCE_PSG::REVISION_HUC6280A);
   reset();
   return 6;
@@ -21,7 +21,7 @@
 #define _PCE_H
 
 #include "../dispatch.h"
-#include <queue>
+#include "writeQueue.h"
 #include "../macroInt.h"
 #include "sound/pce_psg.h"
 
@@ -64,23 +64,43 @@ class DivPlatformPCE: public DivDispatch {
   struct QueuedWrite {
       unsigned char addr;
       unsigned char val;
+      QueuedWrite(): addr(0), val(0) {}
       QueuedWrite(unsigned char a, unsigned char v): addr(a), val(v) {}
   };
-  std::queue<QueuedWrite> writes;
+  DivWriteQueue<QueuedWrite> writes;
   unsigned char lastPan;
 
   int cycles, curChan, delay;
   int tempL[32];
   int tempR[32];
+  // level of each channel as last reported to directOut
+  int chanLevel[6][2];
+  DivDeltaBuf* directOut;
+  size_t directPos;
   unsigned char sampleBank, lfoMode, lfoSpeed;
   PCE_PSG* pce;
   unsigned char regPool[128];
   void updateWave(int ch);
+  struct State {
+    Channel chan[6];
+    unsigned char sampleBank;
+    unsigned char lfoMode;
+    unsigned char lfoSpeed;
+  };
+  void runPCM();
+  void runWrites();
+  void acquireOne(short& outL, short& outR);
   friend void putDispatchChan(void*,int,int);
+  friend void pceLevelChanged(void*,int32_t,int,int32_t,int32_t);
   public:
     void acquire(short* bufL, short* bufR, size_t start, size_t len);
+    bool isDirect();
+    void acquireDirect(DivDeltaBuf& out, size_t start, size_t len);
     int dispatch(DivCommand c);
     void* getChanState(int chan);
+    void* getState();
+    void setState(void* state);
+    void freeState(void* state);
     unsigned char* getRegisterPool();
     int getRegisterPoolSize();
     void reset();
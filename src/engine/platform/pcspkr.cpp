@@ -56,6 +56,40 @@ void DivPlatformPCSpeaker::acquire(short* bufL, short* bufR, size_t start, size_
   }
 }
 
+bool DivPlatformPCSpeaker::isDirect() {
+  return true;
+}
+
+void DivPlatformPCSpeaker::acquireDirect(DivDeltaBuf& out, size_t start, size_t len) {
+  if (!on) {
+    out.put(0,start,0);
+    return;
+  }
+  out.put(0,start,(flip && !isMuted[0])?32767:0);
+  // the output only changes on a flip, so jump straight to the next one
+  size_t end=start+len;
+  size_t h=start;
+  while (h<end) {
+    size_t skip=pos/PCSPKR_DIVIDER;
+    if (skip>=end-h) {
+      pos-=(end-h)*PCSPKR_DIVIDER;
+      break;
+    }
+    h+=skip;
+    pos-=(skip+1)*PCSPKR_DIVIDER;
+    while (pos<0) {
+      if (freq<1) {
+        pos=1;
+      } else {
+        pos+=flip?(freq>>1):((freq+1)>>1);
+      }
+      flip=!flip;
+    }
+    out.put(0,h,(flip && !isMuted[0])?32767:0);
+    h++;
+  }
+}
+
 void DivPlatformPCSpeaker::tick() {
   for (int i=0; i<1; i++) {
     chan[i].std.next();
@@ -201,6 +235,26 @@ void* DivPlatformPCSpeaker::getChanState(int ch) {
   return &chan[ch];
 }
 
+void* DivPlatformPCSpeaker::getState() {
+  State* s=new State;
+  for (int i=0; i<1; i++) s->chan[i]=chan[i];
+  s->on=on;
+  s->freq=freq;
+  return s;
+}
+
+void DivPlatformPCSpeaker::setState(void* state) {
+  if (state==NULL) return;
+  State* s=(State*)state;
+  for (int i=0; i<1; i++) chan[i]=s->chan[i];
+  on=s->on;
+  freq=s->freq;
+}
+
+void DivPlatformPCSpeaker::freeState(void* state) {
+  delete (State*)state;
+}
+
 unsigned char* DivPlatformPCSpeaker::getRegisterPool() {
   return regPool;
 }
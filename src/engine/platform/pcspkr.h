@@ -57,12 +57,22 @@ class DivPlatformPCSpeaker: public DivDispatch {
   unsigned short freq;
   unsigned char regPool[2];
 
+  struct State {
+    Channel chan[1];
+    bool on;
+    unsigned short freq;
+  };
   friend void putDispatchChan(void*,int,int);
 
   public:
     void acquire(short* bufL, short* bufR, size_t start, size_t len);
+    bool isDirect();
+    void acquireDirect(DivDeltaBuf& out, size_t start, size_t len);
     int dispatch(DivCommand c);
     void* getChanState(int chan);
+    void* getState();
+    void setState(void* state);
+    void freeState(void* state);
     unsigned char* getRegisterPool();
     int getRegisterPoolSize();
     void reset();
@@ -520,6 +520,30 @@ void* DivPlatformQSound::getChanState(int ch) {
   return &chan[ch];
 }
 
+void* DivPlatformQSound::getState() {
+  State* s=new State;
+  for (int i=0; i<19; i++) s->chan[i]=chan[i];
+  for (int i=0; i<19; i++) s->pan[i]=qsound_read_data(&chip,Q1_PAN+i);
+  for (int i=0; i<16; i++) s->echo[i]=qsound_read_data(&chip,Q1_ECHO+i);
+  s->echoFeedback=qsound_read_data(&chip,Q1_ECHO_FEEDBACK);
+  s->echoLength=qsound_read_data(&chip,Q1_ECHO_LENGTH);
+  return s;
+}
+
+void DivPlatformQSound::setState(void* state) {
+  if (state==NULL) return;
+  State* s=(State*)state;
+  for (int i=0; i<19; i++) chan[i]=s->chan[i];
+  for (int i=0; i<19; i++) immWrite(Q1_PAN+i,s->pan[i]);
+  for (int i=0; i<16; i++) immWrite(Q1_ECHO+i,s->echo[i]);
+  immWrite(Q1_ECHO_FEEDBACK,s->echoFeedback);
+  immWrite(Q1_ECHO_LENGTH,s->echoLength);
+}
+
+void DivPlatformQSound::freeState(void* state) {
+  delete (State*)state;
+}
+
 void DivPlatformQSound::reset() {
   for (int i=0; i<16; i++) {
     chan[i]=DivPlatformQSound::Channel();
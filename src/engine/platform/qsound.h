@@ -63,12 +63,22 @@ class DivPlatformQSound: public DivDispatch {
   struct qsound_chip chip;
   unsigned short regPool[512];
 
+  struct State {
+    Channel chan[19];
+    // panning and echo are written even when skipping register writes
+    unsigned short pan[19];
+    unsigned short echo[16];
+    unsigned short echoFeedback, echoLength;
+  };
   friend void putDispatchChan(void*,int,int);
 
   public:
     void acquire(short* bufL, short* bufR, size_t start, size_t len);
     int dispatch(DivCommand c);
     void* getChanState(int chan);
+    void* getState();
+    void setState(void* state);
+    void freeState(void* state);
     unsigned char* getRegisterPool();
     int getRegisterPoolSize();
     int getRegisterPoolDepth();
@@ -369,6 +369,42 @@ void* DivPlatformSAA1099::getChanState(int ch) {
   return &chan[ch];
 }
 
+void* DivPlatformSAA1099::getState() {
+  State* s=new State;
+  for (int i=0; i<6; i++) s->chan[i]=chan[i];
+  s->dacMode=dacMode;
+  s->dacPeriod=dacPeriod;
+  s->dacRate=dacRate;
+  s->dacPos=dacPos;
+  s->dacSample=dacSample;
+  s->sampleBank=sampleBank;
+  for (int i=0; i<2; i++) s->saaEnv[i]=saaEnv[i];
+  for (int i=0; i<2; i++) s->saaNoise[i]=saaNoise[i];
+  memcpy(s->oldWrites,oldWrites,16*sizeof(short));
+  memcpy(s->pendingWrites,pendingWrites,16*sizeof(short));
+  return s;
+}
+
+void DivPlatformSAA1099::setState(void* state) {
+  if (state==NULL) return;
+  State* s=(State*)state;
+  for (int i=0; i<6; i++) chan[i]=s->chan[i];
+  dacMode=s->dacMode;
+  dacPeriod=s->dacPeriod;
+  dacRate=s->dacRate;
+  dacPos=s->dacPos;
+  dacSample=s->dacSample;
+  sampleBank=s->sampleBank;
+  for (int i=0; i<2; i++) saaEnv[i]=s->saaEnv[i];
+  for (int i=0; i<2; i++) saaNoise[i]=s->saaNoise[i];
+  memcpy(oldWrites,s->oldWrites,16*sizeof(short));
+  memcpy(pendingWrites,s->pendingWrites,16*sizeof(short));
+}
+
+void DivPlatformSAA1099::freeState(void* state) {
+  delete (State*)state;
+}
+
 unsigned char* DivPlatformSAA1099::getRegisterPool() {
   return regPool;
 }
@@ -378,7 +414,7 @@ int DivPlatformSAA1099::getRegisterPoolSize() {
 }
 
 void DivPlatformSAA1099::reset() {
-  while (!writes.empty()) writes.pop();
+  writes.clear();
   memset(regPool,0,32);
   switch (core) {
     case DIV_SAA_CORE_MAME:
@@ -21,7 +21,7 @@
 #define _SAA_H
 #include "../dispatch.h"
 #include "../macroInt.h"
-#include <queue>
+#include "writeQueue.h"
 #include "sound/saa1099.h"
 #include "../../../extern/SAASound/src/SAASound.h"
 
@@ -50,9 +50,10 @@ class DivPlatformSAA1099: public DivDispatch {
       unsigned short addr;
       unsigned char val;
       bool addrOrVal;
+      QueuedWrite(): addr(0), val(0), addrOrVal(false) {}
       QueuedWrite(unsigned short a, unsigned char v): addr(a), val(v), addrOrVal(false) {}
     };
-    std::queue<QueuedWrite> writes;
+    DivWriteQueue<QueuedWrite> writes;
     DivSAACores core;
     saa1099_device saa;
     CSAASound* saa_saaSound;
@@ -76,6 +77,19 @@ class DivPlatformSAA1099: public DivDispatch {
     size_t saaBufLen;
     unsigned char saaEnv[2];
     unsigned char saaNoise[2];
+    struct State {
+      Channel chan[6];
+      bool dacMode;
+      int dacPeriod;
+      int dacRate;
+      int dacPos;
+      int dacSample;
+      unsigned char sampleBank;
+      unsigned char saaEnv[2];
+      unsigned char saaNoise[2];
+      short oldWrites[16];
+      short pendingWrites[16];
+    };
     friend void putDispatchChan(void*,int,int);
 
     void acquire_e(short* bufL, short* bufR, size_t start, size_t len);
@@ -86,6 +100,9 @@ class DivPlatformSAA1099: public DivDispatch {
     void acquire(short* bufL, short* bufR, size_t start, size_t len);
     int dispatch(DivCommand c);
     void* getChanState(int chan);
+    void* getState();
+    void setState(void* state);
+    void freeState(void* state);
     unsigned char* getRegisterPool();
     int getRegisterPoolSize();
     void reset();
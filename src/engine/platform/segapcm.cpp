@@ -19,6 +19,7 @@
 
 #include "segapcm.h"
 #include "../engine.h"
+#include "../mix.h"
 #include <string.h>
 #include <math.h>
 
@@ -35,45 +36,64 @@ const char* DivPlatformSegaPCM::getEffectName(unsigned char effect) {
 }
 
 void DivPlatformSegaPCM::acquire(short* bufL, short* bufR, size_t start, size_t len) {
-  static int os[2];
+  if (mixBufLen<len) {
+    mixBufLen=len;
+    delete[] mixBuf[0];
+    delete[] mixBuf[1];
+    delete[] voiceBuf;
+    mixBuf[0]=new int[mixBufLen];
+    mixBuf[1]=new int[mixBufLen];
+    voiceBuf=new short[mixBufLen];
+  }
+  memset(mixBuf[0],0,len*sizeof(int));
+  memset(mixBuf[1],0,len*sizeof(int));
 
-  for (size_t h=start; h<start+len; h++) {
-    os[0]=0; os[1]=0;
-    // do a PCM cycle
-    pcmL=0; pcmR=0;
-    for (int i=0; i<16; i++) {
-      if (chan[i].pcm.sample>=0 && chan[i].pcm.sample<parent->song.sampleLen) {
-        DivSample* s=parent->getSample(chan[i].pcm.sample);
-        if (s->samples<=0) {
-          chan[i].pcm.sample=-1;
-          continue;
-        }
-        if (!isMuted[i]) {
-          pcmL+=(s->data8[chan[i].pcm.pos>>8]*chan[i].chVolL);
-          pcmR+=(s->data8[chan[i].pcm.pos>>8]*chan[i].chVolR);
+  // render one voice at a time, in runs which end at the loop point or the end
+  for (int i=0; i<16; i++) {
+    Channel::PCMChannel& pcm=chan[i].pcm;
+    if (pcm.sample<0 || pcm.sample>=parent->song.sampleLen) continue;
+    DivSample* s=parent->getSample(pcm.sample);
+    if (s->samples<=0) {
+      pcm.sample=-1;
+      continue;
+    }
+    unsigned int end=s->samples<<8;
+    size_t h=0;
+    while (h<len) {
+      if (pcm.pos>=end) {
+        pcm.sample=-1;
+        break;
+      }
+      size_t run=len-h;
+      if (pcm.freq>0) {
+        size_t left=(end-pcm.pos+pcm.freq-1)/pcm.freq;
+        if (left<run) run=left;
+      }
+      if (isMuted[i]) {
+        pcm.pos+=run*pcm.freq;
+      } else {
+        for (size_t j=h; j<h+run; j++) {
+          voiceBuf[j]=s->data8[pcm.pos>>8];
+          pcm.pos+=pcm.freq;
         }
-        chan[i].pcm.pos+=chan[i].pcm.freq;
-        if (chan[i].pcm.pos>=(s->samples<<8)) {
-          if (s->loopStart>=0 && s->loopStart<=(int)s->samples) {
-            chan[i].pcm.pos=s->loopStart<<8;
-          } else {
-            chan[i].pcm.sample=-1;
-          }
+      }
+      h+=run;
+      if (pcm.pos>=end) {
+        if (s->loopStart>=0 && s->loopStart<=(int)s->samples) {
+          pcm.pos=s->loopStart<<8;
+        } else {
+          pcm.sample=-1;
+          break;
         }
       }
     }
-
-    os[0]=pcmL;
-    if (os[0]<-32768) os[0]=-32768;
-    if (os[0]>32767) os[0]=32767;
-
-    os[1]=pcmR;
-    if (os[1]<-32768) os[1]=-32768;
-    if (os[1]>32767) os[1]=32767;
-  
-    bufL[h]=os[0];
-    bufR[h]=os[1];
+    if (!isMuted[i] && h>0) {
+      divMixVoice(mixBuf[0],mixBuf[1],voiceBuf,chan[i].chVolL,chan[i].chVolR,0,h);
+    }
   }
+
+  divMixClamp(bufL+start,mixBuf[0],len);
+  divMixClamp(bufR+start,mixBuf[1],len);
 }
 
 void DivPlatformSegaPCM::tick() {
@@ -327,6 +347,28 @@ void* DivPlatformSegaPCM::getChanState(int ch) {
   return &chan[ch];
 }
 
+void* DivPlatformSegaPCM::getState() {
+  State* s=new State;
+  for (int i=0; i<16; i++) s->chan[i]=chan[i];
+  s->sampleBank=sampleBank;
+  memcpy(s->oldWrites,oldWrites,256*sizeof(short));
+  memcpy(s->pendingWrites,pendingWrites,256*sizeof(short));
+  return s;
+}
+
+void DivPlatformSegaPCM::setState(void* state) {
+  if (state==NULL) return;
+  State* s=(State*)state;
+  for (int i=0; i<16; i++) chan[i]=s->chan[i];
+  sampleBank=s->sampleBank;
+  memcpy(oldWrites,s->oldWrites,256*sizeof(short));
+  memcpy(pendingWrites,s->pendingWrites,256*sizeof(short));
+}
+
+void DivPlatformSegaPCM::freeState(void* state) {
+  delete (State*)state;
+}
+
 unsigned char* DivPlatformSegaPCM::getRegisterPool() {
   return regPool;
 }
@@ -344,7 +386,7 @@ void DivPlatformSegaPCM::poke(std::vector<DivRegWrite>& wlist) {
 }
 
 void DivPlatformSegaPCM::reset() {
-  while (!writes.empty()) writes.pop();
+  writes.clear();
   memset(regPool,0,256);
   for (int i=0; i<16; i++) {
     chan[i]=DivPlatformSegaPCM::Channel();
@@ -377,6 +419,13 @@ void DivPlatformSegaPCM::setFlags(unsigned int flags) {
   rate=31250;
 }
 
+bool DivPlatformSegaPCM::isQuiet() {
+  for (int i=0; i<16; i++) {
+    if (chan[i].pcm.sample>=0 && chan[i].pcm.sample<parent->song.sampleLen) return false;
+  }
+  return true;
+}
+
 bool DivPlatformSegaPCM::isStereo() {
   return true;
 }
@@ -388,6 +437,10 @@ int DivPlatformSegaPCM::init(DivEngine* p, int channels, int sugRate, unsigned i
   for (int i=0; i<16; i++) {
     isMuted[i]=false;
   }
+  mixBufLen=65536;
+  mixBuf[0]=new int[mixBufLen];
+  mixBuf[1]=new int[mixBufLen];
+  voiceBuf=new short[mixBufLen];
   setFlags(flags);
   reset();
 
@@ -395,6 +448,9 @@ int DivPlatformSegaPCM::init(DivEngine* p, int channels, int sugRate, unsigned i
 }
 
 void DivPlatformSegaPCM::quit() {
+  delete[] mixBuf[0];
+  delete[] mixBuf[1];
+  delete[] voiceBuf;
 }
 
 DivPlatformSegaPCM::~DivPlatformSegaPCM() {
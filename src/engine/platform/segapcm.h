@@ -21,7 +21,7 @@
 #define _SEGAPCM_H
 #include "../dispatch.h"
 #include "../instrument.h"
-#include <queue>
+#include "writeQueue.h"
 #include "../macroInt.h"
 
 class DivPlatformSegaPCM: public DivDispatch {
@@ -50,11 +50,15 @@ class DivPlatformSegaPCM: public DivDispatch {
       unsigned short addr;
       unsigned char val;
       bool addrOrVal;
+      QueuedWrite(): addr(0), val(0), addrOrVal(false) {}
       QueuedWrite(unsigned short a, unsigned char v): addr(a), val(v), addrOrVal(false) {}
     };
-    std::queue<QueuedWrite> writes;
+    DivWriteQueue<QueuedWrite> writes;
     int delay, baseFreqOff;
     int pcmL, pcmR, pcmCycles;
+    int* mixBuf[2];
+    short* voiceBuf;
+    size_t mixBufLen;
     unsigned char sampleBank;
     unsigned char lastBusy;
     unsigned char amDepth, pmDepth;
@@ -68,12 +72,21 @@ class DivPlatformSegaPCM: public DivDispatch {
     short oldWrites[256];
     short pendingWrites[256];
   
+    struct State {
+      Channel chan[16];
+      unsigned char sampleBank;
+      short oldWrites[256];
+      short pendingWrites[256];
+    };
     friend void putDispatchChan(void*,int,int);
   
   public:
     void acquire(short* bufL, short* bufR, size_t start, size_t len);
     int dispatch(DivCommand c);
     void* getChanState(int chan);
+    void* getState();
+    void setState(void* state);
+    void freeState(void* state);
     unsigned char* getRegisterPool();
     int getRegisterPoolSize();
     void reset();
@@ -82,6 +95,7 @@ class DivPlatformSegaPCM: public DivDispatch {
     void muteChannel(int ch, bool mute);
     void notifyInsChange(int ins);
     void setFlags(unsigned int flags);
+    bool isQuiet();
     bool isStereo();
     void poke(unsigned int addr, unsigned short val);
     void poke(std::vector<DivRegWrite>& wlist);
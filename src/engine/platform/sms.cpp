@@ -53,6 +53,26 @@ int DivPlatformSMS::acquireOne() {
   return v;
 }
 
+bool DivPlatformSMS::isDirect() {
+  return true;
+}
+
+void DivPlatformSMS::acquireDirect(DivDeltaBuf& out, size_t start, size_t len) {
+  size_t h=start;
+  size_t end=start+len;
+  while (h<end) {
+    out.put(0,h,acquireOne());
+    h++;
+    // nothing changes until a counter expires, so skip to the sample before that
+    size_t skip=sn->samples_to_next_event()-1;
+    if (skip>end-h) skip=end-h;
+    if (skip>0) {
+      sn->skip_samples(skip);
+      h+=skip;
+    }
+  }
+}
+
 void DivPlatformSMS::tick() {
   for (int i=0; i<4; i++) {
     chan[i].std.next();
@@ -260,6 +280,28 @@ void* DivPlatformSMS::getChanState(int ch) {
   return &chan[ch];
 }
 
+void* DivPlatformSMS::getState() {
+  State* s=new State;
+  for (int i=0; i<4; i++) s->chan[i]=chan[i];
+  s->oldValue=oldValue;
+  s->snNoiseMode=snNoiseMode;
+  s->updateSNMode=updateSNMode;
+  return s;
+}
+
+void DivPlatformSMS::setState(void* state) {
+  if (state==NULL) return;
+  State* s=(State*)state;
+  for (int i=0; i<4; i++) chan[i]=s->chan[i];
+  oldValue=s->oldValue;
+  snNoiseMode=s->snNoiseMode;
+  updateSNMode=s->updateSNMode;
+}
+
+void DivPlatformSMS::freeState(void* state) {
+  delete (State*)state;
+}
+
 void DivPlatformSMS::reset() {
   for (int i=0; i<4; i++) {
     chan[i]=DivPlatformSMS::Channel();
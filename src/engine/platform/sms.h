@@ -55,12 +55,23 @@ class DivPlatformSMS: public DivDispatch {
   bool resetPhase;
   bool isRealSN;
   sn76496_base_device* sn;
+  struct State {
+    Channel chan[4];
+    unsigned char oldValue;
+    unsigned char snNoiseMode;
+    bool updateSNMode;
+  };
   friend void putDispatchChan(void*,int,int);
   public:
     int acquireOne();
     void acquire(short* bufL, short* bufR, size_t start, size_t len);
+    bool isDirect();
+    void acquireDirect(DivDeltaBuf& out, size_t start, size_t len);
     int dispatch(DivCommand c);
     void* getChanState(int chan);
+    void* getState();
+    void setState(void* state);
+    void freeState(void* state);
     void reset();
     void forceIns();
     void tick();
@@ -1213,6 +1213,55 @@ void ay8910_device::sound_stream_update(short** outputs, int outLen)
 	}
 }
 
+int ay8910_device::samples_to_next_event()
+{
+	const int inc = is_expanded_mode() ? 16 : 1;
+	int ret = std::max<int>(1,noise_period()-m_count_noise);
+
+	for (int chan = 0; chan < NUM_CHANNELS; chan++)
+	{
+		const int period = std::max<int>(1,m_tone[chan].period);
+		ret = std::min<int>(ret,std::max<int>(1,(period-m_tone[chan].count+inc-1)/inc));
+
+		const envelope_t *envelope = &m_envelope[chan];
+		if (envelope->holding == 0)
+			ret = std::min<int>(ret,std::max<int>(1,(int)(envelope->period*m_step)-envelope->count));
+	}
+	return ret;
+}
+
+void ay8910_device::skip_samples(int samples)
+{
+	const int inc = is_expanded_mode() ? 16 : 1;
+	for (int chan = 0; chan < NUM_CHANNELS; chan++)
+	{
+		m_tone[chan].count += samples*inc;
+		if (m_envelope[chan].holding == 0)
+			m_envelope[chan].count += samples;
+	}
+	m_count_noise += samples;
+}
+
+void ay8910_device::advance(int samples)
+{
+	short dummy[NUM_CHANNELS];
+	short *outputs[NUM_CHANNELS] = { &dummy[0], &dummy[1], &dummy[2] };
+
+	while (samples > 0)
+	{
+		const int next = samples_to_next_event();
+		if (next > samples)
+		{
+			skip_samples(samples);
+			return;
+		}
+		/* render the sample in which the event happens */
+		skip_samples(next - 1);
+		sound_stream_update(outputs, 1);
+		samples -= next;
+	}
+}
+
 void ay8910_device::build_mixer_table()
 {
 	int normalize = 0;
@@ -136,6 +136,14 @@ public:
 	// sound stream update overrides
 	void sound_stream_update(short** outputs, int outLen);
 
+	// the output only changes when a tone, noise or envelope counter expires.
+	// returns how many samples sound_stream_update() would render until then, the last one included.
+	int samples_to_next_event();
+	// advances the counters by fewer samples than samples_to_next_event() without rendering.
+	void skip_samples(int samples);
+	// advances the whole state by any amount of samples without rendering them.
+	void advance(int samples);
+
 	void ay8910_write_ym(int addr, unsigned char data);
 	unsigned char ay8910_read_ym();
 	void ay8910_reset_ym(bool ay8930);
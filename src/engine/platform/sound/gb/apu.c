@@ -285,7 +285,7 @@ static void render(GB_gameboy_t *gb)
     gb->apu_output.final_sample=filtered_output;
 }
 
-static void update_square_sample(GB_gameboy_t *gb, unsigned index)
+static void update_square_sample(GB_gameboy_t *gb, unsigned index, unsigned cycles_offset)
 {
     if (gb->apu.square_channels[index].current_sample_index & 0x80) return;
 
@@ -293,7 +293,7 @@ static void update_square_sample(GB_gameboy_t *gb, unsigned index)
     update_sample(gb, index,
                   duties[gb->apu.square_channels[index].current_sample_index + duty * 8]?
                   gb->apu.square_channels[index].current_volume : 0,
-                  0);
+                  cycles_offset);
 }
 
 
@@ -405,7 +405,7 @@ static void tick_square_envelope(GB_gameboy_t *gb, enum GB_CHANNELS index)
     }
 
     if (gb->apu.is_active[index]) {
-        update_square_sample(gb, index);
+        update_square_sample(gb, index, 0);
     }
 }
 
@@ -656,7 +656,7 @@ void GB_apu_run(GB_gameboy_t *gb)
                         gb->apu.pcm_mask[0] &= i == GB_SQUARE_1? 0xF0 : 0x0F;
                     }
 
-                    update_square_sample(gb, i);
+                    update_square_sample(gb, i, cycles - cycles_left);
                 }
                 if (cycles_left) {
                     gb->apu.square_channels[i].sample_countdown -= cycles_left;
@@ -1013,7 +1013,7 @@ void GB_apu_write(GB_gameboy_t *gb, uint8_t reg, uint8_t value)
                 nrx2_glitch(gb, &gb->apu.square_channels[index].current_volume,
                             value, gb->io_registers[reg], &gb->apu.square_channels[index].volume_countdown,
                             &gb->apu.square_envelope_clock[index]);
-                update_square_sample(gb, index);
+                update_square_sample(gb, index, 0);
             }
 
             break;
@@ -1086,7 +1086,7 @@ void GB_apu_write(GB_gameboy_t *gb, uint8_t reg, uint8_t value)
                    started sound). The playback itself is not instant which is why we don't update the sample for other
                    cases. */
                 if (gb->apu.is_active[index]) {
-                    update_square_sample(gb, index);
+                    update_square_sample(gb, index, 0);
                 }
 
                 gb->apu.square_channels[index].volume_countdown = gb->io_registers[index == GB_SQUARE_1 ? GB_IO_NR12 : GB_IO_NR22] & 7;
@@ -70,6 +70,11 @@ static const int scale_tab[] =
 
 inline void PCE_PSG::UpdateOutputSub(const int32_t timestamp, psg_channel *ch, const int32_t samp0, const int32_t samp1)
 {
+  if(LevelFunc)
+  {
+   LevelFunc(LevelData, timestamp, ch - channel, samp0, samp1);
+   return;
+  }
   HRBufs[0][timestamp]+=samp0;
   HRBufs[1][timestamp]+=samp1;
   /*
@@ -424,6 +429,8 @@ PCE_PSG::PCE_PSG(int32_t* hr_l, int32_t* hr_r, int want_revision)
   }
   HRBufs[0] = hr_l;
   HRBufs[1] = hr_r;
+  LevelFunc = NULL;
+  LevelData = NULL;
 
   lastts = 0;
   for(int ch = 0; ch < 6; ch++)
@@ -765,6 +772,12 @@ void PCE_PSG::Update(int32_t timestamp)
  }
 }
 
+void PCE_PSG::SetLevelFunc(void (*func)(void* data, int32_t timestamp, int chnum, int32_t samp0, int32_t samp1), void* data)
+{
+ LevelFunc = func;
+ LevelData = data;
+}
+
 void PCE_PSG::ResetTS(int32_t ts_base)
 {
  lastts = ts_base;
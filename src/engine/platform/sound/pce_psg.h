@@ -141,6 +141,9 @@ class PCE_PSG
   void Update(int32_t timestamp);
   void ResetTS(int32_t ts_base = 0);
 
+  // If set, channel levels are reported to this function instead of being added into the HR buffers.
+  void SetLevelFunc(void (*func)(void* data, int32_t timestamp, int chnum, int32_t samp0, int32_t samp1), void* data);
+
   // TODO: timestamp
   uint32_t GetRegister(const unsigned int id, char *special, const uint32_t special_len);
   void SetRegister(const unsigned int id, const uint32_t value);
@@ -185,6 +188,9 @@ class PCE_PSG
 
   int32_t* HRBufs[2];
 
+  void (*LevelFunc)(void* data, int32_t timestamp, int chnum, int32_t samp0, int32_t samp1);
+  void* LevelData;
+
   int32_t dbtable_volonly[32];
 
   int32_t dbtable[32][32];
@@ -346,3 +346,28 @@ void sn76496_base_device::sound_stream_update(short* outputs, int outLen)
 		outputs[sampindex]=out;
 	}
 }
+
+int sn76496_base_device::samples_to_next_event()
+{
+	int32_t clocks = m_count[0];
+	for (int i = 1; i < 4; i++)
+	{
+		if (m_count[i] < clocks) clocks = m_count[i];
+	}
+	if (clocks < 1) clocks = 1;
+	return m_current_clock + 1 + (clocks - 1) * m_clock_divider;
+}
+
+void sn76496_base_device::skip_samples(int samples)
+{
+	if (samples <= m_current_clock)
+	{
+		m_current_clock -= samples;
+		return;
+	}
+	const int32_t rest = samples - (m_current_clock + 1);
+	const int32_t clocks = 1 + rest / m_clock_divider;
+	m_current_clock = m_clock_divider - 1 - rest % m_clock_divider;
+	for (int i = 0; i < 4; i++)
+		m_count[i] -= clocks;
+}
@@ -16,6 +16,11 @@ public:
 	void write(u8 data);
   void device_start();
 	void sound_stream_update(short* outputs, int outLen);
+	// the output only changes when a counter expires.
+	// returns how many samples sound_stream_update() would render until then, the last one included.
+	int samples_to_next_event();
+	// advances the counters by fewer samples than samples_to_next_event() without rendering.
+	void skip_samples(int samples);
 	//DECLARE_READ_LINE_MEMBER( ready_r ) { return m_ready_state ? 1 : 0; }
 
 	sn76496_base_device(
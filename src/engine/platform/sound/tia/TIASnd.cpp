@@ -350,6 +350,25 @@ void TIASound::process(short* buffer, unsigned int samples)
   myDivNCnt[1] = div_n_cnt1;
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+unsigned int TIASound::samplesToNextEvent() const
+{
+  // A counter of 1 is clocked on the next sample, and one of 0 never is
+  unsigned int ret = 0xffffffff;
+  for(int i = 0; i < 2; i++)
+    if(myDivNCnt[i] > 0 && myDivNCnt[i] < ret)
+      ret = myDivNCnt[i];
+  return ret;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void TIASound::skipSamples(unsigned int samples)
+{
+  for(int i = 0; i < 2; i++)
+    if(myDivNCnt[i] > 0)
+      myDivNCnt[i] -= samples;
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void TIASound::polyInit(unsigned char* poly, int size, int f0, int f1)
 {
@@ -89,6 +89,21 @@ class TIASound
     */
     void process(short* buffer, unsigned int samples);
 
+    /**
+      Get the number of samples process() would create until the output
+      may change, that sample included. The output never changes while
+      both channels are stopped, in which case 0xffffffff is returned.
+    */
+    unsigned int samplesToNextEvent() const;
+
+    /**
+      Advance the channel counters without creating samples. The amount
+      must be lower than samplesToNextEvent().
+
+      @param samples The number of samples to skip
+    */
+    void skipSamples(unsigned int samples);
+
     /**
       Set the volume of the samples created (0-100)
     */
@@ -718,7 +718,18 @@ void fm_operator<RegisterType>::clock_envelope(uint32_t env_counter)
 		// specially); nukeykt confirms this happens on OPM, OPN, OPL/OPLL
 		// at least so assuming it is true for everyone
 		if (rate < 62)
-			m_env_attenuation += (~m_env_attenuation * increment) >> 4;
+		{
+			// the OPLL envelope only has 7 bits of resolution, which makes
+			// the tail of the attack noticeably shorter
+			if (RegisterType::EG_HAS_DEPRESS)
+			{
+				int32_t level = m_env_attenuation >> 3;
+				level += (~level * int32_t(increment)) >> 4;
+				m_env_attenuation = level << 3;
+			}
+			else
+				m_env_attenuation += (~m_env_attenuation * increment) >> 4;
+		}
 	}
 
 	// all other cases are similar
@@ -0,0 +1,596 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2021, Aaron Giles
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "ymfm_opl.h"
+#include "ymfm_fm.ipp"
+
+namespace ymfm
+{
+
+//*********************************************************
+//  OPLL REGISTERS
+//*********************************************************
+
+//-------------------------------------------------
+//  opll_registers - constructor
+//-------------------------------------------------
+
+opll_registers::opll_registers() :
+	m_lfo_am_counter(0),
+	m_lfo_pm_counter(0),
+	m_noise_lfsr(1),
+	m_lfo_am(0),
+	m_instdata(nullptr)
+{
+	// create the waveforms
+	for (uint32_t index = 0; index < WAVEFORM_LENGTH; index++)
+		m_waveform[0][index] = abs_sin_attenuation(index) | (bitfield(index, 9) << 15);
+
+	// the second waveform is a rectified (half) sine
+	uint16_t zeroval = m_waveform[0][0];
+	for (uint32_t index = 0; index < WAVEFORM_LENGTH; index++)
+		m_waveform[1][index] = bitfield(index, 9) ? zeroval : m_waveform[0][index];
+
+	std::fill_n(&m_regdata[0], REGISTERS, 0);
+}
+
+
+//-------------------------------------------------
+//  set_instrument_data - set the instrument ROM
+//-------------------------------------------------
+
+void opll_registers::set_instrument_data(uint8_t const *data)
+{
+	m_instdata = data;
+	update_instruments();
+}
+
+
+//-------------------------------------------------
+//  reset - reset to initial state
+//-------------------------------------------------
+
+void opll_registers::reset()
+{
+	std::fill_n(&m_regdata[0], REGISTERS, 0);
+	update_instruments();
+}
+
+
+//-------------------------------------------------
+//  save_restore - save or restore the data
+//-------------------------------------------------
+
+void opll_registers::save_restore(ymfm_saved_state &state)
+{
+	state.save_restore(m_lfo_am_counter);
+	state.save_restore(m_lfo_pm_counter);
+	state.save_restore(m_lfo_am);
+	state.save_restore(m_noise_lfsr);
+	state.save_restore(m_regdata);
+
+	// instrument pointers are derived from the registers
+	update_instruments();
+}
+
+
+//-------------------------------------------------
+//  operator_map - return an array of operator
+//  indices for each channel; for OPLL this is fixed
+//-------------------------------------------------
+
+void opll_registers::operator_map(operator_mapping &dest) const
+{
+	// same layout as the OPL, so operators 13 and 17 are the high hat
+	// and top cymbal that feed the rhythm phase generator
+	static const operator_mapping s_fixed_map =
+	{ {
+		operator_list(  0,  3 ),  // Channel 0 operators
+		operator_list(  1,  4 ),  // Channel 1 operators
+		operator_list(  2,  5 ),  // Channel 2 operators
+		operator_list(  6,  9 ),  // Channel 3 operators
+		operator_list(  7, 10 ),  // Channel 4 operators
+		operator_list(  8, 11 ),  // Channel 5 operators
+		operator_list( 12, 15 ),  // Channel 6 operators
+		operator_list( 13, 16 ),  // Channel 7 operators
+		operator_list( 14, 17 ),  // Channel 8 operators
+	} };
+	dest = s_fixed_map;
+}
+
+
+//-------------------------------------------------
+//  write - handle writes to the register array
+//-------------------------------------------------
+
+bool opll_registers::write(uint16_t index, uint8_t data, uint32_t &channel, uint32_t &opmask)
+{
+	assert(index < REGISTERS);
+	m_regdata[index] = data;
+
+	// instrument and rhythm changes alter which data each operator reads
+	if (index == 0x0e || (index >= 0x30 && index <= 0x38))
+		update_instruments();
+
+	// handle writes to the rhythm key on register
+	if (index == 0x0e)
+	{
+		channel = RHYTHM_CHANNEL;
+		opmask = rhythm_enable() ? bitfield(data, 0, 5) : 0;
+		return true;
+	}
+
+	// handle writes to the key on registers
+	if (index >= 0x20 && index <= 0x28)
+	{
+		channel = index & 0x0f;
+		opmask = bitfield(data, 4) ? 3 : 0;
+		return true;
+	}
+	return false;
+}
+
+
+//-------------------------------------------------
+//  update_instruments - recompute the instrument
+//  data pointers for each channel and operator
+//-------------------------------------------------
+
+void opll_registers::update_instruments()
+{
+	if (m_instdata == nullptr)
+		return;
+
+	for (uint32_t chnum = 0; chnum < CHANNELS; chnum++)
+	{
+		// rhythm channels use the fixed drum instruments at the end of the ROM;
+		// instrument 0 is the user instrument in registers 00-07
+		uint32_t inst = ch_instrument(chnum);
+		if (rhythm_enable() && chnum >= 6)
+			m_chinst[chnum] = &m_instdata[8 * (15 + chnum - 6)];
+		else if (inst == 0)
+			m_chinst[chnum] = &m_regdata[0];
+		else
+			m_chinst[chnum] = &m_instdata[8 * (inst - 1)];
+	}
+
+	// carriers read their data one byte later than modulators
+	for (uint32_t opnum = 0; opnum < OPERATORS; opnum++)
+		m_opinst[opnum] = m_chinst[op_channel(opnum)] + op_slot(opnum);
+}
+
+
+//-------------------------------------------------
+//  clock_noise_and_lfo - clock the noise and LFO,
+//  handling clock division, depth, and waveform
+//  computations
+//-------------------------------------------------
+
+int32_t opll_registers::clock_noise_and_lfo()
+{
+	// the rhythm noise is a 23-bit LFSR clocked once per operator slot,
+	// so it advances 18 times per sample
+	for (int rep = 0; rep < 18; rep++)
+	{
+		uint32_t bit = bitfield(m_noise_lfsr, 0) ^ bitfield(m_noise_lfsr, 14);
+		bit |= (m_noise_lfsr == 0) ? 1 : 0;
+		m_noise_lfsr = (bit << 22) | (m_noise_lfsr >> 1);
+	}
+
+	// the AM LFO is a triangle counting 0..105 and back, stepping once every
+	// 64 samples; at a nominal 50kHz output this is 50000/(210*64) = 3.72Hz
+	uint32_t am_counter = m_lfo_am_counter++;
+	if (am_counter >= 210*64 - 1)
+		m_lfo_am_counter = 0;
+
+	// only the upper 4 bits of the counter are used, in 0.375dB steps, which
+	// gives a fixed depth of 4.875dB
+	uint32_t am = (am_counter < 105*64) ? am_counter : (210*64 - 1 - am_counter);
+	m_lfo_am = (am >> 9) << 2;
+
+	// the PM LFO has 8 steps, each lasting 1024 samples, for a nominal
+	// period of 6.1Hz; the step index is returned and applied when
+	// computing the phase step
+	return bitfield(m_lfo_pm_counter++, 10, 3);
+}
+
+
+//-------------------------------------------------
+//  cache_operator_data - fill the operator cache
+//  with prefetched data
+//-------------------------------------------------
+
+void opll_registers::cache_operator_data(uint32_t choffs, uint32_t opoffs, opdata_cache &cache)
+{
+	// set up the easy stuff
+	cache.waveform = &m_waveform[op_waveform(opoffs)][0];
+
+	// get frequency from the channel
+	uint32_t block_freq = cache.block_freq = ch_block_freq(choffs);
+
+	// compute the keycode: block_freq is:
+	//
+	//     BBBFFFFFFFFF
+	//     ^^^^
+	//
+	// the 4-bit keycode is the block plus the top bit of the F-number
+	uint32_t keycode = bitfield(block_freq, 8, 4);
+
+	// no detune on the OPLL
+	cache.detune = 0;
+
+	// multiple value, as an x.1 value (0 means 0.5)
+	static uint8_t const s_multiple[16] = { 1, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 20, 24, 24, 30, 30 };
+	cache.multiple = s_multiple[op_multiple(opoffs)];
+
+	// phase step, or PHASE_STEP_DYNAMIC if PM is active; this depends on
+	// block_freq and multiple, so compute it after we've done those
+	if (op_lfo_pm_enable(opoffs) == 0)
+		cache.phase_step = compute_phase_step(choffs, opoffs, cache, 0);
+	else
+		cache.phase_step = opdata_cache::PHASE_STEP_DYNAMIC;
+
+	// key scale level: the table is indexed by the top 4 bits of the
+	// F-number in 0.75dB steps and drops 6dB per block below 8; the
+	// register selects 1.5, 3 or 6dB/octave
+	static uint8_t const s_ksl[16] = { 0, 32, 40, 45, 48, 51, 53, 55, 56, 58, 59, 60, 61, 62, 63, 64 };
+	uint32_t ksl = 0;
+	if (op_ksl(opoffs) != 0)
+	{
+		int32_t raw = s_ksl[bitfield(block_freq, 5, 4)] - 8 * (8 - int32_t(bitfield(block_freq, 9, 3)));
+		if (raw > 0)
+			ksl = (raw << 3) >> (3 - op_ksl(opoffs));
+	}
+
+	// modulators use the 6-bit total level of the instrument in 0.75dB
+	// steps; carriers, and the high hat and tom in rhythm mode, use the
+	// 4-bit channel volume in 3dB steps
+	uint32_t slot = op_slot(opoffs);
+	bool rhythm_mod = (rhythm_enable() && choffs >= 7);
+	if (slot == 1)
+		cache.total_level = ch_volume(choffs) << 5;
+	else if (rhythm_mod)
+		cache.total_level = ch_instrument(choffs) << 5;
+	else
+		cache.total_level = ch_total_level(choffs) << 3;
+	cache.total_level += ksl;
+
+	// 4-bit sustain level in 3dB steps
+	cache.eg_sustain = op_sustain_level(opoffs) << 5;
+
+	// determine KSR adjustment for envelope rates
+	uint32_t ksrval = keycode >> ((op_ksr(opoffs) ^ 1) * 2);
+
+	// attack rate 15 is instantaneous regardless of KSR
+	uint32_t attack = op_attack_rate(opoffs);
+	cache.eg_rate[EG_ATTACK] = (attack == 15) ? 63 : effective_rate(attack * 4, ksrval);
+	cache.eg_rate[EG_DECAY] = effective_rate(op_decay_rate(opoffs) * 4, ksrval);
+
+	// sustained tones hold during sustain; percussive tones keep going
+	// at the release rate
+	uint32_t release = op_release_rate(opoffs);
+	cache.eg_rate[EG_SUSTAIN] = op_eg_sustain(opoffs) ? 0 : effective_rate(release * 4, ksrval);
+
+	// after key off, modulators (other than the high hat and tom) hold;
+	// carriers use rate 5 with the sustain bit, the instrument's release
+	// rate for sustained tones, and rate 7 for percussive tones
+	if (slot == 0 && !rhythm_mod)
+		release = 0;
+	else if (ch_sustain(choffs))
+		release = 5;
+	else if (!op_eg_sustain(opoffs))
+		release = 7;
+	cache.eg_rate[EG_RELEASE] = effective_rate(release * 4, ksrval);
+
+	// the damp phase ahead of each attack runs at rate 12
+	cache.eg_rate[EG_DEPRESS] = effective_rate(12 * 4, ksrval);
+}
+
+
+//-------------------------------------------------
+//  compute_phase_step - compute the phase step
+//-------------------------------------------------
+
+uint32_t opll_registers::compute_phase_step(uint32_t choffs, uint32_t opoffs, opdata_cache const &cache, int32_t lfo_raw_pm)
+{
+	// OPLL phase calculation has no detuning; the F-number is doubled
+	// so vibrato can nudge it by 1/256 or 1/128 depending on the LFO step
+	uint32_t fnum = bitfield(cache.block_freq, 0, 9) << 1;
+	if (op_lfo_pm_enable(opoffs))
+	{
+		switch (lfo_raw_pm)
+		{
+			case 1: case 3: fnum += fnum >> 8; break;
+			case 2:         fnum += fnum >> 7; break;
+			case 5: case 7: fnum -= fnum >> 8; break;
+			case 6:         fnum -= fnum >> 7; break;
+		}
+	}
+
+	// apply block shift to compute phase step
+	uint32_t block = bitfield(cache.block_freq, 9, 3);
+	uint32_t phase_step = (fnum << block) >> 1;
+
+	// apply frequency multiplier (which is cached as an x.1 value); the
+	// chip's phase accumulator is 19 bits against our 20, so the usual
+	// final shift is folded in here
+	return phase_step * cache.multiple;
+}
+
+
+//-------------------------------------------------
+//  log_keyon - log a key-on event
+//-------------------------------------------------
+
+std::string opll_registers::log_keyon(uint32_t choffs, uint32_t opoffs)
+{
+	uint32_t chnum = choffs;
+	uint32_t opnum = opoffs;
+
+	char buffer[256];
+	char *end = &buffer[0];
+
+	end += sprintf(end, "%u.%02u freq=%04X inst=%X fb=%u mul=%X tl=%02X ksr=%u ksl=%u adr=%X/%X/%X sl=%X sus=%u/%u wave=%u",
+		chnum, opnum,
+		ch_block_freq(choffs),
+		ch_instrument(choffs),
+		ch_feedback(choffs),
+		op_multiple(opoffs),
+		op_slot(opoffs) ? ch_volume(choffs) : ch_total_level(choffs),
+		op_ksr(opoffs),
+		op_ksl(opoffs),
+		op_attack_rate(opoffs),
+		op_decay_rate(opoffs),
+		op_release_rate(opoffs),
+		op_sustain_level(opoffs),
+		op_eg_sustain(opoffs),
+		ch_sustain(choffs),
+		op_waveform(opoffs));
+
+	if (op_lfo_am_enable(opoffs))
+		end += sprintf(end, " am=1");
+	if (op_lfo_pm_enable(opoffs))
+		end += sprintf(end, " pm=1");
+	if (rhythm_enable() && choffs >= 6)
+		end += sprintf(end, " rhythm=1");
+
+	return buffer;
+}
+
+
+
+//*********************************************************
+//  YM2413
+//*********************************************************
+
+//-------------------------------------------------
+//  ym2413 - constructor
+//-------------------------------------------------
+
+ym2413::ym2413(ymfm_interface &intf, uint8_t const *instrument_data) :
+	m_address(0),
+	m_fm(intf)
+{
+	m_fm.regs().set_instrument_data((instrument_data != nullptr) ? instrument_data : s_default_instruments);
+}
+
+
+//-------------------------------------------------
+//  reset - reset the system
+//-------------------------------------------------
+
+void ym2413::reset()
+{
+	// reset the engines
+	m_fm.reset();
+}
+
+
+//-------------------------------------------------
+//  save_restore - save or restore the data
+//-------------------------------------------------
+
+void ym2413::save_restore(ymfm_saved_state &state)
+{
+	m_fm.save_restore(state);
+	state.save_restore(m_address);
+}
+
+
+//-------------------------------------------------
+//  read - handle a read from the device
+//-------------------------------------------------
+
+uint8_t ym2413::read(uint32_t offset)
+{
+	// OPLL has no readable registers
+	debug::log_unexpected_read_write("Unexpected read from YM2413 offset %d\n", offset & 1);
+	return 0xff;
+}
+
+
+//-------------------------------------------------
+//  write_address - handle a write to the address
+//  register
+//-------------------------------------------------
+
+void ym2413::write_address(uint8_t data)
+{
+	// just set the address
+	m_address = data;
+}
+
+
+//-------------------------------------------------
+//  write - handle a write to the register
+//  interface
+//-------------------------------------------------
+
+void ym2413::write_data(uint8_t data)
+{
+	// write the FM register; anything past the register file is ignored,
+	// including our internal mode register
+	if (m_address < opll_registers::REG_MODE)
+		m_fm.write(m_address, data);
+}
+
+
+//-------------------------------------------------
+//  write - handle a write to the register
+//  interface
+//-------------------------------------------------
+
+void ym2413::write(uint32_t offset, uint8_t data)
+{
+	switch (offset & 1)
+	{
+		case 0: // address port
+			write_address(data);
+			break;
+
+		case 1: // data port
+			write_data(data);
+			break;
+	}
+}
+
+
+//-------------------------------------------------
+//  generate - generate one sample of sound
+//-------------------------------------------------
+
+void ym2413::generate(output_data *output, uint32_t numsamples, uint32_t chanmask)
+{
+	for (uint32_t samp = 0; samp < numsamples; samp++, output++)
+	{
+		// clock the system
+		m_fm.clock(fm_engine::ALL_CHANNELS);
+
+		// update the FM content; OPLL has a built-in 9-bit DAC
+		m_fm.output(output->clear(), 5, 256, chanmask);
+	}
+}
+
+
+//-------------------------------------------------
+//  instrument ROMs: 15 melodic instruments followed
+//  by bass drum, high hat/snare drum and tom/top
+//  cymbal, in the same layout as registers 00-07
+//-------------------------------------------------
+
+uint8_t const ym2413::s_default_instruments[] =
+{
+	0x71, 0x61, 0x1e, 0x17, 0xd0, 0x78, 0x00, 0x17,
+	0x13, 0x41, 0x1a, 0x0d, 0xd8, 0xf7, 0x23, 0x13,
+	0x13, 0x01, 0x99, 0x00, 0xf2, 0xc4, 0x11, 0x23,
+	0x31, 0x61, 0x0e, 0x07, 0xa8, 0x64, 0x70, 0x27,
+	0x32, 0x21, 0x1e, 0x06, 0xe0, 0x76, 0x00, 0x28,
+	0x31, 0x22, 0x16, 0x05, 0xe0, 0x71, 0x00, 0x18,
+	0x21, 0x61, 0x1d, 0x07, 0x82, 0x81, 0x10, 0x07,
+	0x23, 0x21, 0x2d, 0x14, 0xa2, 0x72, 0x00, 0x07,
+	0x61, 0x61, 0x1b, 0x06, 0x64, 0x65, 0x10, 0x17,
+	0x41, 0x61, 0x0b, 0x18, 0x85, 0xf7, 0x71, 0x07,
+	0x13, 0x01, 0x83, 0x11, 0xfa, 0xe4, 0x10, 0x04,
+	0x17, 0xc1, 0x24, 0x07, 0xf8, 0xf8, 0x22, 0x12,
+	0x61, 0x50, 0x0c, 0x05, 0xc2, 0xf5, 0x20, 0x42,
+	0x01, 0x01, 0x55, 0x03, 0xc9, 0x95, 0x03, 0x02,
+	0x61, 0x41, 0x89, 0x03, 0xf1, 0xe4, 0x40, 0x13,
+	0x01, 0x01, 0x18, 0x0f, 0xdf, 0xf8, 0x6a, 0x6d,
+	0x01, 0x01, 0x00, 0x00, 0xc8, 0xd8, 0xa7, 0x48,
+	0x05, 0x01, 0x00, 0x00, 0xf8, 0xaa, 0x59, 0x55
+};
+
+uint8_t const ym2423::s_default_instruments[] =
+{
+	0x61, 0x61, 0x1b, 0x07, 0x94, 0x54, 0x10, 0x05,
+	0xb3, 0xb1, 0x52, 0x04, 0xf3, 0xf2, 0xa0, 0xe9,
+	0x61, 0x21, 0x11, 0x85, 0xf2, 0xf2, 0x50, 0x75,
+	0xb3, 0xb2, 0x28, 0x07, 0xf3, 0xf2, 0x90, 0xb4,
+	0x72, 0x31, 0x97, 0x05, 0x51, 0x6f, 0x70, 0x09,
+	0x33, 0x30, 0x18, 0x06, 0xf7, 0xf4, 0x50, 0x85,
+	0x71, 0x31, 0x1c, 0x07, 0x51, 0x71, 0x20, 0x26,
+	0x71, 0xf4, 0x1b, 0x07, 0x73, 0x3f, 0x00, 0x06,
+	0x70, 0x30, 0x4d, 0x03, 0x42, 0x6f, 0x20, 0x06,
+	0x60, 0x20, 0x10, 0x85, 0xf3, 0xf3, 0x20, 0x04,
+	0x61, 0x61, 0x1b, 0x07, 0xc5, 0x96, 0xf0, 0xf6,
+	0xf9, 0xf1, 0xdb, 0x00, 0xf5, 0xf3, 0x70, 0xf2,
+	0x60, 0xa2, 0x91, 0x03, 0x94, 0xb1, 0xe0, 0xf7,
+	0x30, 0x30, 0x17, 0x06, 0xd3, 0xe1, 0xb0, 0xeb,
+	0x31, 0x36, 0x0d, 0x05, 0xf2, 0xf4, 0x20, 0x99,
+	0x01, 0x01, 0x18, 0x0f, 0xdf, 0xf8, 0x6a, 0x6d,
+	0x01, 0x01, 0x00, 0x00, 0xc8, 0xd8, 0xa7, 0x48,
+	0x05, 0x01, 0x00, 0x00, 0xf8, 0xaa, 0x59, 0x55
+};
+
+uint8_t const ymf281::s_default_instruments[] =
+{
+	0x62, 0x21, 0x1a, 0x07, 0xff, 0x67, 0x00, 0x16,
+	0x20, 0x10, 0x45, 0x01, 0xf6, 0x83, 0x80, 0x03,
+	0x13, 0x01, 0x96, 0x00, 0xf2, 0xd3, 0x11, 0x03,
+	0x31, 0x61, 0x0b, 0x0f, 0xa8, 0x64, 0x70, 0x17,
+	0x32, 0x21, 0x1e, 0x06, 0xe1, 0x76, 0x00, 0x28,
+	0x20, 0x61, 0x82, 0x0e, 0x9a, 0x61, 0x20, 0x27,
+	0x21, 0x61, 0x1b, 0x07, 0x84, 0x83, 0x10, 0x07,
+	0x37, 0x32, 0xca, 0x02, 0x66, 0x64, 0x40, 0x27,
+	0x41, 0x61, 0x07, 0x03, 0xc5, 0x77, 0x51, 0x07,
+	0x36, 0x01, 0x5e, 0x07, 0xf2, 0xf3, 0xf0, 0xf3,
+	0x20, 0x00, 0x18, 0x06, 0xf5, 0xe3, 0x20, 0x13,
+	0x17, 0x81, 0x24, 0x07, 0xf8, 0xf8, 0x22, 0x03,
+	0x35, 0x64, 0x00, 0x00, 0xff, 0xf3, 0x70, 0xf5,
+	0x0f, 0x31, 0x03, 0x07, 0xfc, 0xe3, 0x3f, 0xfc,
+	0x2a, 0x21, 0x00, 0x07, 0xbf, 0x84, 0x00, 0xf5,
+	0x01, 0x01, 0x18, 0x0f, 0xdf, 0xf8, 0x6a, 0x6d,
+	0x01, 0x01, 0x00, 0x00, 0xc8, 0xd8, 0xa7, 0x48,
+	0x05, 0x01, 0x00, 0x00, 0xf8, 0xaa, 0x59, 0x55
+};
+
+uint8_t const ds1001::s_default_instruments[] =
+{
+	0x03, 0x21, 0x05, 0x06, 0xe8, 0x81, 0x42, 0x27,
+	0x13, 0x41, 0x14, 0x0d, 0xd8, 0xf6, 0x23, 0x12,
+	0x11, 0x11, 0x08, 0x08, 0xfa, 0xb2, 0x20, 0x12,
+	0x31, 0x61, 0x0c, 0x07, 0xa8, 0x64, 0x61, 0x27,
+	0x32, 0x21, 0x1e, 0x06, 0xe1, 0x76, 0x01, 0x28,
+	0x02, 0x01, 0x06, 0x00, 0xa3, 0xe2, 0xf4, 0xf4,
+	0x21, 0x61, 0x1d, 0x07, 0x82, 0x81, 0x11, 0x07,
+	0x23, 0x21, 0x22, 0x17, 0xa2, 0x72, 0x01, 0x17,
+	0x35, 0x11, 0x25, 0x00, 0x40, 0x73, 0x72, 0x01,
+	0xb5, 0x01, 0x0f, 0x0f, 0xa8, 0xa5, 0x51, 0x02,
+	0x17, 0xc1, 0x24, 0x07, 0xf8, 0xf8, 0x22, 0x12,
+	0x71, 0x23, 0x11, 0x06, 0x65, 0x74, 0x18, 0x16,
+	0x01, 0x02, 0xd3, 0x05, 0xc9, 0x95, 0x03, 0x02,
+	0x61, 0x63, 0x0c, 0x00, 0x94, 0xc0, 0x33, 0xf6,
+	0x21, 0x72, 0x0d, 0x00, 0xc1, 0xd5, 0x56, 0x06,
+	0x01, 0x01, 0x18, 0x0f, 0xdf, 0xf8, 0x6a, 0x6d,
+	0x01, 0x01, 0x00, 0x00, 0xc8, 0xd8, 0xa7, 0x68,
+	0x05, 0x01, 0x00, 0x00, 0xf8, 0xaa, 0x59, 0x55
+};
+
+}
@@ -0,0 +1,343 @@
+// BSD 3-Clause License
+//
+// Copyright (c) 2021, Aaron Giles
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef YMFM_OPL_H
+#define YMFM_OPL_H
+
+#pragma once
+
+#include "ymfm.h"
+#include "ymfm_fm.h"
+
+namespace ymfm
+{
+
+//*********************************************************
+//  REGISTER CLASSES
+//*********************************************************
+
+// ======================> opll_registers
+
+//
+// OPLL register map:
+//
+//      System-wide registers:
+//           0E --x----- Rhythm enable
+//              ---x---- Bass drum key on
+//              ----x--- Snare drum key on
+//              -----x-- Tom key on
+//              ------x- Top cymbal key on
+//              -------x High hat key on
+//           0F xxxxxxxx Test register
+//
+//     Per-channel registers (channel in address bits 0-3)
+//        10-18 xxxxxxxx F-number (low 8 bits)
+//        20-28 --x----- Sustain on
+//              ---x---- Key on
+//              ----xxx- Block (0-7)
+//              -------x F-number (high bit)
+//        30-38 xxxx---- Instrument selection
+//              ----xxxx Volume
+//
+//     User instrument registers (for modulator, carrier operators)
+//        00-01 x------- AM enable
+//              -x------ PM enable (VIB)
+//              --x----- EG sustain
+//              ---x---- Key scale rate
+//              ----xxxx Multiple value (0-15)
+//           02 xx------ Key scale level (modulator)
+//              --xxxxxx Total level (modulator)
+//           03 xx------ Key scale level (carrier)
+//              ---x---- Rectified wave (carrier)
+//              ----x--- Rectified wave (modulator)
+//              -----xxx Feedback level for operator 1 (0-7)
+//        04-05 xxxx---- Attack rate (0-15)
+//              ----xxxx Decay rate (0-15)
+//        06-07 xxxx---- Sustain level (0-15)
+//              ----xxxx Release rate (0-15)
+//
+//     Internal (fake) registers:
+//           3F -------- Mode register (no timers on OPLL)
+//
+// The instrument data for the melodic voices and the rhythm section lives in
+// an internal ROM; channels using instrument 0 read the user instrument from
+// registers 00-07 instead. Operators are numbered the same way as on the OPL
+// (channel N uses operators N%3+6*(N/3) and N%3+6*(N/3)+3) so the rhythm
+// logic in the shared engine finds the high hat and top cymbal where it
+// expects them.
+//
+
+class opll_registers : public fm_registers_base
+{
+public:
+	// constants
+	static constexpr uint32_t OUTPUTS = 2;
+	static constexpr uint32_t CHANNELS = 9;
+	static constexpr uint32_t ALL_CHANNELS = (1 << CHANNELS) - 1;
+	static constexpr uint32_t OPERATORS = CHANNELS * 2;
+	static constexpr uint32_t WAVEFORMS = 2;
+	static constexpr uint32_t REGISTERS = 0x40;
+	static constexpr uint32_t DEFAULT_PRESCALE = 4;
+	static constexpr uint32_t EG_CLOCK_DIVIDER = 1;
+	static constexpr uint32_t CSM_TRIGGER_MASK = 0;
+	static constexpr uint32_t REG_MODE = 0x3f;
+	static constexpr uint8_t STATUS_TIMERA = 0;
+	static constexpr uint8_t STATUS_TIMERB = 0;
+	static constexpr uint8_t STATUS_BUSY = 0;
+	static constexpr uint8_t STATUS_IRQ = 0;
+	static constexpr bool EG_HAS_DEPRESS = true;
+	static constexpr bool MODULATOR_DELAY = true;
+
+	// constructor
+	opll_registers();
+
+	// set the instrument ROM data (15 melodic and 3 rhythm instruments)
+	void set_instrument_data(uint8_t const *data);
+
+	// reset to initial state
+	void reset();
+
+	// save/restore
+	void save_restore(ymfm_saved_state &state);
+
+	// map channel number to register offset
+	static constexpr uint32_t channel_offset(uint32_t chnum)
+	{
+		assert(chnum < CHANNELS);
+		return chnum;
+	}
+
+	// map operator number to register offset
+	static constexpr uint32_t operator_offset(uint32_t opnum)
+	{
+		assert(opnum < OPERATORS);
+		return opnum;
+	}
+
+	// return an array of operator indices for each channel
+	struct operator_mapping { uint32_t chan[CHANNELS]; };
+	void operator_map(operator_mapping &dest) const;
+
+	// handle writes to the register array
+	bool write(uint16_t index, uint8_t data, uint32_t &chan, uint32_t &opmask);
+
+	// clock the noise and LFO, if present, returning LFO PM value
+	int32_t clock_noise_and_lfo();
+
+	// return the AM offset from LFO for the given channel
+	uint32_t lfo_am_offset(uint32_t choffs) const { return m_lfo_am; }
+
+	// return the current noise state, gated by the noise clock
+	uint32_t noise_state() const { return m_noise_lfsr & 1; }
+
+	// caching helpers
+	void cache_operator_data(uint32_t choffs, uint32_t opoffs, opdata_cache &cache);
+
+	// compute the phase step, given a PM value
+	uint32_t compute_phase_step(uint32_t choffs, uint32_t opoffs, opdata_cache const &cache, int32_t lfo_raw_pm);
+
+	// log a key-on event
+	std::string log_keyon(uint32_t choffs, uint32_t opoffs);
+
+	// system-wide registers
+	uint32_t rhythm_enable() const                   { return byte(0x0e, 5, 1); }
+	uint32_t rhythm_keyon() const                    { return byte(0x0e, 0, 5); }
+	uint32_t test() const                            { return byte(0x0f, 0, 8); }
+
+	// no timers on the OPLL, but the engine still asks
+	uint32_t timer_a_value() const                   { return 0; }
+	uint32_t timer_b_value() const                   { return 0; }
+	uint32_t csm() const                             { return 0; }
+	uint32_t reset_timer_b() const                   { return 0; }
+	uint32_t reset_timer_a() const                   { return 0; }
+	uint32_t enable_timer_b() const                  { return 0; }
+	uint32_t enable_timer_a() const                  { return 0; }
+	uint32_t load_timer_b() const                    { return 0; }
+	uint32_t load_timer_a() const                    { return 0; }
+
+	// per-channel registers; melodic voices go to output 0, rhythm to output 1
+	uint32_t ch_output_any(uint32_t choffs) const    { return 1; }
+	uint32_t ch_output_0(uint32_t choffs) const      { return (choffs < 6 || !rhythm_enable()); }
+	uint32_t ch_output_1(uint32_t choffs) const      { return (choffs >= 6 && rhythm_enable()); }
+	uint32_t ch_output_2(uint32_t choffs) const      { return 0; }
+	uint32_t ch_output_3(uint32_t choffs) const      { return 0; }
+	uint32_t ch_feedback(uint32_t choffs) const      { return bitfield(m_chinst[choffs][3], 0, 3); }
+	uint32_t ch_algorithm(uint32_t choffs) const     { return 0; }
+	uint32_t ch_block_freq(uint32_t choffs) const    { return word(0x20, 0, 4, 0x10, 0, 8, choffs); }
+	uint32_t ch_sustain(uint32_t choffs) const       { return byte(0x20, 5, 1, choffs); }
+	uint32_t ch_total_level(uint32_t choffs) const   { return bitfield(m_chinst[choffs][2], 0, 6); }
+	uint32_t ch_instrument(uint32_t choffs) const    { return byte(0x30, 4, 4, choffs); }
+	uint32_t ch_volume(uint32_t choffs) const        { return byte(0x30, 0, 4, choffs); }
+
+	// per-operator registers, read from the selected instrument
+	uint32_t op_lfo_am_enable(uint32_t opoffs) const { return bitfield(*m_opinst[opoffs], 7, 1); }
+	uint32_t op_lfo_pm_enable(uint32_t opoffs) const { return bitfield(*m_opinst[opoffs], 6, 1); }
+	uint32_t op_eg_sustain(uint32_t opoffs) const    { return bitfield(*m_opinst[opoffs], 5, 1); }
+	uint32_t op_ksr(uint32_t opoffs) const           { return bitfield(*m_opinst[opoffs], 4, 1); }
+	uint32_t op_multiple(uint32_t opoffs) const      { return bitfield(*m_opinst[opoffs], 0, 4); }
+	uint32_t op_ksl(uint32_t opoffs) const           { return bitfield(m_opinst[opoffs][2], 6, 2); }
+	uint32_t op_waveform(uint32_t opoffs) const      { return bitfield(m_opinst[opoffs][3 - op_slot(opoffs)], 3 + op_slot(opoffs), 1); }
+	uint32_t op_attack_rate(uint32_t opoffs) const   { return bitfield(m_opinst[opoffs][4], 4, 4); }
+	uint32_t op_decay_rate(uint32_t opoffs) const    { return bitfield(m_opinst[opoffs][4], 0, 4); }
+	uint32_t op_sustain_level(uint32_t opoffs) const { return bitfield(m_opinst[opoffs][6], 4, 4); }
+	uint32_t op_release_rate(uint32_t opoffs) const  { return bitfield(m_opinst[opoffs][6], 0, 4); }
+
+	// operator topology helpers: slot 0 is the modulator, slot 1 the carrier
+	static constexpr uint32_t op_slot(uint32_t opoffs) { return (opoffs % 6) / 3; }
+	static constexpr uint32_t op_channel(uint32_t opoffs) { return opoffs % 3 + 3 * (opoffs / 6); }
+
+protected:
+	// return a bitfield extracted from a byte
+	uint32_t byte(uint32_t offset, uint32_t start, uint32_t count, uint32_t extra_offset = 0) const
+	{
+		return bitfield(m_regdata[offset + extra_offset], start, count);
+	}
+
+	// return a bitfield extracted from a pair of bytes, MSBs listed first
+	uint32_t word(uint32_t offset1, uint32_t start1, uint32_t count1, uint32_t offset2, uint32_t start2, uint32_t count2, uint32_t extra_offset = 0) const
+	{
+		return (byte(offset1, start1, count1, extra_offset) << count2) | byte(offset2, start2, count2, extra_offset);
+	}
+
+	// recompute the instrument pointers after an instrument or rhythm change
+	void update_instruments();
+
+	// internal state
+	uint32_t m_lfo_am_counter;            // LFO AM counter
+	uint32_t m_lfo_pm_counter;            // LFO PM counter
+	uint32_t m_noise_lfsr;                // noise LFSR state
+	uint8_t m_lfo_am;                     // current LFO AM value
+	uint8_t const *m_instdata;            // instrument ROM data
+	uint8_t const *m_chinst[CHANNELS];    // instrument data for each channel
+	uint8_t const *m_opinst[OPERATORS];   // instrument data for each operator
+	uint8_t m_regdata[REGISTERS];         // register data
+	uint16_t m_waveform[WAVEFORMS][WAVEFORM_LENGTH]; // waveforms
+};
+
+
+
+//*********************************************************
+//  OPLL IMPLEMENTATION CLASSES
+//*********************************************************
+
+// ======================> ym2413
+
+class ym2413
+{
+public:
+	using fm_engine = fm_engine_base<opll_registers>;
+	using output_data = fm_engine::output_data;
+	static constexpr uint32_t OUTPUTS = fm_engine::OUTPUTS;
+
+	// constructor
+	ym2413(ymfm_interface &intf, uint8_t const *instrument_data = nullptr);
+
+	// reset
+	void reset();
+
+	// save/restore
+	void save_restore(ymfm_saved_state &state);
+
+	// pass-through helpers
+	uint32_t sample_rate(uint32_t input_clock) const { return m_fm.sample_rate(input_clock); }
+	void invalidate_caches() { m_fm.invalidate_caches(); }
+
+	// read access
+	uint8_t read(uint32_t offset);
+
+	// write access
+	void write_address(uint8_t data);
+	void write_data(uint8_t data);
+	void write(uint32_t offset, uint8_t data);
+
+	// generate one sample of sound; output 0 carries the melodic voices
+	// and output 1 the rhythm section, like the chip's MO/RO pins
+	void generate(output_data *output, uint32_t numsamples = 1, uint32_t chanmask = fm_engine::ALL_CHANNELS);
+
+protected:
+	// internal state
+	uint8_t m_address;               // address register
+	fm_engine m_fm;                  // core FM engine
+
+private:
+	// internal instrument ROM
+	static uint8_t const s_default_instruments[];
+};
+
+
+// ======================> ym2423
+
+// the YM2423 is the same as the YM2413 with a different instrument ROM
+class ym2423 : public ym2413
+{
+public:
+	// constructor
+	ym2423(ymfm_interface &intf) : ym2413(intf, s_default_instruments) { }
+
+private:
+	// internal instrument ROM
+	static uint8_t const s_default_instruments[];
+};
+
+
+// ======================> ymf281
+
+// the YMF281 is the same as the YM2413 with a different instrument ROM
+class ymf281 : public ym2413
+{
+public:
+	// constructor
+	ymf281(ymfm_interface &intf) : ym2413(intf, s_default_instruments) { }
+
+private:
+	// internal instrument ROM
+	static uint8_t const s_default_instruments[];
+};
+
+
+// ======================> ds1001
+
+// the DS1001 (Konami VRC7) is the same as the YM2413 with a different
+// instrument ROM; the real chip only exposes 6 channels and no rhythm
+class ds1001 : public ym2413
+{
+public:
+	// constructor
+	ds1001(ymfm_interface &intf) : ym2413(intf, s_default_instruments) { }
+
+private:
+	// internal instrument ROM
+	static uint8_t const s_default_instruments[];
+};
+
+}
+
+
+#endif // YMFM_OPL_H
@@ -51,6 +51,28 @@ void DivPlatformTIA::acquire(short* bufL, short* bufR, size_t start, size_t len)
   tia.process(bufL+start,len);
 }
 
+bool DivPlatformTIA::isDirect() {
+  return true;
+}
+
+void DivPlatformTIA::acquireDirect(DivDeltaBuf& out, size_t start, size_t len) {
+  size_t h=start;
+  size_t end=start+len;
+  short s;
+  while (h<end) {
+    tia.process(&s,1);
+    out.put(0,h,s);
+    h++;
+    // nothing changes until a divider expires, so skip to the sample before that
+    size_t skip=tia.samplesToNextEvent()-1;
+    if (skip>end-h) skip=end-h;
+    if (skip>0) {
+      tia.skipSamples(skip);
+      h+=skip;
+    }
+  }
+}
+
 unsigned char DivPlatformTIA::dealWithFreq(unsigned char shape, int base, int pitch) {
   if (base&0x80000000 && ((base&0x7fffffff)<32)) {
     return base&0x1f;
@@ -281,6 +303,22 @@ void* DivPlatformTIA::getChanState(int ch) {
   return &chan[ch];
 }
 
+void* DivPlatformTIA::getState() {
+  State* s=new State;
+  for (int i=0; i<2; i++) s->chan[i]=chan[i];
+  return s;
+}
+
+void DivPlatformTIA::setState(void* state) {
+  if (state==NULL) return;
+  State* s=(State*)state;
+  for (int i=0; i<2; i++) chan[i]=s->chan[i];
+}
+
+void DivPlatformTIA::freeState(void* state) {
+  delete (State*)state;
+}
+
 unsigned char* DivPlatformTIA::getRegisterPool() {
   return regPool;
 }
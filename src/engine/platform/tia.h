@@ -39,14 +39,22 @@ class DivPlatformTIA: public DivDispatch {
     bool isMuted[2];
     TIASound tia;
     unsigned char regPool[16];
+    struct State {
+      Channel chan[2];
+    };
     friend void putDispatchChan(void*,int,int);
 
     unsigned char dealWithFreq(unsigned char shape, int base, int pitch);
   
   public:
     void acquire(short* bufL, short* bufR, size_t start, size_t len);
+    bool isDirect();
+    void acquireDirect(DivDeltaBuf& out, size_t start, size_t len);
     int dispatch(DivCommand c);
     void* getChanState(int chan);
+    void* getState();
+    void setState(void* state);
+    void freeState(void* state);
     unsigned char* getRegisterPool();
     int getRegisterPoolSize();
     void reset();
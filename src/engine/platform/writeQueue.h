@@ -0,0 +1,96 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2022 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _WRITEQUEUE_H
+#define _WRITEQUEUE_H
+#include <stddef.h>
+
+#define DIV_WRITE_QUEUE_SIZE 2048
+
+/**
+ * a queue of register writes, used by platforms which apply writes over time
+ * in acquire().
+ * unlike std::queue, it is a preallocated ring buffer, so checking for and
+ * taking writes is cheap and doesn't allocate. it only grows if a tick
+ * queues more than DIV_WRITE_QUEUE_SIZE writes.
+ * T must be default-constructible.
+ */
+template<typename T> class DivWriteQueue {
+  T* data;
+  size_t cap, readPos, writePos;
+
+  void grow() {
+    T* newData=new T[cap<<1];
+    for (size_t i=0; i<cap; i++) {
+      newData[i]=data[(readPos+i)&(cap-1)];
+    }
+    delete[] data;
+    data=newData;
+    readPos=0;
+    writePos=cap;
+    cap<<=1;
+  }
+
+  public:
+    bool empty() const {
+      return readPos==writePos;
+    }
+
+    size_t size() const {
+      return writePos-readPos;
+    }
+
+    T& front() {
+      return data[readPos&(cap-1)];
+    }
+
+    void pop() {
+      readPos++;
+    }
+
+    void push(const T& item) {
+      if (writePos-readPos>=cap) grow();
+      data[writePos&(cap-1)]=item;
+      writePos++;
+    }
+
+    template<typename... Args> void emplace(Args... args) {
+      push(T(args...));
+    }
+
+    void clear() {
+      readPos=0;
+      writePos=0;
+    }
+
+    DivWriteQueue():
+      data(new T[DIV_WRITE_QUEUE_SIZE]),
+      cap(DIV_WRITE_QUEUE_SIZE),
+      readPos(0),
+      writePos(0) {}
+
+    DivWriteQueue(const DivWriteQueue&)=delete;
+    DivWriteQueue& operator=(const DivWriteQueue&)=delete;
+
+    ~DivWriteQueue() {
+      delete[] data;
+    }
+};
+
+#endif
@@ -321,10 +321,14 @@ double DivPlatformYM2610::NOTE_ADPCMB(int note) {
 }
 
 void DivPlatformYM2610::acquire(short* bufL, short* bufR, size_t start, size_t len) {
-  static int os[2];
+  int os[2];
+  size_t h=start;
+  size_t end=start+len;
 
-  for (size_t h=start; h<start+len; h++) {
-    os[0]=0; os[1]=0;
+  while (h<end) {
+    // apply the next write if it's due, then run the core until the one
+    // after it.
+    size_t blockEnd=end;
     if (!writes.empty()) {
       if (--delay<1) {
         QueuedWrite& w=writes.front();
@@ -334,20 +338,26 @@ void DivPlatformYM2610::acquire(short* bufL, short* bufR, size_t start, size_t l
         writes.pop();
         delay=4;
       }
+      if (!writes.empty()) {
+        if (h+delay<end) blockEnd=h+delay;
+        delay-=(int)(blockEnd-h)-1;
+      }
     }
-    
-    fm->generate(&fmout);
 
-    os[0]=fmout.data[0]+(fmout.data[2]>>1);
-    if (os[0]<-32768) os[0]=-32768;
-    if (os[0]>32767) os[0]=32767;
+    for (; h<blockEnd; h++) {
+      fm->generate(&fmout);
 
-    os[1]=fmout.data[1]+(fmout.data[2]>>1);
-    if (os[1]<-32768) os[1]=-32768;
-    if (os[1]>32767) os[1]=32767;
-  
-    bufL[h]=os[0];
-    bufR[h]=os[1];
+      os[0]=fmout.data[0]+(fmout.data[2]>>1);
+      if (os[0]<-32768) os[0]=-32768;
+      if (os[0]>32767) os[0]=32767;
+
+      os[1]=fmout.data[1]+(fmout.data[2]>>1);
+      if (os[1]<-32768) os[1]=-32768;
+      if (os[1]>32767) os[1]=32767;
+
+      bufL[h]=os[0];
+      bufR[h]=os[1];
+    }
   }
 }
 
@@ -1172,6 +1182,56 @@ void* DivPlatformYM2610::getChanState(int ch) {
   return &chan[ch];
 }
 
+void DivPlatformYM2610::saveState(State* s) {
+  for (int i=0; i<14; i++) s->chan[i]=chan[i];
+  s->dacMode=dacMode;
+  s->dacPeriod=dacPeriod;
+  s->dacRate=dacRate;
+  s->dacPos=dacPos;
+  s->dacSample=dacSample;
+  s->ayNoiseFreq=ayNoiseFreq;
+  s->sampleBank=sampleBank;
+  s->ayEnvMode=ayEnvMode;
+  s->ayEnvPeriod=ayEnvPeriod;
+  s->ayEnvSlideLow=ayEnvSlideLow;
+  s->ayEnvSlide=ayEnvSlide;
+  memcpy(s->oldWrites,oldWrites,512*sizeof(short));
+  memcpy(s->pendingWrites,pendingWrites,512*sizeof(short));
+}
+
+void DivPlatformYM2610::loadState(State* s) {
+  for (int i=0; i<14; i++) chan[i]=s->chan[i];
+  dacMode=s->dacMode;
+  dacPeriod=s->dacPeriod;
+  dacRate=s->dacRate;
+  dacPos=s->dacPos;
+  dacSample=s->dacSample;
+  ayNoiseFreq=s->ayNoiseFreq;
+  sampleBank=s->sampleBank;
+  ayEnvMode=s->ayEnvMode;
+  ayEnvPeriod=s->ayEnvPeriod;
+  ayEnvSlideLow=s->ayEnvSlideLow;
+  ayEnvSlide=s->ayEnvSlide;
+  memcpy(oldWrites,s->oldWrites,512*sizeof(short));
+  memcpy(pendingWrites,s->pendingWrites,512*sizeof(short));
+  iface.sampleBank=sampleBank;
+}
+
+void* DivPlatformYM2610::getState() {
+  State* s=new State;
+  saveState(s);
+  return s;
+}
+
+void DivPlatformYM2610::setState(void* state) {
+  if (state==NULL) return;
+  loadState((State*)state);
+}
+
+void DivPlatformYM2610::freeState(void* state) {
+  delete (State*)state;
+}
+
 unsigned char* DivPlatformYM2610::getRegisterPool() {
   return regPool;
 }
@@ -1189,7 +1249,7 @@ void DivPlatformYM2610::poke(std::vector<DivRegWrite>& wlist) {
 }
 
 void DivPlatformYM2610::reset() {
-  while (!writes.empty()) writes.pop();
+  writes.clear();
   memset(regPool,0,512);
   if (dumpWrites) {
     addWrite(0xffffffff,0);
@@ -21,7 +21,7 @@
 #define _YM2610_H
 #include "../dispatch.h"
 #include "../macroInt.h"
-#include <queue>
+#include "writeQueue.h"
 #include "sound/ymfm/ymfm_opn.h"
 
 class DivYM2610Interface: public ymfm::ymfm_interface {
@@ -78,9 +78,10 @@ class DivPlatformYM2610: public DivDispatch {
       unsigned short addr;
       unsigned char val;
       bool addrOrVal;
+      QueuedWrite(): addr(0), val(0), addrOrVal(false) {}
       QueuedWrite(unsigned short a, unsigned char v): addr(a), val(v), addrOrVal(false) {}
     };
-    std::queue<QueuedWrite> writes;
+    DivWriteQueue<QueuedWrite> writes;
     ymfm::ym2610* fm;
     ymfm::ym2610::output_data fmout;
     DivYM2610Interface iface;
@@ -109,12 +110,33 @@ class DivPlatformYM2610: public DivDispatch {
     int octave(int freq);
     int toFreq(int freq);
     double NOTE_ADPCMB(int note);
+    struct State {
+      Channel chan[14];
+      bool dacMode;
+      int dacPeriod;
+      int dacRate;
+      int dacPos;
+      int dacSample;
+      int ayNoiseFreq;
+      unsigned char sampleBank;
+      unsigned char ayEnvMode;
+      unsigned short ayEnvPeriod;
+      short ayEnvSlideLow;
+      short ayEnvSlide;
+      short oldWrites[512];
+      short pendingWrites[512];
+    };
+    void saveState(State* s);
+    void loadState(State* s);
     friend void putDispatchChan(void*,int,int);
   
   public:
     void acquire(short* bufL, short* bufR, size_t start, size_t len);
     int dispatch(DivCommand c);
     void* getChanState(int chan);
+    void* getState();
+    void setState(void* state);
+    void freeState(void* state);
     unsigned char* getRegisterPool();
     int getRegisterPoolSize();
     void reset();
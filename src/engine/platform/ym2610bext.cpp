@@ -293,6 +293,24 @@ void* DivPlatformYM2610BExt::getChanState(int ch) {
   return &chan[ch];
 }
 
+void* DivPlatformYM2610BExt::getState() {
+  ExtState* s=new ExtState;
+  saveState(s);
+  for (int i=0; i<4; i++) s->opChan[i]=opChan[i];
+  return s;
+}
+
+void DivPlatformYM2610BExt::setState(void* state) {
+  if (state==NULL) return;
+  ExtState* s=(ExtState*)state;
+  loadState(s);
+  for (int i=0; i<4; i++) opChan[i]=s->opChan[i];
+}
+
+void DivPlatformYM2610BExt::freeState(void* state) {
+  delete (ExtState*)state;
+}
+
 void DivPlatformYM2610BExt::reset() {
   DivPlatformYM2610B::reset();
 
@@ -293,6 +293,24 @@ void* DivPlatformYM2610Ext::getChanState(int ch) {
   return &chan[ch];
 }
 
+void* DivPlatformYM2610Ext::getState() {
+  ExtState* s=new ExtState;
+  saveState(s);
+  for (int i=0; i<4; i++) s->opChan[i]=opChan[i];
+  return s;
+}
+
+void DivPlatformYM2610Ext::setState(void* state) {
+  if (state==NULL) return;
+  ExtState* s=(ExtState*)state;
+  loadState(s);
+  for (int i=0; i<4; i++) opChan[i]=s->opChan[i];
+}
+
+void DivPlatformYM2610Ext::freeState(void* state) {
+  delete (ExtState*)state;
+}
+
 void DivPlatformYM2610Ext::reset() {
   DivPlatformYM2610::reset();
 
@@ -23,6 +23,7 @@
 #define _USE_MATH_DEFINES
 #include "dispatch.h"
 #include "engine.h"
+#include "mix.h"
 #include "../ta-log.h"
 #include <math.h>
 #include <sndfile.h>
@@ -543,12 +544,34 @@ void DivEngine::processRow(int i, bool afterDelay) {
   int whatOrder=afterDelay?chan[i].delayOrder:curOrder;
   int whatRow=afterDelay?chan[i].delayRow:curRow;
   DivPattern* pat=song.pat[i].getPattern(song.orders.ord[i][whatOrder],false);
+  int evCount=0;
+  const DivPatternEvent* ev=pat->getEvents(whatRow,evCount);
+  const DivPatternEvent* evEnd=ev+evCount;
+  // split the row into its fixed columns and the visible effects
+  short note=0, octave=0, ins=-1, vol=-1;
+  const DivPatternEvent* fx=ev;
+  for (; fx<evEnd && fx->col<4; fx++) {
+    switch (fx->col) {
+      case 0:
+        note=fx->a;
+        octave=fx->b;
+        break;
+      case 2:
+        ins=fx->a;
+        break;
+      case 3:
+        vol=fx->a;
+        break;
+    }
+  }
+  const DivPatternEvent* fxEnd=fx;
+  while (fxEnd<evEnd && fxEnd->col<4+(song.pat[i].effectRows<<1)) fxEnd++;
+
   // pre effects
-  if (!afterDelay) for (int j=0; j<song.pat[i].effectRows; j++) {
-    short effect=pat->data[whatRow][4+(j<<1)];
-    short effectVal=pat->data[whatRow][5+(j<<1)];
+  if (!afterDelay) for (const DivPatternEvent* j=fx; j<fxEnd; j++) {
+    short effect=j->a;
+    short effectVal=j->b;
 
-    if (effectVal==-1) effectVal=0;
     if (effect==0xed && effectVal!=0) {
       if (effectVal<=nextSpeed) {
         chan[i].rowDelay=effectVal+1;
@@ -569,11 +592,11 @@ void DivEngine::processRow(int i, bool afterDelay) {
   if (chan[i].delayLocked) return;
 
   // instrument
-  if (pat->data[whatRow][2]!=-1) {
-    dispatchCmd(DivCommand(DIV_CMD_INSTRUMENT,i,pat->data[whatRow][2]));
+  if (ins!=-1) {
+    dispatchCmd(DivCommand(DIV_CMD_INSTRUMENT,i,ins));
   }
   // note
-  if (pat->data[whatRow][0]==100) { // note off
+  if (note==100) { // note off
     //chan[i].note=-1;
     chan[i].keyOn=false;
     chan[i].keyOff=true;
@@ -594,7 +617,7 @@ void DivEngine::processRow(int i, bool afterDelay) {
       chan[i].scheduledSlideReset=true;
     }
     dispatchCmd(DivCommand(DIV_CMD_NOTE_OFF,i));
-  } else if (pat->data[whatRow][0]==101) { // note off + env release
+  } else if (note==101) { // note off + env release
     //chan[i].note=-1;
     chan[i].keyOn=false;
     chan[i].keyOff=true;
@@ -615,11 +638,11 @@ void DivEngine::processRow(int i, bool afterDelay) {
       chan[i].scheduledSlideReset=true;
     }
     dispatchCmd(DivCommand(DIV_CMD_NOTE_OFF_ENV,i));
-  } else if (pat->data[whatRow][0]==102) { // env release
+  } else if (note==102) { // env release
     dispatchCmd(DivCommand(DIV_CMD_ENV_RELEASE,i));
-  } else if (!(pat->data[whatRow][0]==0 && pat->data[whatRow][1]==0)) {
+  } else if (!(note==0 && octave==0)) {
     chan[i].oldNote=chan[i].note;
-    chan[i].note=pat->data[whatRow][0]+((signed char)pat->data[whatRow][1])*12;
+    chan[i].note=note+((signed char)octave)*12;
     if (!chan[i].keyOn) {
       if (disCont[dispatchOfChan[i]].dispatch->keyOffAffectsArp(dispatchChanOfChan[i])) {
         chan[i].arp=0;
@@ -632,9 +655,9 @@ void DivEngine::processRow(int i, bool afterDelay) {
   }
 
   // volume
-  if (pat->data[whatRow][3]!=-1) {
-    if (dispatchCmd(DivCommand(DIV_ALWAYS_SET_VOLUME,i)) || (MIN(chan[i].volMax,chan[i].volume)>>8)!=pat->data[whatRow][3]) {
-      chan[i].volume=pat->data[whatRow][3]<<8;
+  if (vol!=-1) {
+    if (dispatchCmd(DivCommand(DIV_ALWAYS_SET_VOLUME,i)) || (MIN(chan[i].volMax,chan[i].volume)>>8)!=vol) {
+      chan[i].volume=vol<<8;
       dispatchCmd(DivCommand(DIV_CMD_VOLUME,i,chan[i].volume>>8));
     }
   }
@@ -644,11 +667,9 @@ void DivEngine::processRow(int i, bool afterDelay) {
   short lastSlide=-1;
 
   // effects
-  for (int j=0; j<song.pat[i].effectRows; j++) {
-    short effect=pat->data[whatRow][4+(j<<1)];
-    short effectVal=pat->data[whatRow][5+(j<<1)];
-
-    if (effectVal==-1) effectVal=0;
+  for (const DivPatternEvent* j=fx; j<fxEnd; j++) {
+    short effect=j->a;
+    short effectVal=j->b;
 
     // per-system effect
     if (!perSystemEffect(i,effect,effectVal)) switch (effect) {
@@ -887,16 +908,13 @@ void DivEngine::processRow(int i, bool afterDelay) {
   chan[i].noteOnInhibit=false;
 
   // post effects
-  for (int j=0; j<song.pat[i].effectRows; j++) {
-    short effect=pat->data[whatRow][4+(j<<1)];
-    short effectVal=pat->data[whatRow][5+(j<<1)];
-
-    if (effectVal==-1) effectVal=0;
-    perSystemPostEffect(i,effect,effectVal);
+  for (const DivPatternEvent* j=fx; j<fxEnd; j++) {
+    perSystemPostEffect(i,j->a,j->b);
   }
 }
 
 void DivEngine::nextRow() {
+  DivTraceSpan span("engine","row","row",curRow);
   static char pb[4096];
   static char pb1[4096];
   static char pb2[4096];
@@ -908,7 +926,7 @@ void DivEngine::nextRow() {
       snprintf(pb,4095," %.2x",song.orders.ord[i][curOrder]);
       strcat(pb1,pb);
       
-      DivPattern* pat=song.pat[i].getPattern(song.orders.ord[i][curOrder],false);
+      DivPattern* pat=song.pat[i].getPatternForRow(song.orders.ord[i][curOrder],curRow);
       snprintf(pb2,4095,"\x1b[37m %s",
               formatNote(pat->data[curRow][0],pat->data[curRow][1]));
       strcat(pb3,pb2);
@@ -980,8 +998,10 @@ void DivEngine::nextRow() {
   // post row details
   for (int i=0; i<chans; i++) {
     DivPattern* pat=song.pat[i].getPattern(song.orders.ord[i][curOrder],false);
-    if (!(pat->data[curRow][0]==0 && pat->data[curRow][1]==0)) {
-      if (pat->data[curRow][0]!=100) {
+    int evCount=0;
+    const DivPatternEvent* ev=pat->getEvents(curRow,evCount);
+    if (evCount>0 && ev->col==0) {
+      if (ev->a!=100) {
         if (!chan[i].legato) dispatchCmd(DivCommand(DIV_CMD_PRE_NOTE,i,ticks));
       }
     }
@@ -991,6 +1011,7 @@ void DivEngine::nextRow() {
 }
 
 bool DivEngine::nextTick(bool noAccum) {
+  DivTraceSpan span("engine","tick");
   bool ret=false;
   if (divider<10) divider=10;
   
@@ -1133,7 +1154,12 @@ bool DivEngine::nextTick(bool noAccum) {
   }
 
   // system tick
-  for (int i=0; i<song.systemLen; i++) disCont[i].dispatch->tick();
+  for (int i=0; i<song.systemLen; i++) {
+    DivTraceSpan sysSpan("tick",disCont[i].sysName,"sys",i);
+    disCont[i].perfTick.begin();
+    disCont[i].dispatch->tick();
+    disCont[i].perfTick.end();
+  }
 
   if (!freelance) {
     if (stepPlay!=1) {
@@ -1149,7 +1175,11 @@ bool DivEngine::nextTick(bool noAccum) {
       }
     }
 
-    if (consoleMode) fprintf(stderr,"\x1b[2K> %d:%.2d:%.2d.%.2d  %.2x/%.2x:%.3d/%.3d  %4dcmd/s\x1b[G",totalSeconds/3600,(totalSeconds/60)%60,totalSeconds%60,totalTicks/10000,curOrder,song.ordersLen,curRow,song.patLen,cmdsPerSecond);
+    if (consoleMode) {
+      float loadAvg, loadPeak;
+      getPerfLoad(loadAvg,loadPeak);
+      fprintf(stderr,"\x1b[2K> %d:%.2d:%.2d.%.2d  %.2x/%.2x:%.3d/%.3d  %4dcmd/s  %3d%% load (%3d%% peak)\x1b[G",totalSeconds/3600,(totalSeconds/60)%60,totalSeconds%60,totalTicks/10000,curOrder,song.ordersLen,curRow,song.patLen,cmdsPerSecond,(int)(loadAvg*100.0f),(int)(loadPeak*100.0f));
+    }
   }
 
   if (haltOn==DIV_HALT_TICK) halted=true;
@@ -1163,7 +1193,22 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
     memset(out[1],0,size*sizeof(float));
   }
 
-  isBusy.lock();
+  // the audio callback never waits for the lock. if someone else holds it
+  // (loading a song, changing systems...) this buffer is left silent.
+  // the export and render-ahead threads may wait, though. per-channel
+  // export runs in clones, so the audio callback keeps going meanwhile.
+  if ((exporting && exportMode!=DIV_EXPORT_MODE_MANY_CHAN) || renderThread!=NULL) {
+    isBusy.lock();
+  } else if (!isBusy.try_lock()) {
+    return;
+  }
+  // time spent ticking outside of nextBuf (seeking) doesn't count
+  for (int i=0; i<song.systemLen; i++) {
+    disCont[i].perfTick.discard();
+  }
+  DivTraceSpan span("engine","buffer","size",size);
+  perfBuf.begin();
+  runCmds();
   got.bufsize=size;
   
   if (out!=NULL && ((sPreview.sample>=0 && sPreview.sample<(int)song.sample.size()) || (sPreview.wave>=0 && sPreview.wave<(int)song.wave.size()))) {
@@ -1232,6 +1277,8 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
       memcpy(oscBuf[1],out[1],size*sizeof(float));
       oscSize=size;
     }
+    perfBuf.end();
+    commitPerf();
     isBusy.unlock();
     return;
   }
@@ -1241,12 +1288,76 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
   size_t runLeft[32];
   size_t runPos[32];
   size_t lastAvail[32];
+  float gainL[32];
+  float gainR[32];
+  int blipGroup[32];
+  for (int i=0; i<song.systemLen; i++) {
+    gainL[i]=((float)song.systemVol[i]/64.0f)*((float)MIN(127,127-(int)song.systemPan[i])/127.0f);
+    gainR[i]=((float)song.systemVol[i]/64.0f)*((float)MIN(127,127+(int)song.systemPan[i])/127.0f);
+  }
+
+  // systems with the same rate and channel count share the blip buffers of the
+  // first one (the group leader). their outputs are summed with their volumes
+  // before resampling. direct dispatches already feed only level changes to
+  // blip, so they are left alone.
+  bool share=shareBlip;
+  for (int i=0; i<song.systemLen; i++) {
+    blipGroup[i]=i;
+    disCont[i].groupLen=0;
+    if (!share || disCont[i].dispatch->isDirect()) continue;
+    for (int j=0; j<i; j++) {
+      if (blipGroup[j]!=j || disCont[j].dispatch->isDirect()) continue;
+      if (disCont[j].dispatch->rate!=disCont[i].dispatch->rate) continue;
+      if (disCont[j].dispatch->isStereo()!=disCont[i].dispatch->isStereo()) continue;
+      blipGroup[i]=j;
+      break;
+    }
+  }
+  for (int i=0; i<song.systemLen; i++) {
+    if (blipGroup[i]==i) continue;
+    DivDispatchContainer& lead=disCont[blipGroup[i]];
+    if (lead.groupLen==0) {
+      lead.groupMembers[0]=&lead;
+      lead.groupVol[0][0]=gainL[blipGroup[i]]*4096.0f;
+      lead.groupVol[0][1]=gainR[blipGroup[i]]*4096.0f;
+      lead.groupLen=1;
+    }
+    lead.groupMembers[lead.groupLen]=&disCont[i];
+    lead.groupVol[lead.groupLen][0]=gainL[i]*4096.0f;
+    lead.groupVol[lead.groupLen][1]=gainR[i]*4096.0f;
+    lead.groupLen++;
+  }
+  for (int i=0; i<song.systemLen; i++) {
+    if (blipGroup[i]!=i) {
+      disCont[i].joinGroup();
+      continue;
+    }
+    disCont[i].leaveGroup();
+    if (disCont[i].groupLen==0) continue;
+    // scale the sum down by the total volume so it never clips
+    int volSum=0;
+    for (int j=0; j<disCont[i].groupLen; j++) {
+      volSum+=MAX(disCont[i].groupVol[j][0],disCont[i].groupVol[j][1]);
+    }
+    disCont[i].groupShift=12;
+    while (volSum>4096) {
+      volSum=(volSum+1)>>1;
+      disCont[i].groupShift++;
+    }
+  }
+
   for (int i=0; i<song.systemLen; i++) {
-    lastAvail[i]=blip_samples_avail(disCont[i].bb[0]);
-    if (lastAvail[i]>0) {
-      disCont[i].flush(lastAvail[i]);
+    if (blipGroup[i]!=i) {
+      // resampled by the group leader
+      lastAvail[i]=lastAvail[blipGroup[i]];
+      runtotal[i]=runtotal[blipGroup[i]];
+    } else {
+      lastAvail[i]=blip_samples_avail(disCont[i].bb[0]);
+      if (lastAvail[i]>0) {
+        disCont[i].flush(lastAvail[i]);
+      }
+      runtotal[i]=blip_clocks_needed(disCont[i].bb[0],size-lastAvail[i]);
     }
-    runtotal[i]=blip_clocks_needed(disCont[i].bb[0],size-lastAvail[i]);
     if (runtotal[i]>disCont[i].bbInLen) {
       delete disCont[i].bbIn[0];
       delete disCont[i].bbIn[1];
@@ -1254,6 +1365,14 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
       disCont[i].bbIn[1]=new short[runtotal[i]+256];
       disCont[i].bbInLen=runtotal[i]+256;
     }
+    // only group leaders need a sum buffer
+    if (disCont[i].groupLen>0 && (disCont[i].groupIn[0]==NULL || runtotal[i]>disCont[i].groupInLen)) {
+      delete[] disCont[i].groupIn[0];
+      delete[] disCont[i].groupIn[1];
+      disCont[i].groupIn[0]=new int[runtotal[i]+256];
+      disCont[i].groupIn[1]=new int[runtotal[i]+256];
+      disCont[i].groupInLen=runtotal[i]+256;
+    }
     runLeft[i]=runtotal[i];
     runPos[i]=0;
   }
@@ -1266,15 +1385,12 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
 
   memset(metroTick,0,size);
 
-  int attempts=0;
+  // the buffer is split at every tick. each tick sets the distance to the
+  // next one (cycles), and every system renders the whole span up to it in
+  // one go. both steps always make progress, so there is no need for an
+  // attempt limit regardless of tick rate or buffer size.
   int runLeftG=size<<MASTER_CLOCK_PREC;
-  while (++attempts<100) {
-    // 0. check if we've halted
-    if (halted) break;
-    // 1. check whether we are done with all buffers
-    if (runLeftG<=0) break;
-
-    // 2. check whether we gonna tick
+  while (!halted && runLeftG>0) {
     if (cycles<=0) {
       // we have to tick
       if (!freelance && stepPlay!=-1) {
@@ -1287,7 +1403,10 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
           if ((curRow%song.hilightB)==0 && ticks==1) metroTick[realPos]=2;
         }
       }
-      if (nextTick()) {
+      perfTick.begin();
+      bool songEnded=nextTick();
+      perfTick.end();
+      if (songEnded) {
         if (remainingLoops>0) {
           remainingLoops--;
           if (!remainingLoops) {
@@ -1300,62 +1419,56 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
           }
         }
       }
+      // a tick must span at least one clock
+      if (cycles<=0) cycles=1;
     } else {
-      // 3. tick the clock and fill buffers as needed
+      // every system renders independently until the next tick
       if (cycles<runLeftG) {
+        // place the tick from the start of the buffer so rounding doesn't
+        // accumulate over many ticks
+        unsigned long long tickPos=(size<<MASTER_CLOCK_PREC)-runLeftG+cycles;
         for (int i=0; i<song.systemLen; i++) {
-          int total=(cycles*runtotal[i])/(size<<MASTER_CLOCK_PREC);
-          disCont[i].acquire(runPos[i],total);
+          size_t total=(tickPos*runtotal[i])/(size<<MASTER_CLOCK_PREC)-runPos[i];
+          if (total==0) continue;
+          disCont[i].queueAcquire(renderPool,runPos[i],total);
           runLeft[i]-=total;
           runPos[i]+=total;
         }
+        renderPool.run();
         runLeftG-=cycles;
         cycles=0;
       } else {
         cycles-=runLeftG;
         runLeftG=0;
         for (int i=0; i<song.systemLen; i++) {
-          disCont[i].acquire(runPos[i],runLeft[i]);
+          disCont[i].queueAcquire(renderPool,runPos[i],runLeft[i]);
           runLeft[i]=0;
         }
+        renderPool.run();
       }
     }
   }
 
   if (out==NULL || halted) {
+    perfBuf.end();
+    commitPerf();
     isBusy.unlock();
     return;
   }
 
-  logD("attempts: %d\n",attempts);
-  if (attempts>=100) {
-    logE("hang detected! stopping! at %d seconds %d micro\n",totalSeconds,totalTicks);
-    freelance=false;
-    playing=false;
-    extValuePresent=false;
-  }
   totalProcessed=size-(runLeftG>>MASTER_CLOCK_PREC);
 
   for (int i=0; i<song.systemLen; i++) {
-    disCont[i].fillBuf(runtotal[i],lastAvail[i],size-lastAvail[i]);
-  }
-
-  for (int i=0; i<song.systemLen; i++) {
-    float volL=((float)song.systemVol[i]/64.0f)*((float)MIN(127,127-(int)song.systemPan[i])/127.0f)*song.masterVol;
-    float volR=((float)song.systemVol[i]/64.0f)*((float)MIN(127,127+(int)song.systemPan[i])/127.0f)*song.masterVol;
-    if (disCont[i].dispatch->isStereo()) {
-      for (size_t j=0; j<size; j++) {
-        out[0][j]+=((float)disCont[i].bbOut[0][j]/32768.0)*volL;
-        out[1][j]+=((float)disCont[i].bbOut[1][j]/32768.0)*volR;
-      }
+    if (blipGroup[i]!=i) continue;
+    if (disCont[i].groupLen>0) {
+      disCont[i].queueFillGroupBuf(renderPool,runtotal[i],lastAvail[i],size-lastAvail[i]);
     } else {
-      for (size_t j=0; j<size; j++) {
-        out[0][j]+=((float)disCont[i].bbOut[0][j]/32768.0)*volL;
-        out[1][j]+=((float)disCont[i].bbOut[0][j]/32768.0)*volR;
-      }
+      disCont[i].queueFillBuf(renderPool,runtotal[i],lastAvail[i],size-lastAvail[i]);
     }
   }
+  renderPool.run();
 
+  // the metronome goes in first, so that the mix below is the last pass
   if (metronome) for (size_t i=0; i<size; i++) {
     if (metroTick[i]) {
       if (metroTick[i]==2) {
@@ -1376,15 +1489,30 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
     while (metroPos>=1) metroPos--;
   }
 
-  memcpy(oscBuf[0],out[0],size*sizeof(float));
-  memcpy(oscBuf[1],out[1],size*sizeof(float));
-  oscSize=size;
-
-  if (forceMono) {
-    for (size_t i=0; i<size; i++) {
-      out[0][i]=(out[0][i]+out[1][i])*0.5;
-      out[1][i]=out[0][i];
+  perfMix.begin();
+  DivMixSource mixSrc[32];
+  int mixSrcLen=0;
+  for (int i=0; i<song.systemLen; i++) {
+    if (blipGroup[i]!=i) continue;
+    DivMixSource& src=mixSrc[mixSrcLen++];
+    src.inL=disCont[i].bbOut[0];
+    src.inR=disCont[i].bbOut[1];
+    if (disCont[i].groupLen>0) {
+      // volumes are already applied. undo the headroom scale
+      src.gainL=song.masterVol*(float)(1<<(disCont[i].groupShift-12))/32768.0f;
+      src.gainR=src.gainL;
+      continue;
     }
+    // includes conversion from 16-bit
+    src.gainL=gainL[i]*song.masterVol/32768.0f;
+    src.gainR=gainR[i]*song.masterVol/32768.0f;
+    if (!disCont[i].dispatch->isStereo()) src.inR=NULL;
   }
+  // sums all systems and writes the output and scope buffers at once
+  divMixAll(out[0],out[1],oscBuf[0],oscBuf[1],mixSrc,mixSrcLen,forceMono,size);
+  perfMix.end();
+  oscSize=size;
+  perfBuf.end();
+  commitPerf();
   isBusy.unlock();
 }
@@ -82,7 +82,7 @@ short SafeReader::readS() {
   logD("SR: reading short %x:\n",curSeek);
 #endif
   if (curSeek+2>len) throw EndOfFileException(this,len);
-  short ret=*(short*)(&buf[curSeek]);
+  short ret=*(const short*)(&buf[curSeek]);
 #ifdef READ_DEBUG
   logD("SR: %.4x\n",ret);
 #endif
@@ -92,7 +92,7 @@ short SafeReader::readS() {
 
 short SafeReader::readS_BE() {
   if (curSeek+1>len) throw EndOfFileException(this,len);
-  short ret=*(short*)(&buf[curSeek]);
+  short ret=*(const short*)(&buf[curSeek]);
   curSeek+=2;
   return (ret>>8)|((ret&0xff)<<8);
 }
@@ -102,7 +102,7 @@ int SafeReader::readI() {
   logD("SR: reading int %x:\n",curSeek);
 #endif
   if (curSeek+4>len) throw EndOfFileException(this,len);
-  int ret=*(int*)(&buf[curSeek]);
+  int ret=*(const int*)(&buf[curSeek]);
   curSeek+=4;
 #ifdef READ_DEBUG
   logD("SR: %.8x\n",ret);
@@ -112,28 +112,28 @@ int SafeReader::readI() {
 
 int SafeReader::readI_BE() {
   if (curSeek+4>len) throw EndOfFileException(this,len);
-  int ret=*(int*)(&buf[curSeek]);
+  int ret=*(const int*)(&buf[curSeek]);
   curSeek+=4;
   return (ret>>24)|((ret&0xff0000)>>8)|((ret&0xff00)<<8)|((ret&0xff)<<24);
 }
 
 int64_t SafeReader::readL() {
   if (curSeek+8>len) throw EndOfFileException(this,len);
-  int64_t ret=*(int64_t*)(&buf[curSeek]);
+  int64_t ret=*(const int64_t*)(&buf[curSeek]);
   curSeek+=8;
   return ret;
 }
 
 float SafeReader::readF() {
   if (curSeek+4>len) throw EndOfFileException(this,len);
-  float ret=*(float*)(&buf[curSeek]);
+  float ret=*(const float*)(&buf[curSeek]);
   curSeek+=4;
   return ret;
 }
 
 double SafeReader::readD() {
   if (curSeek+8>len) throw EndOfFileException(this,len);
-  double ret=*(double*)(&buf[curSeek]);
+  double ret=*(const double*)(&buf[curSeek]);
   curSeek+=8;
   return ret;
 }
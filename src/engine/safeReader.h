@@ -35,7 +35,7 @@ struct EndOfFileException {
 };
 
 class SafeReader {
-  unsigned char* buf;
+  const unsigned char* buf;
   size_t len;
 
   size_t curSeek;
@@ -62,8 +62,8 @@ class SafeReader {
     String readString();
     String readString(size_t len);
 
-    SafeReader(void* b, size_t l):
-      buf((unsigned char*)b),
+    SafeReader(const void* b, size_t l):
+      buf((const unsigned char*)b),
       len(l),
       curSeek(0) {}
 };
@@ -20,19 +20,43 @@
 #include "safeWriter.h"
 
 #define WRITER_BUF_SIZE 16384
+#define WRITER_CHUNK_SIZE 1048576
 
 unsigned char* SafeWriter::getFinalBuf() {
+  if (file!=NULL) return NULL;
   return buf;
 }
 
 void SafeWriter::checkSize(size_t amount) {
-  while ((curSeek+amount)>=bufLen) {
-    unsigned char* newBuf=new unsigned char[bufLen+WRITER_BUF_SIZE];
-    memcpy(newBuf,buf,bufLen);
-    delete[] buf;
-    buf=newBuf;
-    bufLen+=WRITER_BUF_SIZE;
+  size_t need=curSeek+amount-bufStart;
+  if (need<bufLen) return;
+  // grow geometrically so writing n bytes is O(n)
+  size_t newLen=bufLen;
+  while (need>=newLen) newLen<<=1;
+  unsigned char* newBuf=new unsigned char[newLen];
+  memcpy(newBuf,buf,len-bufStart);
+  delete[] buf;
+  buf=newBuf;
+  bufLen=newLen;
+}
+
+bool SafeWriter::flush() {
+  if (file==NULL || len==bufStart) return true;
+  if (fseek(file,bufStart,SEEK_SET)!=0) {
+    failed=true;
+    return false;
+  }
+  if (fwrite(buf,1,len-bufStart,file)!=len-bufStart) {
+    failed=true;
+    return false;
   }
+  bufStart=len;
+  return true;
+}
+
+void SafeWriter::reserve(size_t amount) {
+  if (!operative || curSeek<bufStart) return;
+  checkSize(amount);
 }
 
 bool SafeWriter::seek(ssize_t where, int whence) {
@@ -66,10 +90,26 @@ size_t SafeWriter::size() {
 
 int SafeWriter::write(const void* what, size_t count) {
   if (!operative) return 0;
-  checkSize(count);
-  memcpy(buf+curSeek,what,count);
-  curSeek+=count;
-  if (curSeek>len) len=curSeek;
+  const unsigned char* src=(const unsigned char*)what;
+  size_t done=0;
+  if (curSeek<bufStart) {
+    // this part was flushed already. patch the file
+    done=MIN(count,bufStart-curSeek);
+    if (fseek(file,curSeek,SEEK_SET)!=0 || fwrite(src,1,done,file)!=done) {
+      failed=true;
+      return 0;
+    }
+    curSeek+=done;
+  }
+  if (done<count) {
+    checkSize(count-done);
+    memcpy(buf+(curSeek-bufStart),src+done,count-done);
+    curSeek+=count-done;
+    if (curSeek>len) len=curSeek;
+  }
+  if (file!=NULL && (len-bufStart)>=WRITER_CHUNK_SIZE) {
+    if (!flush()) return 0;
+  }
   return count;
 }
 
@@ -123,16 +163,29 @@ void SafeWriter::init() {
   bufLen=WRITER_BUF_SIZE;
   len=0;
   curSeek=0;
+  file=NULL;
+  bufStart=0;
+  failed=false;
   operative=true;
 }
 
+void SafeWriter::initFile(FILE* f) {
+  if (operative) return;
+  init();
+  file=f;
+}
+
 SafeReader* SafeWriter::toReader() {
+  if (file!=NULL) return NULL;
   return new SafeReader(buf,len);
 }
 
-void SafeWriter::finish() {
-  if (!operative) return;
+bool SafeWriter::finish() {
+  if (!operative) return false;
+  flush();
   delete[] buf;
   buf=NULL;
+  file=NULL;
   operative=false;
+  return !failed;
 }
\ No newline at end of file
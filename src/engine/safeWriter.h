@@ -33,9 +33,20 @@ class SafeWriter {
 
   size_t curSeek;
 
+  // in file mode, buf holds the data from bufStart onwards.
+  // everything before has been written to file already.
+  FILE* file;
+  size_t bufStart;
+  bool failed;
+
   void checkSize(size_t amount);
+  bool flush();
 
   public:
+    /**
+     * get the written data.
+     * @return the buffer, or NULL in file mode.
+     */
     unsigned char* getFinalBuf();
 
     bool seek(ssize_t where, int whence);
@@ -58,16 +69,37 @@ class SafeWriter {
     int writeWString(WString val, bool pascal);
     int writeString(String val, bool pascal);
 
+    /**
+     * make room for at least amount more bytes at the current position.
+     */
+    void reserve(size_t amount);
+
     void init();
+
+    /**
+     * like init(), but write to a file. finished data is flushed to it in
+     * chunks and seeking back to patch it still works.
+     * the file is not closed on finish().
+     */
+    void initFile(FILE* f);
+
     SafeReader* toReader();
-    void finish();
+
+    /**
+     * finish writing and free the buffer.
+     * @return false if writing to the file failed at any point.
+     */
+    bool finish();
 
     SafeWriter():
       operative(false),
       buf(NULL),
       bufLen(0),
       len(0),
-      curSeek(0) {}
+      curSeek(0),
+      file(NULL),
+      bufStart(0),
+      failed(false) {}
 };
 
 #endif
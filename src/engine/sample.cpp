@@ -22,6 +22,7 @@
 #include <string.h>
 #include <sndfile.h>
 #include <math.h>
+#include <utility>
 
 extern "C" {
 #include "../../extern/adpcm/bs_codec.h"
@@ -161,7 +162,7 @@ void DivSample::render() {
       case 1: { // DPCM
         int accum=0;
         for (unsigned int i=0; i<samples; i++) {
-          accum+=((data1[i>>3]>>(i&7))&1)?1:-1;
+          accum+=((dataDPCM[i>>3]>>(i&7))&1)?1:-1;
           if (accum>63) accum=63;
           if (accum<-64) accum=-64;
           data16[i]=accum*512;
@@ -302,6 +303,28 @@ unsigned int DivSample::getCurBufLen() {
   return 0;
 }
 
+#define SWAP_RENDERED(d,x,l) \
+  if (depth!=d) { \
+    std::swap(x,other->x); \
+    std::swap(l,other->l); \
+  }
+
+void DivSample::swapRendered(DivSample* other) {
+  SWAP_RENDERED(0,data1,length1);
+  SWAP_RENDERED(1,dataDPCM,lengthDPCM);
+  SWAP_RENDERED(4,dataQSoundA,lengthQSoundA);
+  SWAP_RENDERED(5,dataA,lengthA);
+  SWAP_RENDERED(6,dataB,lengthB);
+  SWAP_RENDERED(7,dataX68,lengthX68);
+  SWAP_RENDERED(8,data8,length8);
+  SWAP_RENDERED(9,dataBRR,lengthBRR);
+  SWAP_RENDERED(10,dataVOX,lengthVOX);
+  SWAP_RENDERED(16,data16,length16);
+  std::swap(offA,other->offA);
+  std::swap(offB,other->offB);
+  std::swap(offQSound,other->offQSound);
+}
+
 DivSample::~DivSample() {
   if (data8) delete[] data8;
   if (data16) delete[] data16;
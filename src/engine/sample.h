@@ -59,6 +59,9 @@ struct DivSample {
   void render();
   void* getCurBuf();
   unsigned int getCurBufLen();
+  // exchange the rendered data (everything but the buffer at the current
+  // depth) and sample memory offsets with another sample of the same depth.
+  void swapRendered(DivSample* other);
   DivSample():
     name(""),
     rate(32000),
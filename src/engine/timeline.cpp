@@ -0,0 +1,294 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2022 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "engine.h"
+#include <algorithm>
+
+void DivEngine::checkTimeline() {
+  DivTimeline& t=timeline;
+  if (t.valid &&
+      t.patLen==song.patLen &&
+      t.ordersLen==song.ordersLen &&
+      t.chans==chans &&
+      t.timeBase==song.timeBase &&
+      t.hz==song.hz &&
+      t.speed1==song.speed1 &&
+      t.speed2==song.speed2 &&
+      t.pal==song.pal &&
+      t.customTempo==song.customTempo) {
+    bool same=true;
+    for (int i=0; i<chans; i++) {
+      if (t.effectRows[i]!=song.pat[i].effectRows || memcmp(t.orders.ord[i],song.orders.ord[i],song.ordersLen)!=0) {
+        same=false;
+        break;
+      }
+    }
+    if (same) return;
+  }
+
+  t.valid=true;
+  t.patLen=song.patLen;
+  t.ordersLen=song.ordersLen;
+  t.chans=chans;
+  t.timeBase=song.timeBase;
+  t.hz=song.hz;
+  t.speed1=song.speed1;
+  t.speed2=song.speed2;
+  t.pal=song.pal;
+  t.customTempo=song.customTempo;
+  for (int i=0; i<chans; i++) {
+    t.effectRows[i]=song.pat[i].effectRows;
+    memcpy(t.orders.ord[i],song.orders.ord[i],128);
+  }
+
+  t.rows.clear();
+  t.rowIndex.assign(128<<8,-1);
+  t.complete=(song.ordersLen<1 || song.patLen<1);
+  t.stops=false;
+  t.loopOrder=0;
+  t.loopRow=0;
+  t.loopEnd=-1;
+  t.duration=0.0;
+
+  // same as reset()
+  t.next.time=0.0;
+  t.next.order=0;
+  t.next.row=0;
+  t.next.speed1=song.speed1;
+  t.next.speed2=song.speed2;
+  t.next.speedAB=false;
+  t.next.divider=60;
+  if (song.customTempo) {
+    t.next.divider=song.hz;
+  } else {
+    if (song.pal) {
+      t.next.divider=60;
+    } else {
+      t.next.divider=50;
+    }
+  }
+  if (t.next.divider<10) t.next.divider=10;
+}
+
+bool DivEngine::stepTimeline() {
+  DivTimeline& t=timeline;
+  if (t.complete) return false;
+
+  DivTimelineRow cur=t.next;
+  int index=(cur.order<<8)|(cur.row&0xff);
+  if (t.rowIndex[index]!=-1) {
+    // shouldn't happen without a jump back, but don't walk forever
+    t.complete=true;
+    t.duration=cur.time;
+    t.loopOrder=cur.order;
+    t.loopRow=cur.row;
+    return false;
+  }
+  t.rowIndex[index]=t.rows.size();
+  t.rows.push_back(cur);
+
+  // the effects that change timing or position, as processRow() does them
+  unsigned char speed1=cur.speed1;
+  unsigned char speed2=cur.speed2;
+  int divider=cur.divider;
+  int changeOrd=-1;
+  int changePos=0;
+  bool stop=false;
+  for (int i=0; i<chans; i++) {
+    DivPattern* pat=song.pat[i].getPattern(song.orders.ord[i][cur.order],false);
+    int evCount=0;
+    const DivPatternEvent* ev=pat->getEvents(cur.row,evCount);
+    int fxEnd=4+(song.pat[i].effectRows<<1);
+    for (int j=0; j<evCount; j++) {
+      if (ev[j].col<4) continue;
+      if (ev[j].col>=fxEnd) break;
+      short effect=ev[j].a;
+      short effectVal=ev[j].b;
+      switch (effect) {
+        case 0x09: // speed 1
+          if (effectVal>0) speed1=effectVal;
+          break;
+        case 0x0f: // speed 2
+          if (effectVal>0) speed2=effectVal;
+          break;
+        case 0x0b: // change order
+          if (changeOrd==-1) {
+            changeOrd=effectVal;
+            changePos=0;
+          }
+          break;
+        case 0x0d: // next order
+          if (changeOrd<0 && cur.order<(song.ordersLen-1)) {
+            changeOrd=-2;
+            changePos=effectVal;
+          }
+          break;
+        case 0xc0: case 0xc1: case 0xc2: case 0xc3: // set Hz
+          divider=((effect&0x3)<<8)|effectVal;
+          if (divider<10) divider=10;
+          break;
+        case 0xff: // stop song
+          stop=true;
+          break;
+      }
+    }
+  }
+
+  if (stop) {
+    t.complete=true;
+    t.stops=true;
+    t.duration=cur.time;
+    return false;
+  }
+
+  // move on, as nextRow() does
+  DivTimelineRow& n=t.next;
+  bool end=false;
+  n.order=cur.order;
+  n.row=cur.row;
+  if (changeOrd!=-1) {
+    n.row=changePos;
+    if (changeOrd==-2) changeOrd=cur.order+1;
+    if (changeOrd<=cur.order) {
+      end=true;
+      t.loopEnd=cur.order;
+    }
+    n.order=changeOrd;
+    if (n.order>=song.ordersLen) {
+      n.order=0;
+      end=true;
+      t.loopEnd=-1;
+    }
+  } else if (++n.row>=song.patLen) {
+    n.row=0;
+    if (++n.order>=song.ordersLen) {
+      n.order=0;
+      end=true;
+    }
+  }
+
+  int ticks=(cur.speedAB?speed2:speed1)*(song.timeBase+1);
+  if (ticks<1) ticks=1;
+  n.time=cur.time+(double)ticks/divider;
+  n.speed1=speed1;
+  n.speed2=speed2;
+  n.speedAB=!cur.speedAB;
+  n.divider=divider;
+
+  if (end) {
+    t.complete=true;
+    t.duration=n.time;
+    t.loopOrder=n.order;
+    t.loopRow=n.row;
+    return false;
+  }
+  return true;
+}
+
+void DivEngine::cutTimeline(int chan, int pat) {
+  DivTimeline& t=timeline;
+  if (!t.valid || chan<0 || chan>=chans) return;
+  size_t cut=t.rows.size();
+  for (size_t i=0; i<t.rows.size(); i++) {
+    if (song.orders.ord[chan][t.rows[i].order]==pat) {
+      cut=i;
+      break;
+    }
+  }
+  if (cut>=t.rows.size()) return;
+  for (size_t i=cut; i<t.rows.size(); i++) {
+    t.rowIndex[(t.rows[i].order<<8)|(t.rows[i].row&0xff)]=-1;
+  }
+  t.next=t.rows[cut];
+  t.rows.resize(cut);
+  t.complete=false;
+  t.stops=false;
+  t.loopOrder=0;
+  t.loopRow=0;
+  t.loopEnd=-1;
+  t.duration=0.0;
+}
+
+double DivEngine::getRowTimeUnlocked(int order, int row) {
+  if (order<0 || order>=128 || row<0 || row>=DIV_MAX_ROWS) return -1.0;
+  checkTimeline();
+  int index=(order<<8)|row;
+  while (timeline.rowIndex[index]==-1) {
+    if (!stepTimeline()) break;
+  }
+  if (timeline.rowIndex[index]==-1) return -1.0;
+  return timeline.rows[timeline.rowIndex[index]].time;
+}
+
+double DivEngine::getRowTime(int order, int row) {
+  isBusy.lock();
+  double ret=getRowTimeUnlocked(order,row);
+  isBusy.unlock();
+  return ret;
+}
+
+bool DivEngine::getRowAtTime(double time, int& order, int& row) {
+  isBusy.lock();
+  checkTimeline();
+  while (!timeline.complete && timeline.next.time<=time) {
+    stepTimeline();
+  }
+  std::vector<DivTimelineRow>& rows=timeline.rows;
+  bool ret=false;
+  if (!rows.empty() && time>=0.0 && (!timeline.complete || time<timeline.duration)) {
+    auto i=std::upper_bound(rows.begin(),rows.end(),time,[](double t, const DivTimelineRow& r) {
+      return t<r.time;
+    });
+    if (i!=rows.begin()) {
+      --i;
+      order=i->order;
+      row=i->row;
+      ret=true;
+    }
+  }
+  isBusy.unlock();
+  return ret;
+}
+
+double DivEngine::getSongLength(double* loopStart) {
+  isBusy.lock();
+  checkTimeline();
+  while (stepTimeline());
+  double ret=timeline.duration;
+  if (loopStart!=NULL) {
+    *loopStart=timeline.stops?-1.0:getRowTimeUnlocked(timeline.loopOrder,timeline.loopRow);
+  }
+  isBusy.unlock();
+  return ret;
+}
+
+void DivEngine::walkSong(int& loopOrder, int& loopRow, int& loopEnd) {
+  isBusy.lock();
+  checkTimeline();
+  while (stepTimeline());
+  loopOrder=0;
+  loopRow=0;
+  loopEnd=-1;
+  if (timeline.loopEnd!=-1) {
+    loopOrder=timeline.loopOrder;
+    loopRow=timeline.loopRow;
+    loopEnd=timeline.loopEnd;
+  }
+  isBusy.unlock();
+}
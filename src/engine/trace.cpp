@@ -0,0 +1,241 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2022 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "trace.h"
+#include "../ta-log.h"
+#include "../fileutils.h"
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <string.h>
+#include <errno.h>
+
+struct DivTraceBuffer {
+  DivTraceEvent events[DIV_TRACE_EVENTS];
+  // total number of events written. only the last DIV_TRACE_EVENTS are kept.
+  std::atomic<size_t> pos;
+  // the trace the events belong to. only the owner writes pos and this; it
+  // starts over once it sees a newer trace.
+  std::atomic<unsigned int> gen;
+  // whether a thread owns this buffer
+  std::atomic<bool> used;
+  DivTraceBuffer():
+    pos(0),
+    gen(0),
+    used(false) {}
+};
+
+struct DivTraceThread {
+  std::atomic<DivTraceBuffer*> buf;
+  int tid;
+  bool registered;
+  DivTraceThread():
+    buf(NULL),
+    tid(0),
+    registered(false) {}
+  ~DivTraceThread();
+};
+
+std::atomic<bool> traceRunning(false);
+
+// steady clock time in nanoseconds when the trace started.
+// atomic as traceStart() may run while other threads are recording
+static std::atomic<int64_t> traceEpoch(0);
+// incremented by traceStart(). buffers from an older trace count as empty.
+static std::atomic<unsigned int> traceGen(0);
+static std::atomic<int> traceNextTid(1);
+// guards allocating buffers and traceThreads
+static std::mutex traceBufLock;
+// buffers are never freed. one given back by a thread goes to the next one
+// which needs it, and its spans are kept until then.
+static DivTraceBuffer* traceBufs[DIV_TRACE_MAX_BUFS];
+static std::atomic<int> traceBufCount(0);
+static std::vector<DivTraceThread*> traceThreads;
+static thread_local DivTraceThread traceThread;
+
+DivTraceThread::~DivTraceThread() {
+  if (registered) {
+    std::lock_guard<std::mutex> lock(traceBufLock);
+    for (size_t i=0; i<traceThreads.size(); i++) {
+      if (traceThreads[i]==this) {
+        traceThreads.erase(traceThreads.begin()+i);
+        break;
+      }
+    }
+  }
+  DivTraceBuffer* b=buf.exchange(NULL);
+  if (b!=NULL) b->used.store(false,std::memory_order_release);
+}
+
+static int64_t traceClock() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t traceNow() {
+  return (uint64_t)(traceClock()-traceEpoch.load(std::memory_order_relaxed));
+}
+
+// take a free buffer without locking. returns NULL if there is none.
+static DivTraceBuffer* traceClaim() {
+  int count=traceBufCount.load(std::memory_order_acquire);
+  for (int i=0; i<count; i++) {
+    bool expected=false;
+    if (traceBufs[i]->used.compare_exchange_strong(expected,true,std::memory_order_acquire)) {
+      return traceBufs[i];
+    }
+  }
+  return NULL;
+}
+
+// give t a buffer if it doesn't have one. call with traceBufLock held.
+static void traceProvide(DivTraceThread* t) {
+  if (t->buf.load(std::memory_order_acquire)!=NULL) return;
+  DivTraceBuffer* b=traceClaim();
+  if (b==NULL) {
+    int count=traceBufCount.load(std::memory_order_relaxed);
+    if (count>=DIV_TRACE_MAX_BUFS) return;
+    b=new DivTraceBuffer;
+    b->used=true;
+    traceBufs[count]=b;
+    traceBufCount.store(count+1,std::memory_order_release);
+  }
+  DivTraceBuffer* expected=NULL;
+  // the thread may have taken a spare in the meantime
+  if (!t->buf.compare_exchange_strong(expected,b,std::memory_order_release)) {
+    b->used.store(false,std::memory_order_release);
+  }
+}
+
+void traceRecord(const DivTraceEvent& ev) {
+  DivTraceThread& t=traceThread;
+  DivTraceBuffer* b=t.buf.load(std::memory_order_acquire);
+  if (b==NULL) {
+    b=traceClaim();
+    if (b==NULL) return;
+    DivTraceBuffer* expected=NULL;
+    if (!t.buf.compare_exchange_strong(expected,b,std::memory_order_acq_rel)) {
+      b->used.store(false,std::memory_order_release);
+      b=expected;
+    }
+  }
+  if (t.tid==0) t.tid=traceNextTid++;
+  unsigned int g=traceGen.load(std::memory_order_acquire);
+  if (b->gen.load(std::memory_order_relaxed)!=g) {
+    b->pos.store(0,std::memory_order_relaxed);
+    b->gen.store(g,std::memory_order_release);
+  }
+  size_t p=b->pos.load(std::memory_order_relaxed);
+  DivTraceEvent& dest=b->events[p%DIV_TRACE_EVENTS];
+  dest=ev;
+  dest.tid=t.tid;
+  b->pos.store(p+1,std::memory_order_release);
+}
+
+void traceThreadStart() {
+  DivTraceThread& t=traceThread;
+  std::lock_guard<std::mutex> lock(traceBufLock);
+  if (t.registered) return;
+  t.registered=true;
+  if (t.tid==0) t.tid=traceNextTid++;
+  traceThreads.push_back(&t);
+  if (traceRunning) traceProvide(&t);
+}
+
+void traceStart() {
+  std::lock_guard<std::mutex> lock(traceBufLock);
+  traceGen++;
+  traceEpoch.store(traceClock(),std::memory_order_relaxed);
+  for (DivTraceThread* i: traceThreads) {
+    traceProvide(i);
+  }
+  int spare=0;
+  int count=traceBufCount.load(std::memory_order_relaxed);
+  for (int i=0; i<count; i++) {
+    if (!traceBufs[i]->used.load(std::memory_order_relaxed)) spare++;
+  }
+  for (; spare<DIV_TRACE_SPARE && count<DIV_TRACE_MAX_BUFS; spare++, count++) {
+    traceBufs[count]=new DivTraceBuffer;
+    traceBufCount.store(count+1,std::memory_order_release);
+  }
+  traceRunning=true;
+  logI("trace started.\n");
+}
+
+void traceStop() {
+  traceRunning=false;
+}
+
+// write a JSON string, escaping what needs it
+static void traceWriteString(FILE* f, const char* s) {
+  fputc('"',f);
+  for (; *s; s++) {
+    unsigned char c=*s;
+    if (c=='"' || c=='\\') {
+      fputc('\\',f);
+      fputc(c,f);
+    } else if (c<0x20) {
+      fprintf(f,"\\u%.4x",c);
+    } else {
+      fputc(c,f);
+    }
+  }
+  fputc('"',f);
+}
+
+bool traceSave(const char* path) {
+  traceStop();
+  FILE* f=ps_fopen(path,"wb");
+  if (f==NULL) {
+    logE("could not open trace file! %s\n",strerror(errno));
+    return false;
+  }
+  size_t total=0;
+  bool first=true;
+  fprintf(f,"{\"traceEvents\":[\n");
+  std::lock_guard<std::mutex> lock(traceBufLock);
+  unsigned int g=traceGen.load(std::memory_order_relaxed);
+  int count=traceBufCount.load(std::memory_order_relaxed);
+  for (int k=0; k<count; k++) {
+    DivTraceBuffer* i=traceBufs[k];
+    // not written to since this trace started
+    if (i->gen.load(std::memory_order_acquire)!=g) continue;
+    size_t end=i->pos.load(std::memory_order_acquire);
+    size_t begin=(end>DIV_TRACE_EVENTS)?(end-DIV_TRACE_EVENTS):0;
+    for (size_t j=begin; j<end; j++) {
+      DivTraceEvent& ev=i->events[j%DIV_TRACE_EVENTS];
+      fprintf(f,"%s{\"cat\":",first?"":",\n");
+      traceWriteString(f,ev.cat);
+      fprintf(f,",\"name\":");
+      traceWriteString(f,ev.name);
+      fprintf(f,",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",ev.tid,(double)ev.start/1000.0,(double)(ev.end-ev.start)/1000.0);
+      if (ev.argName!=NULL) {
+        fprintf(f,",\"args\":{");
+        traceWriteString(f,ev.argName);
+        fprintf(f,":%d}",ev.arg);
+      }
+      fprintf(f,"}");
+      first=false;
+    }
+    total+=end-begin;
+  }
+  fprintf(f,"\n],\"displayTimeUnit\":\"ns\"}\n");
+  fclose(f);
+  logI("wrote %d trace events to %s.\n",(int)total,path);
+  return true;
+}
@@ -0,0 +1,107 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2022 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _TRACE_H
+#define _TRACE_H
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// how many spans are kept per thread
+#define DIV_TRACE_EVENTS 65536
+// most buffers that may exist at once
+#define DIV_TRACE_MAX_BUFS 256
+// free buffers kept while tracing, for threads which weren't registered
+// (e.g. the audio callback)
+#define DIV_TRACE_SPARE 4
+
+struct DivTraceEvent {
+  // these must point to static strings
+  const char* cat;
+  const char* name;
+  const char* argName;
+  int arg;
+  // filled in by traceRecord()
+  int tid;
+  // nanoseconds since the trace started
+  uint64_t start, end;
+};
+
+extern std::atomic<bool> traceRunning;
+
+uint64_t traceNow();
+void traceRecord(const DivTraceEvent& ev);
+
+/**
+ * register the calling thread, so that traceStart() gives it a buffer.
+ * call this when a thread starts. its buffer is given back when it ends.
+ * threads which don't do this take a spare buffer the first time they
+ * record a span.
+ */
+void traceThreadStart();
+
+/**
+ * start recording spans. previously recorded spans are discarded.
+ */
+void traceStart();
+
+/**
+ * stop recording spans.
+ */
+void traceStop();
+
+/**
+ * stop recording and write the trace in Chrome trace event format (JSON),
+ * which can be opened in chrome://tracing or Perfetto.
+ * @return whether the trace was written.
+ */
+bool traceSave(const char* path);
+
+/**
+ * records the time spent until it goes out of scope.
+ * does nothing unless a trace is running.
+ * each thread records to its own ring buffer, so this never locks or
+ * allocates.
+ */
+struct DivTraceSpan {
+  DivTraceEvent ev;
+  bool active;
+
+  DivTraceSpan(const char* cat, const char* name, const char* argName=NULL, int arg=0):
+    active(traceRunning.load(std::memory_order_relaxed)) {
+    if (active) {
+      ev.cat=cat;
+      ev.name=name;
+      ev.argName=argName;
+      ev.arg=arg;
+      ev.start=traceNow();
+    }
+  }
+
+  ~DivTraceSpan() {
+    if (active && traceRunning.load(std::memory_order_relaxed)) {
+      ev.end=traceNow();
+      // the trace was restarted in the middle of this span
+      if (ev.end<ev.start) return;
+      traceRecord(ev);
+    }
+  }
+};
+
+#endif
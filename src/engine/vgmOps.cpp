@@ -20,7 +20,11 @@
 #include "engine.h"
 #include "../ta-log.h"
 #include "../utfutils.h"
+#include "../fileutils.h"
 #include "song.h"
+#include <fmt/printf.h>
+#include <errno.h>
+#include <string.h>
 
 constexpr int MASTER_CLOCK_PREC=(sizeof(void*)==8)?8:0;
 
@@ -445,18 +449,18 @@ void DivEngine::performVGMWrite(SafeWriter* w, DivSystem sys, DivRegWrite& write
   }
 }
 
-SafeWriter* DivEngine::saveVGM(bool* sysToExport, bool loop) {
+SafeWriter* DivEngine::saveVGM(bool* sysToExport, bool loop, FILE* f) {
   stop();
   repeatPattern=false;
   setOrder(0);
-  isBusy.lock();
-  double origRate=got.rate;
-  got.rate=44100;
-  // determine loop point
+  // determine loop point. walkSong() takes the lock itself
   int loopOrder=0;
   int loopRow=0;
   int loopEnd=0;
   walkSong(loopOrder,loopRow,loopEnd);
+  isBusy.lock();
+  double origRate=got.rate;
+  got.rate=44100;
   logI("loop point: %d %d\n",loopOrder,loopRow);
   warnings="";
 
@@ -527,7 +531,11 @@ SafeWriter* DivEngine::saveVGM(bool* sysToExport, bool loop) {
   int loopTick=-1;
 
   SafeWriter* w=new SafeWriter;
-  w->init();
+  if (f!=NULL) {
+    w->initFile(f);
+  } else {
+    w->init();
+  }
 
   // write header
   w->write("Vgm ",4);
@@ -887,30 +895,44 @@ SafeWriter* DivEngine::saveVGM(bool* sysToExport, bool loop) {
   }
 
   if (writeSegaPCM) {
-    unsigned char* pcmMem=new unsigned char[16777216];
+    // the sample data goes straight into the file. the block size is filled
+    // in afterwards
+    w->writeC(0x67);
+    w->writeC(0x66);
+    w->writeC(0x80);
+    size_t blockSizeOff=w->tell();
+    w->writeI(0);
+    w->writeI(0);
+    w->writeI(0);
 
     size_t memPos=0;
     for (int i=0; i<song.sampleLen; i++) {
       DivSample* sample=song.sample[i];
       if ((memPos&0xff0000)!=((memPos+sample->length8)&0xff0000)) {
-        memPos=(memPos+0xffff)&0xff0000;
+        size_t bankStart=(memPos+0xffff)&0xff0000;
+        w->reserve(bankStart-memPos);
+        for (; memPos<bankStart; memPos++) {
+          w->writeC(0x80);
+        }
       }
       if (memPos>=16777216) break;
       sample->offSegaPCM=memPos;
       unsigned int alignedSize=(sample->length8+0xff)&(~0xff);
       unsigned int readPos=0;
       if (alignedSize>65536) alignedSize=65536;
+      w->reserve(alignedSize);
       for (unsigned int j=0; j<alignedSize; j++) {
         if (readPos>=sample->length8) {
           if (sample->loopStart>=0 && sample->loopStart<(int)sample->length8) {
             readPos=sample->loopStart;
-            pcmMem[memPos++]=((unsigned char)sample->data8[readPos]+0x80);
+            w->writeC((unsigned char)sample->data8[readPos]+0x80);
           } else {
-            pcmMem[memPos++]=0x80;
+            w->writeC(0x80);
           }
         } else {
-          pcmMem[memPos++]=((unsigned char)sample->data8[readPos]+0x80);
+          w->writeC((unsigned char)sample->data8[readPos]+0x80);
         }
+        memPos++;
         readPos++;
         if (memPos>=16777216) break;
       }
@@ -918,15 +940,10 @@ SafeWriter* DivEngine::saveVGM(bool* sysToExport, bool loop) {
       if (memPos>=16777216) break;
     }
 
-    w->writeC(0x67);
-    w->writeC(0x66);
-    w->writeC(0x80);
+    w->seek(blockSizeOff,SEEK_SET);
     w->writeI(memPos+8);
     w->writeI(memPos);
-    w->writeI(0);
-    w->write(pcmMem,memPos);
-
-    delete[] pcmMem;
+    w->seek(0,SEEK_END);
   }
 
   if (writeADPCM && adpcmAMemLen>0) {
@@ -1224,3 +1241,30 @@ SafeWriter* DivEngine::saveVGM(bool* sysToExport, bool loop) {
   isBusy.unlock();
   return w;
 }
+
+bool DivEngine::saveVGMFile(const char* path, bool* sysToExport, bool loop) {
+  String tempName=String(path)+".tmp";
+  FILE* f=ps_fopen(tempName.c_str(),"wb");
+  if (f==NULL) {
+    lastError=fmt::sprintf("could not open file! (%s)",strerror(errno));
+    return false;
+  }
+  bool success=false;
+  SafeWriter* w=saveVGM(sysToExport,loop,f);
+  if (w!=NULL) {
+    success=w->finish();
+    delete w;
+  }
+  if (fclose(f)!=0) success=false;
+  if (!success) {
+    lastError=fmt::sprintf("could not write file! (%s)",strerror(errno));
+    remove(tempName.c_str());
+    return false;
+  }
+  if (!ps_replaceFile(tempName.c_str(),path)) {
+    // the export itself is fine, so keep it around
+    lastError=fmt::sprintf("could not replace file! (%s) the export was left in %s",strerror(errno),tempName);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,119 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2022 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "workPool.h"
+#include "trace.h"
+#include "../ta-log.h"
+
+void _divWorkPoolThread(DivWorkPool* pool) {
+  traceThreadStart();
+  pool->workerLoop();
+}
+
+void DivWorkPool::workerLoop() {
+  std::unique_lock<std::mutex> lock(m);
+  while (true) {
+    while (!terminate && nextJob>=jobCount) wake.wait(lock);
+    if (terminate) break;
+    DivWorkJob& job=jobs[nextJob++];
+    lock.unlock();
+    job.func(job.arg);
+    lock.lock();
+    if (++jobsDone>=jobCount) done.notify_one();
+  }
+}
+
+void DivWorkPool::push(void (*func)(void*), void* arg) {
+  if (queued>=DIV_WORK_POOL_MAX_JOBS) {
+    func(arg);
+    return;
+  }
+  jobs[queued].func=func;
+  jobs[queued].arg=arg;
+  queued++;
+}
+
+void DivWorkPool::run() {
+  if (queued<1) return;
+  if (threads==NULL || queued==1) {
+    for (int i=0; i<queued; i++) {
+      jobs[i].func(jobs[i].arg);
+    }
+    queued=0;
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(m);
+  jobCount=queued;
+  nextJob=0;
+  jobsDone=0;
+  wake.notify_all();
+
+  // help out
+  while (nextJob<jobCount) {
+    DivWorkJob& job=jobs[nextJob++];
+    lock.unlock();
+    job.func(job.arg);
+    lock.lock();
+    jobsDone++;
+  }
+  while (jobsDone<jobCount) done.wait(lock);
+
+  jobCount=0;
+  nextJob=0;
+  jobsDone=0;
+  queued=0;
+}
+
+int DivWorkPool::getThreadCount() {
+  return threadCount+1;
+}
+
+bool DivWorkPool::init(int count) {
+  if (threads!=NULL) return false;
+  if (count<2) return false;
+  threadCount=count-1;
+  terminate=false;
+  threads=new std::thread*[threadCount];
+  for (int i=0; i<threadCount; i++) {
+    threads[i]=new std::thread(_divWorkPoolThread,this);
+  }
+  logI("render pool started with %d threads.\n",count);
+  return true;
+}
+
+void DivWorkPool::quit() {
+  if (threads==NULL) return;
+  m.lock();
+  terminate=true;
+  wake.notify_all();
+  m.unlock();
+  for (int i=0; i<threadCount; i++) {
+    threads[i]->join();
+    delete threads[i];
+  }
+  delete[] threads;
+  threads=NULL;
+  threadCount=0;
+}
+
+DivWorkPool::~DivWorkPool() {
+  quit();
+}
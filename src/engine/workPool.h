@@ -0,0 +1,94 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2022 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef _WORKPOOL_H
+#define _WORKPOOL_H
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#define DIV_WORK_POOL_MAX_JOBS 64
+
+struct DivWorkJob {
+  void (*func)(void*);
+  void* arg;
+  DivWorkJob():
+    func(NULL),
+    arg(NULL) {}
+};
+
+/**
+ * a small fixed-size thread pool.
+ * jobs are queued with push() and executed by run(), which also puts the
+ * calling thread to work and returns once every job is done.
+ * push() and run() shall only be called from one thread.
+ */
+class DivWorkPool {
+  std::thread** threads;
+  int threadCount;
+  DivWorkJob jobs[DIV_WORK_POOL_MAX_JOBS];
+  int queued, jobCount, nextJob, jobsDone;
+  bool terminate;
+  std::mutex m;
+  std::condition_variable wake, done;
+
+  void workerLoop();
+  friend void _divWorkPoolThread(DivWorkPool* pool);
+
+  public:
+    /**
+     * queue a job. if the queue is full the job is executed immediately.
+     */
+    void push(void (*func)(void*), void* arg);
+
+    /**
+     * execute all queued jobs and wait for them to finish.
+     */
+    void run();
+
+    /**
+     * get the number of threads which take part in run(), including the caller.
+     */
+    int getThreadCount();
+
+    /**
+     * start the pool.
+     * @param count the total number of threads, including the calling one.
+     * @return whether the pool was started.
+     */
+    bool init(int count);
+
+    /**
+     * stop all worker threads.
+     */
+    void quit();
+
+    DivWorkPool():
+      threads(NULL),
+      threadCount(0),
+      queued(0),
+      jobCount(0),
+      nextJob(0),
+      jobsDone(0),
+      terminate(false) {}
+    ~DivWorkPool();
+};
+
+#endif
@@ -18,8 +18,16 @@
  */
 
 #include "fileutils.h"
+#include <errno.h>
 #ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
 #include "utfutils.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 FILE* ps_fopen(const char* path, const char* mode) {
@@ -29,3 +37,96 @@ FILE* ps_fopen(const char* path, const char* mode) {
   return fopen(path,mode);
 #endif
 }
+
+bool ps_replaceFile(const char* from, const char* to) {
+#ifdef _WIN32
+  // rename() doesn't replace an existing file here
+  if (!MoveFileExW(utf8To16(from).c_str(),utf8To16(to).c_str(),MOVEFILE_REPLACE_EXISTING)) {
+    errno=(GetLastError()==ERROR_ACCESS_DENIED)?EACCES:EIO;
+    return false;
+  }
+  return true;
+#else
+  return rename(from,to)==0;
+#endif
+}
+
+bool ps_mapFile(const char* path, PSFileMapping& m) {
+  m.data=NULL;
+  m.len=0;
+#ifdef _WIN32
+  HANDLE f=CreateFileW(utf8To16(path).c_str(),GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,NULL);
+  if (f==INVALID_HANDLE_VALUE) {
+    switch (GetLastError()) {
+      case ERROR_FILE_NOT_FOUND: case ERROR_PATH_NOT_FOUND:
+        errno=ENOENT;
+        break;
+      case ERROR_ACCESS_DENIED: case ERROR_SHARING_VIOLATION:
+        errno=EACCES;
+        break;
+      default:
+        errno=EIO;
+        break;
+    }
+    return false;
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(f,&size)) {
+    CloseHandle(f);
+    errno=EIO;
+    return false;
+  }
+  if (size.QuadPart==0) {
+    CloseHandle(f);
+    return true;
+  }
+  HANDLE map=CreateFileMappingW(f,NULL,PAGE_READONLY,0,0,NULL);
+  if (map==NULL) {
+    CloseHandle(f);
+    errno=EIO;
+    return false;
+  }
+  // the view keeps the mapping alive
+  void* view=MapViewOfFile(map,FILE_MAP_READ,0,0,0);
+  CloseHandle(map);
+  CloseHandle(f);
+  if (view==NULL) {
+    errno=ENOMEM;
+    return false;
+  }
+  m.data=(const unsigned char*)view;
+  m.len=size.QuadPart;
+  return true;
+#else
+  int fd=open(path,O_RDONLY);
+  if (fd<0) return false;
+  struct stat st;
+  if (fstat(fd,&st)<0) {
+    close(fd);
+    return false;
+  }
+  if (st.st_size==0) {
+    close(fd);
+    return true;
+  }
+  void* view=mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+  close(fd);
+  if (view==MAP_FAILED) return false;
+  madvise(view,st.st_size,MADV_WILLNEED);
+  m.data=(const unsigned char*)view;
+  m.len=st.st_size;
+  return true;
+#endif
+}
+
+void ps_unmapFile(PSFileMapping& m) {
+  if (m.data!=NULL) {
+#ifdef _WIN32
+    UnmapViewOfFile((LPCVOID)m.data);
+#else
+    munmap((void*)m.data,m.len);
+#endif
+  }
+  m.data=NULL;
+  m.len=0;
+}
@@ -20,7 +20,25 @@
 #ifndef _FILEUTILS_H
 #define _FILEUTILS_H
 #include <stdio.h>
+#include <stddef.h>
 
 FILE* ps_fopen(const char* path, const char* mode);
+// move a file over another one, replacing it if it exists.
+// on failure the destination is left untouched and errno is set.
+bool ps_replaceFile(const char* from, const char* to);
+
+// a read-only view of a whole file.
+struct PSFileMapping {
+  const unsigned char* data;
+  size_t len;
+  PSFileMapping():
+    data(NULL),
+    len(0) {}
+};
+
+// map a file into memory. on failure errno is set.
+// an empty file maps to NULL with a length of 0.
+bool ps_mapFile(const char* path, PSFileMapping& m);
+void ps_unmapFile(PSFileMapping& m);
 
 #endif
@@ -237,3 +237,16 @@ void putDispatchChan(void* data, int chanNum, int type) {
       break;
   }
 }
+
+void putPerfCounter(const char* name, const DivPerfCounter* counter) {
+  if (counter==NULL) return;
+  ImGui::TableNextRow();
+  ImGui::TableNextColumn();
+  ImGui::Text("%s",name);
+  ImGui::TableNextColumn();
+  ImGui::Text("%.1f",(double)counter->last/1000.0);
+  ImGui::TableNextColumn();
+  ImGui::Text("%.1f",(double)counter->avg/1000.0);
+  ImGui::TableNextColumn();
+  ImGui::Text("%.1f",(double)counter->peak/1000.0);
+}
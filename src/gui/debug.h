@@ -20,6 +20,8 @@
 #ifndef _GUI_DEBUG_H
 #define _GUI_DEBUG_H
 #include "../engine/song.h"
+#include "../engine/perfCounter.h"
 
 void putDispatchChan(void* data, int chanNum, int type);
+void putPerfCounter(const char* name, const DivPerfCounter* counter);
 #endif
\ No newline at end of file
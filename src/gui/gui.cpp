@@ -924,6 +924,7 @@ void FurnaceGUI::drawSongInfo() {
         if (realTB<1) realTB=1;
         if (realTB>16) realTB=16;
         e->song.timeBase=realTB-1;
+        e->notifySongChange();
       }
       ImGui::TableNextColumn();
       float hl=e->song.hilightA;
@@ -941,12 +942,14 @@ void FurnaceGUI::drawSongInfo() {
       ImGui::SetNextItemWidth(avail);
       if (ImGui::InputScalar("##Speed1",ImGuiDataType_U8,&e->song.speed1,&_ONE,&_THREE)) {
         if (e->song.speed1<1) e->song.speed1=1;
+        e->notifySongChange();
         if (e->isPlaying()) play();
       }
       ImGui::TableNextColumn();
       ImGui::SetNextItemWidth(avail);
       if (ImGui::InputScalar("##Speed2",ImGuiDataType_U8,&e->song.speed2,&_ONE,&_THREE)) {
         if (e->song.speed2<1) e->song.speed2=1;
+        e->notifySongChange();
         if (e->isPlaying()) play();
       }
 
@@ -969,7 +972,8 @@ void FurnaceGUI::drawSongInfo() {
       if (ImGui::InputInt("##PatLength",&patLen,1,3)) {
         if (patLen<1) patLen=1;
         if (patLen>256) patLen=256;
-        e->song.patLen=patLen;
+        e->setPatLen(patLen);
+        e->notifySongChange();
       }
 
       ImGui::TableNextRow();
@@ -982,6 +986,7 @@ void FurnaceGUI::drawSongInfo() {
         if (ordLen<1) ordLen=1;
         if (ordLen>127) ordLen=127;
         e->song.ordersLen=ordLen;
+        e->notifySongChange();
       }
 
       ImGui::TableNextRow();
@@ -1014,6 +1019,7 @@ void FurnaceGUI::drawSongInfo() {
         if (tune<220.0f) tune=220.0f;
         if (tune>880.0f) tune=880.0f;
         e->song.tuning=tune;
+        e->notifySongChange();
       }
       ImGui::EndTable();
     }
@@ -1894,6 +1900,44 @@ void FurnaceGUI::drawDebug() {
       }
       ImGui::TreePop();
     }
+    if (ImGui::TreeNode("Performance")) {
+      ImGui::Text("times are per buffer, in microseconds.");
+      if (ImGui::Button("Reset")) e->resetPerfCounters();
+      if (ImGui::BeginTable("PerfCounters",4,ImGuiTableFlags_SizingFixedSame)) {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::Text("Stage");
+        ImGui::TableNextColumn();
+        ImGui::Text("Last");
+        ImGui::TableNextColumn();
+        ImGui::Text("Average");
+        ImGui::TableNextColumn();
+        ImGui::Text("Peak");
+        putPerfCounter("Buffer",e->getPerfCounter(DIV_PERF_BUFFER));
+        putPerfCounter("Tick",e->getPerfCounter(DIV_PERF_TICK));
+        putPerfCounter("Mix",e->getPerfCounter(DIV_PERF_MIX));
+        for (int i=0; i<e->song.systemLen; i++) {
+          String sysName=fmt::sprintf("%d. %s",i+1,e->getSystemName(e->song.system[i]));
+          putPerfCounter((sysName+" tick").c_str(),e->getPerfCounter(DIV_PERF_SYS_TICK,i));
+          putPerfCounter((sysName+" acquire").c_str(),e->getPerfCounter(DIV_PERF_SYS_ACQUIRE,i));
+          putPerfCounter((sysName+" fillBuf").c_str(),e->getPerfCounter(DIV_PERF_SYS_FILL_BUF,i));
+        }
+        ImGui::EndTable();
+      }
+      ImGui::TreePop();
+    }
+    if (ImGui::TreeNode("Trace")) {
+      ImGui::Text("records audio thread activity for viewing in chrome://tracing or Perfetto.");
+      if (traceRunning) {
+        if (ImGui::Button("Stop and Save")) {
+          traceStop();
+          openFileDialog(GUI_FILE_SAVE_TRACE);
+        }
+      } else {
+        if (ImGui::Button("Start")) traceStart();
+      }
+      ImGui::TreePop();
+    }
     if (ImGui::TreeNode("Settings")) {
       if (ImGui::Button("Sync")) syncSettings();
       ImGui::SameLine();
@@ -1999,6 +2043,17 @@ void FurnaceGUI::drawStats() {
     ImGui::Text("QSound");
     ImGui::SameLine();
     ImGui::ProgressBar(((float)e->qsoundMemLen)/16777216.0f,ImVec2(-FLT_MIN,0),qsoundUsage.c_str());
+    float loadAvg, loadPeak;
+    e->getPerfLoad(loadAvg,loadPeak);
+    String loadUsage=fmt::sprintf("%d%% (%d%% peak)",(int)(loadAvg*100.0f),(int)(loadPeak*100.0f));
+    ImGui::Text("Audio load");
+    ImGui::SameLine();
+    ImGui::ProgressBar(MIN(1.0f,loadAvg),ImVec2(-FLT_MIN,0),loadUsage.c_str());
+    for (int i=0; i<e->song.systemLen; i++) {
+      const DivPerfCounter* acquire=e->getPerfCounter(DIV_PERF_SYS_ACQUIRE,i);
+      if (acquire==NULL) continue;
+      ImGui::Text("%d. %s: %.1fus",i+1,e->getSystemName(e->song.system[i]),(double)acquire->avg/1000.0);
+    }
   }
   if (ImGui::IsWindowFocused(ImGuiFocusedFlags_ChildWindows)) curWindow=GUI_WINDOW_STATS;
   ImGui::End();
@@ -2013,48 +2068,48 @@ void FurnaceGUI::drawCompatFlags() {
   if (!compatFlagsOpen) return;
   if (ImGui::Begin("Compatibility Flags",&compatFlagsOpen)) {
     ImGui::TextWrapped("these flags are stored in the song when saving in .fur format, and are automatically enabled when saving in .dmf format.");
-    ImGui::Checkbox("Limit slide range",&e->song.limitSlides);
+    if (ImGui::Checkbox("Limit slide range",&e->song.limitSlides)) e->notifySongChange();
     if (ImGui::IsItemHovered()) {
       ImGui::SetTooltip("when enabled, slides are limited to a compatible range.\nmay cause problems with slides in negative octaves.");
     }
-    ImGui::Checkbox("Linear pitch control",&e->song.linearPitch);
+    if (ImGui::Checkbox("Linear pitch control",&e->song.linearPitch)) e->notifySongChange();
     if (ImGui::IsItemHovered()) {
       ImGui::SetTooltip("linear pitch:\n- slides work in frequency/period space\n- E5xx and 04xx effects work in tonality space\nnon-linear pitch:\n- slides work in frequency/period space\n- E5xx and 04xx effects work on frequency/period space");
     }
-    ImGui::Checkbox("Proper noise layout on NES and PC Engine",&e->song.properNoiseLayout);
+    if (ImGui::Checkbox("Proper noise layout on NES and PC Engine",&e->song.properNoiseLayout)) e->notifySongChange();
     if (ImGui::IsItemHovered()) {
       ImGui::SetTooltip("use a proper noise channel note mapping (0-15) instead of a rather unusual compatible one.\nunlocks all noise frequencies on PC Engine.");
     }
-    ImGui::Checkbox("Game Boy instrument duty is wave volume",&e->song.waveDutyIsVol);
+    if (ImGui::Checkbox("Game Boy instrument duty is wave volume",&e->song.waveDutyIsVol)) e->notifySongChange();
     if (ImGui::IsItemHovered()) {
       ImGui::SetTooltip("if enabled, an instrument with duty macro in the wave channel will be mapped to wavetable volume.");
     }
 
-    ImGui::Checkbox("Restart macro on portamento",&e->song.resetMacroOnPorta);
+    if (ImGui::Checkbox("Restart macro on portamento",&e->song.resetMacroOnPorta)) e->notifySongChange();
     if (ImGui::IsItemHovered()) {
       ImGui::SetTooltip("when enabled, a portamento effect will reset the channel's macro if used in combination with a note.");
     }
-    ImGui::Checkbox("Legacy volume slides",&e->song.legacyVolumeSlides);
+    if (ImGui::Checkbox("Legacy volume slides",&e->song.legacyVolumeSlides)) e->notifySongChange();
     if (ImGui::IsItemHovered()) {
       ImGui::SetTooltip("simulate glitchy volume slide behavior by silently overflowing the volume when the slide goes below 0.");
     }
-    ImGui::Checkbox("Compatible arpeggio",&e->song.compatibleArpeggio);
+    if (ImGui::Checkbox("Compatible arpeggio",&e->song.compatibleArpeggio)) e->notifySongChange();
     if (ImGui::IsItemHovered()) {
       ImGui::SetTooltip("delay arpeggio by one tick on every new note.");
     }
-    ImGui::Checkbox("Reset slides after note off",&e->song.noteOffResetsSlides);
+    if (ImGui::Checkbox("Reset slides after note off",&e->song.noteOffResetsSlides)) e->notifySongChange();
     if (ImGui::IsItemHovered()) {
       ImGui::SetTooltip("when enabled, note off will reset the channel's slide effect.");
     }
-    ImGui::Checkbox("Reset portamento after reaching target",&e->song.targetResetsSlides);
+    if (ImGui::Checkbox("Reset portamento after reaching target",&e->song.targetResetsSlides)) e->notifySongChange();
     if (ImGui::IsItemHovered()) {
       ImGui::SetTooltip("when enabled, the slide effect is disabled after it reaches its target.");
     }
-    ImGui::Checkbox("Ignore duplicate slide effects",&e->song.ignoreDuplicateSlides);
+    if (ImGui::Checkbox("Ignore duplicate slide effects",&e->song.ignoreDuplicateSlides)) e->notifySongChange();
     if (ImGui::IsItemHovered()) {
       ImGui::SetTooltip("if this is on, only the first slide of a row in a channel will be considered.");
     }
-    ImGui::Checkbox("Continuous vibrato",&e->song.continuousVibrato);
+    if (ImGui::Checkbox("Continuous vibrato",&e->song.continuousVibrato)) e->notifySongChange();
     if (ImGui::IsItemHovered()) {
       ImGui::SetTooltip("when enabled, vibrato will not be reset on a new note.");
     }
@@ -2083,19 +2138,19 @@ void FurnaceGUI::drawCompatFlags() {
 
     ImGui::TextWrapped("the following flags are for compatibility with older Furnace versions.");
 
-    ImGui::Checkbox("Arpeggio inhibits non-porta slides",&e->song.arpNonPorta);
+    if (ImGui::Checkbox("Arpeggio inhibits non-porta slides",&e->song.arpNonPorta)) e->notifySongChange();
     if (ImGui::IsItemHovered()) {
       ImGui::SetTooltip("behavior changed in 0.5.5");
     }
-    ImGui::Checkbox("Wack FM algorithm macro",&e->song.algMacroBehavior);
+    if (ImGui::Checkbox("Wack FM algorithm macro",&e->song.algMacroBehavior)) e->notifySongChange();
     if (ImGui::IsItemHovered()) {
       ImGui::SetTooltip("behavior changed in 0.5.5");
     }
-    ImGui::Checkbox("Broken shortcut slides (E1xy/E2xy)",&e->song.brokenShortcutSlides);
+    if (ImGui::Checkbox("Broken shortcut slides (E1xy/E2xy)",&e->song.brokenShortcutSlides)) e->notifySongChange();
     if (ImGui::IsItemHovered()) {
       ImGui::SetTooltip("behavior changed in 0.5.7");
     }
-    ImGui::Checkbox("Stop portamento on note off",&e->song.stopPortaOnNoteOff);
+    if (ImGui::Checkbox("Stop portamento on note off",&e->song.stopPortaOnNoteOff)) e->notifySongChange();
     if (ImGui::IsItemHovered()) {
       ImGui::SetTooltip("behavior changed in 0.6");
     }
@@ -2565,13 +2620,17 @@ void FurnaceGUI::makeUndo(ActionType action) {
     case GUI_UNDO_PATTERN_PASTE:
       for (int i=0; i<e->getTotalChannelCount(); i++) {
         DivPattern* p=e->song.pat[i].getPattern(e->song.orders.ord[i][order],false);
+        size_t oldSize=s.pat.size();
         for (int j=0; j<e->song.patLen; j++) {
-          for (int k=0; k<32; k++) {
+          for (int k=0; k<p->data.cols; k++) {
             if (p->data[j][k]!=oldPat[i]->data[j][k]) {
               s.pat.push_back(UndoPatternData(i,e->song.orders.ord[i][order],j,k,oldPat[i]->data[j][k],p->data[j][k]));
             }
           }
         }
+        if (s.pat.size()!=oldSize) {
+          e->notifyPatternChange(i,e->song.orders.ord[i][order]);
+        }
       }
       if (!s.pat.empty()) {
         doPush=true;
@@ -2580,6 +2639,7 @@ void FurnaceGUI::makeUndo(ActionType action) {
   }
   if (doPush) {
     modified=true;
+    e->notifySongChange();
     undoHist.push_back(s);
     redoHist.clear();
     if (undoHist.size()>settings.maxUndoSteps) undoHist.pop_front();
@@ -2934,6 +2994,17 @@ void FurnaceGUI::doPaste() {
   makeUndo(GUI_UNDO_PATTERN_PASTE);
 }
 
+void FurnaceGUI::notifyUndoPatterns(UndoStep& us) {
+  int lastChan=-1;
+  int lastPat=-1;
+  for (UndoPatternData& i: us.pat) {
+    if (i.chan==lastChan && i.pat==lastPat) continue;
+    e->notifyPatternChange(i.chan,i.pat);
+    lastChan=i.chan;
+    lastPat=i.pat;
+  }
+}
+
 void FurnaceGUI::doUndo() {
   if (undoHist.empty()) return;
   UndoStep& us=undoHist.back();
@@ -2946,6 +3017,7 @@ void FurnaceGUI::doUndo() {
       for (UndoOrderData& i: us.ord) {
         e->song.orders.ord[i.chan][i.ord]=i.oldVal;
       }
+      e->notifySongChange();
       break;
     case GUI_UNDO_PATTERN_EDIT:
     case GUI_UNDO_PATTERN_DELETE:
@@ -2957,6 +3029,8 @@ void FurnaceGUI::doUndo() {
         DivPattern* p=e->song.pat[i.chan].getPattern(i.pat,true);
         p->data[i.row][i.col]=i.oldVal;
       }
+      notifyUndoPatterns(us);
+      e->notifySongChange();
       if (!e->isPlaying()) {
         cursor=us.cursor;
         selStart=us.selStart;
@@ -2983,6 +3057,7 @@ void FurnaceGUI::doRedo() {
       for (UndoOrderData& i: us.ord) {
         e->song.orders.ord[i.chan][i.ord]=i.newVal;
       }
+      e->notifySongChange();
       break;
     case GUI_UNDO_PATTERN_EDIT:
     case GUI_UNDO_PATTERN_DELETE:
@@ -2994,6 +3069,8 @@ void FurnaceGUI::doRedo() {
         DivPattern* p=e->song.pat[i.chan].getPattern(i.pat,true);
         p->data[i.row][i.col]=i.newVal;
       }
+      notifyUndoPatterns(us);
+      e->notifySongChange();
       if (!e->isPlaying()) {
         cursor=us.cursor;
         selStart=us.selStart;
@@ -3458,13 +3535,11 @@ void FurnaceGUI::doAction(int what) {
       break;
     case GUI_ACTION_PAT_INCREASE_COLUMNS:
       if (cursor.xCoarse<0 || cursor.xCoarse>=e->getTotalChannelCount()) break;
-      e->song.pat[cursor.xCoarse].effectRows++;
-              if (e->song.pat[cursor.xCoarse].effectRows>8) e->song.pat[cursor.xCoarse].effectRows=8;
+      e->setEffectRows(cursor.xCoarse,e->song.pat[cursor.xCoarse].effectRows+1);
       break;
     case GUI_ACTION_PAT_DECREASE_COLUMNS:
       if (cursor.xCoarse<0 || cursor.xCoarse>=e->getTotalChannelCount()) break;
-      e->song.pat[cursor.xCoarse].effectRows--;
-      if (e->song.pat[cursor.xCoarse].effectRows<1) e->song.pat[cursor.xCoarse].effectRows=1;
+      e->setEffectRows(cursor.xCoarse,e->song.pat[cursor.xCoarse].effectRows-1);
       break;
 
     case GUI_ACTION_INS_LIST_ADD:
@@ -3631,6 +3706,7 @@ void FurnaceGUI::doAction(int what) {
       int curOrder=e->getOrder();
       if (e->song.orders.ord[orderCursor][curOrder]<0x7f) {
         e->song.orders.ord[orderCursor][curOrder]++;
+        e->notifySongChange();
       }
       break;
     }
@@ -3639,6 +3715,7 @@ void FurnaceGUI::doAction(int what) {
       int curOrder=e->getOrder();
       if (e->song.orders.ord[orderCursor][curOrder]>0) {
         e->song.orders.ord[orderCursor][curOrder]--;
+        e->notifySongChange();
       }
       break;
     }
@@ -3859,6 +3936,7 @@ void FurnaceGUI::keyDown(SDL_Event& ev) {
           if (orderCursor>=0 && orderCursor<e->getTotalChannelCount()) {
             int curOrder=e->getOrder();
             e->song.orders.ord[orderCursor][curOrder]=((e->song.orders.ord[orderCursor][curOrder]<<4)|num)&0x7f;
+            e->notifySongChange();
             if (orderEditMode==2 || orderEditMode==3) {
               curNibble=!curNibble;
               if (!curNibble) {
@@ -4069,6 +4147,9 @@ void FurnaceGUI::openFileDialog(FurnaceGUIFileDialogs type) {
       if (!dirExists(workingDirFont)) workingDirFont=getHomeDir();
       ImGuiFileDialog::Instance()->OpenModal("FileDialog","Select Font","compatible files{.ttf,.otf,.ttc}",workingDirFont);
       break;
+    case GUI_FILE_SAVE_TRACE:
+      ImGuiFileDialog::Instance()->OpenModal("FileDialog","Save Trace","Trace file{.json}",getHomeDir(),1,nullptr,ImGuiFileDialogFlags_ConfirmOverwrite);
+      break;
   }
   curFileDialog=type;
   //ImGui::GetIO().ConfigFlags|=ImGuiConfigFlags_NavEnableKeyboard;
@@ -4174,53 +4255,7 @@ int FurnaceGUI::save(String path, int dmfVersion) {
 int FurnaceGUI::load(String path) {
   if (!path.empty()) {
     logI("loading module...\n");
-    FILE* f=ps_fopen(path.c_str(),"rb");
-    if (f==NULL) {
-      perror("error");
-      lastError=strerror(errno);
-      return 1;
-    }
-    if (fseek(f,0,SEEK_END)<0) {
-      perror("size error");
-      lastError=fmt::sprintf("on seek: %s",strerror(errno));
-      fclose(f);
-      return 1;
-    }
-    ssize_t len=ftell(f);
-    if (len==(SIZE_MAX>>1)) {
-      perror("could not get file length");
-      lastError=fmt::sprintf("on pre tell: %s",strerror(errno));
-      fclose(f);
-      return 1;
-    }
-    if (len<1) {
-      if (len==0) {
-        printf("that file is empty!\n");
-        lastError="file is empty";
-      } else {
-        perror("tell error");
-        lastError=fmt::sprintf("on tell: %s",strerror(errno));
-      }
-      fclose(f);
-      return 1;
-    }
-    unsigned char* file=new unsigned char[len];
-    if (fseek(f,0,SEEK_SET)<0) {
-      perror("size error");
-      lastError=fmt::sprintf("on get size: %s",strerror(errno));
-      fclose(f);
-      delete[] file;
-      return 1;
-    }
-    if (fread(file,1,(size_t)len,f)!=(size_t)len) {
-      perror("read error");
-      lastError=fmt::sprintf("on read: %s",strerror(errno));
-      fclose(f);
-      delete[] file;
-      return 1;
-    }
-    fclose(f);
-    if (!e->load(file,(size_t)len)) {
+    if (!e->loadFile(path.c_str())) {
       lastError=e->getLastError();
       logE("could not open file!\n");
       return 1;
@@ -4396,7 +4431,10 @@ bool FurnaceGUI::loop() {
           break;
         }
         case SDL_MOUSEBUTTONUP:
-          if (macroDragActive || macroLoopDragActive || waveDragActive) modified=true;
+          if (macroDragActive || macroLoopDragActive || waveDragActive) {
+            modified=true;
+            e->notifySongChange();
+          }
           macroDragActive=false;
           macroDragBitMode=false;
           macroDragInitialValue=false;
@@ -4729,20 +4767,26 @@ bool FurnaceGUI::loop() {
                   updateWindowTitle();
                 }
                 break;
-              case DIV_SYSTEM_NES:
-                if (ImGui::RadioButton("NTSC (1.79MHz)",flags==0)) {
-                  e->setSysFlags(i,0,restart);
+              case DIV_SYSTEM_NES: {
+                if (ImGui::RadioButton("NTSC (1.79MHz)",(flags&3)==0)) {
+                  e->setSysFlags(i,(flags&(~3))|0,restart);
                   updateWindowTitle();
                 }
-                if (ImGui::RadioButton("PAL (1.67MHz)",flags==1)) {
-                  e->setSysFlags(i,1,restart);
+                if (ImGui::RadioButton("PAL (1.67MHz)",(flags&3)==1)) {
+                  e->setSysFlags(i,(flags&(~3))|1,restart);
                   updateWindowTitle();
                 }
-                if (ImGui::RadioButton("Dendy (1.77MHz)",flags==2)) {
-                  e->setSysFlags(i,2,restart);
+                if (ImGui::RadioButton("Dendy (1.77MHz)",(flags&3)==2)) {
+                  e->setSysFlags(i,(flags&(~3))|2,restart);
+                  updateWindowTitle();
+                }
+                bool fastEmu=flags&16;
+                if (ImGui::Checkbox("Fast emulation (lower internal rate)",&fastEmu)) {
+                  e->setSysFlags(i,(flags&(~16))|(fastEmu?16:0),restart);
                   updateWindowTitle();
                 }
                 break;
+              }
               case DIV_SYSTEM_AY8910:
               case DIV_SYSTEM_AY8930: {
                 ImGui::Text("Clock rate:");
@@ -4862,7 +4906,39 @@ bool FurnaceGUI::loop() {
                 } rightClickable
                 break;
               }
-              case DIV_SYSTEM_GB:
+              case DIV_SYSTEM_C64_6581:
+              case DIV_SYSTEM_C64_8580: {
+                if (ImGui::Checkbox("PAL",&sysPal)) {
+                  e->setSysFlags(i,(flags&(~1))|sysPal,restart);
+                  updateWindowTitle();
+                }
+                ImGui::Text("Emulation:");
+                if (ImGui::RadioButton("Accurate (clock every cycle)",(flags&0x30)==0)) {
+                  e->setSysFlags(i,(flags&(~0x30))|0,restart);
+                  updateWindowTitle();
+                }
+                if (ImGui::RadioButton("Fast",(flags&0x30)==0x10)) {
+                  e->setSysFlags(i,(flags&(~0x30))|0x10,restart);
+                  updateWindowTitle();
+                }
+                if (ImGui::RadioButton("Interpolate",(flags&0x30)==0x20)) {
+                  e->setSysFlags(i,(flags&(~0x30))|0x20,restart);
+                  updateWindowTitle();
+                }
+                if (ImGui::RadioButton("Resample",(flags&0x30)==0x30)) {
+                  e->setSysFlags(i,(flags&(~0x30))|0x30,restart);
+                  updateWindowTitle();
+                }
+                break;
+              }
+              case DIV_SYSTEM_GB: {
+                bool fastEmu=flags&16;
+                if (ImGui::Checkbox("Fast emulation (lower internal rate)",&fastEmu)) {
+                  e->setSysFlags(i,(flags&(~16))|(fastEmu?16:0),restart);
+                  updateWindowTitle();
+                }
+                break;
+              }
               case DIV_SYSTEM_YM2610:
               case DIV_SYSTEM_YM2610_EXT:
               case DIV_SYSTEM_YM2610_FULL:
@@ -5127,6 +5203,8 @@ bool FurnaceGUI::loop() {
         case GUI_FILE_LOAD_PAT_FONT:
           workingDirFont=ImGuiFileDialog::Instance()->GetCurrentPath()+DIR_SEPARATOR_STR;
           break;
+        case GUI_FILE_SAVE_TRACE:
+          break;
       }
       if (ImGuiFileDialog::Instance()->IsOk()) {
         fileName=ImGuiFileDialog::Instance()->GetFilePathName();
@@ -5156,6 +5234,9 @@ bool FurnaceGUI::loop() {
           if (curFileDialog==GUI_FILE_EXPORT_VGM) {
             checkExtension(".vgm");
           }
+          if (curFileDialog==GUI_FILE_SAVE_TRACE) {
+            checkExtension(".json");
+          }
           String copyOfName=fileName;
           switch (curFileDialog) {
             case GUI_FILE_OPEN:
@@ -5222,26 +5303,15 @@ bool FurnaceGUI::loop() {
               e->addWaveFromFile(copyOfName.c_str());
               modified=true;
               break;
-            case GUI_FILE_EXPORT_VGM: {
-              SafeWriter* w=e->saveVGM(willExport,vgmExportLoop);
-              if (w!=NULL) {
-                FILE* f=fopen(copyOfName.c_str(),"wb");
-                if (f!=NULL) {
-                  fwrite(w->getFinalBuf(),1,w->size(),f);
-                  fclose(f);
-                } else {
-                  showError("could not open file!");
-                }
-                w->finish();
-                delete w;
+            case GUI_FILE_EXPORT_VGM:
+              if (e->saveVGMFile(copyOfName.c_str(),willExport,vgmExportLoop)) {
                 if (!e->getWarnings().empty()) {
                   showWarning(e->getWarnings(),GUI_WARN_GENERIC);
                 }
               } else {
-                showError("could not write VGM. dang it.");
+                showError("could not write VGM! ("+e->getLastError()+")");
               }
               break;
-            }
             case GUI_FILE_EXPORT_ROM:
               showError("Coming soon!");
               break;
@@ -5251,6 +5321,11 @@ bool FurnaceGUI::loop() {
             case GUI_FILE_LOAD_PAT_FONT:
               settings.patFontPath=copyOfName;
               break;
+            case GUI_FILE_SAVE_TRACE:
+              if (!traceSave(copyOfName.c_str())) {
+                showError("could not save trace!");
+              }
+              break;
           }
           curFileDialog=GUI_FILE_OPEN;
         }
@@ -5286,6 +5361,7 @@ bool FurnaceGUI::loop() {
 
     if (ImGui::BeginPopupModal("Rendering...",NULL,ImGuiWindowFlags_AlwaysAutoResize)) {
       ImGui::Text("Please wait...\n");
+      ImGui::ProgressBar(e->getExportProgress(),ImVec2(300.0f*dpiScale,0));
       if (ImGui::Button("Abort")) {
         if (e->haltAudioFile()) {
           ImGui::CloseCurrentPopup();
@@ -5293,6 +5369,9 @@ bool FurnaceGUI::loop() {
       }
       if (!e->isExporting()) {
         ImGui::CloseCurrentPopup();
+        if (!e->getExportError().empty()) {
+          showError(fmt::sprintf("Error while exporting! (%s)",e->getExportError()));
+        }
       }
       ImGui::EndPopup();
     }
@@ -150,7 +150,8 @@ enum FurnaceGUIFileDialogs {
   GUI_FILE_EXPORT_VGM,
   GUI_FILE_EXPORT_ROM,
   GUI_FILE_LOAD_MAIN_FONT,
-  GUI_FILE_LOAD_PAT_FONT
+  GUI_FILE_LOAD_PAT_FONT,
+  GUI_FILE_SAVE_TRACE
 };
 
 enum FurnaceGUIWarnings {
@@ -466,6 +467,7 @@ class FurnaceGUI {
     int audioQuality;
     int arcadeCore;
     int ym2612Core;
+    int opllCore;
     int saaCore;
     int mainFont;
     int patFont;
@@ -488,6 +490,8 @@ class FurnaceGUI {
     int scrollStep;
     int sysSeparators;
     int forceMono;
+    int renderPoolThreads;
+    int renderAhead;
     int controlLayout;
     int restartOnFlagChange;
     int statusDisplay;
@@ -508,6 +512,7 @@ class FurnaceGUI {
       audioQuality(0),
       arcadeCore(0),
       ym2612Core(0),
+      opllCore(0),
       saaCore(0),
       mainFont(0),
       patFont(0),
@@ -530,6 +535,8 @@ class FurnaceGUI {
       scrollStep(0),
       sysSeparators(1),
       forceMono(0),
+      renderPoolThreads(0),
+      renderAhead(0),
       controlLayout(0),
       restartOnFlagChange(1),
       statusDisplay(0),
@@ -707,6 +714,7 @@ class FurnaceGUI {
   void editAdvance();
   void prepareUndo(ActionType action);
   void makeUndo(ActionType action);
+  void notifyUndoPatterns(UndoStep& us);
   void doSelectAll();
   void doDelete();
   void doPullDelete();
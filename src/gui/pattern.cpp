@@ -521,16 +521,14 @@ void FurnaceGUI::drawPattern() {
             snprintf(chanID,2048,"<##_LCH%d",i);
             ImGui::BeginDisabled(e->song.pat[i].effectRows<=1);
             if (ImGui::SmallButton(chanID)) {
-              e->song.pat[i].effectRows--;
-              if (e->song.pat[i].effectRows<1) e->song.pat[i].effectRows=1;
+              e->setEffectRows(i,e->song.pat[i].effectRows-1);
             }
             ImGui::EndDisabled();
             ImGui::SameLine();
             ImGui::BeginDisabled(e->song.pat[i].effectRows>=8);
             snprintf(chanID,2048,">##_RCH%d",i);
             if (ImGui::SmallButton(chanID)) {
-              e->song.pat[i].effectRows++;
-              if (e->song.pat[i].effectRows>8) e->song.pat[i].effectRows=8;
+              e->setEffectRows(i,e->song.pat[i].effectRows+1);
             }
             ImGui::EndDisabled();
           }
@@ -74,6 +74,11 @@ const char* ym2612Cores[]={
   "ymfm"
 };
 
+const char* opllCores[]={
+  "Nuked-OPLL",
+  "ymfm"
+};
+
 const char* saaCores[]={
   "MAME",
   "SAASound"
@@ -261,6 +266,26 @@ void FurnaceGUI::drawSettings() {
           settings.forceMono=forceMonoB;
         }
 
+        ImGui::Text("Render threads");
+        ImGui::SameLine();
+        if (ImGui::InputInt("##RenderPoolThreads",&settings.renderPoolThreads)) {
+          if (settings.renderPoolThreads<0) settings.renderPoolThreads=0;
+          if (settings.renderPoolThreads>32) settings.renderPoolThreads=32;
+        }
+        if (ImGui::IsItemHovered()) {
+          ImGui::SetTooltip("Number of threads used to render chips in parallel.\n0 or 1 renders everything on the audio thread.");
+        }
+
+        ImGui::Text("Render ahead");
+        ImGui::SameLine();
+        if (ImGui::InputInt("##RenderAhead",&settings.renderAhead)) {
+          if (settings.renderAhead<0) settings.renderAhead=0;
+          if (settings.renderAhead>32) settings.renderAhead=32;
+        }
+        if (ImGui::IsItemHovered()) {
+          ImGui::SetTooltip("Number of buffers to render ahead of the audio device on a separate thread.\nAllows smaller buffer sizes without dropouts, at the cost of this many buffers of added latency.\n0 renders in the audio callback.");
+        }
+
         TAAudioDesc& audioWant=e->getAudioDescWant();
         TAAudioDesc& audioGot=e->getAudioDescGot();
 
@@ -278,6 +303,10 @@ void FurnaceGUI::drawSettings() {
         ImGui::SameLine();
         ImGui::Combo("##YM2612Core",&settings.ym2612Core,ym2612Cores,2);
 
+        ImGui::Text("OPLL/YM2413 core");
+        ImGui::SameLine();
+        ImGui::Combo("##OPLLCore",&settings.opllCore,opllCores,2);
+
         ImGui::Text("SAA1099 core");
         ImGui::SameLine();
         ImGui::Combo("##SAACore",&settings.saaCore,saaCores,2);
@@ -840,6 +869,7 @@ void FurnaceGUI::syncSettings() {
   settings.audioRate=e->getConfInt("audioRate",44100);
   settings.arcadeCore=e->getConfInt("arcadeCore",0);
   settings.ym2612Core=e->getConfInt("ym2612Core",0);
+  settings.opllCore=e->getConfInt("opllCore",0);
   settings.saaCore=e->getConfInt("saaCore",0);
   settings.mainFont=e->getConfInt("mainFont",0);
   settings.patFont=e->getConfInt("patFont",0);
@@ -863,6 +893,8 @@ void FurnaceGUI::syncSettings() {
   settings.scrollStep=e->getConfInt("scrollStep",0);
   settings.sysSeparators=e->getConfInt("sysSeparators",1);
   settings.forceMono=e->getConfInt("forceMono",0);
+  settings.renderPoolThreads=e->getConfInt("renderPoolThreads",0);
+  settings.renderAhead=e->getConfInt("renderAhead",0);
   settings.controlLayout=e->getConfInt("controlLayout",0);
   settings.restartOnFlagChange=e->getConfInt("restartOnFlagChange",1);
   settings.statusDisplay=e->getConfInt("statusDisplay",0);
@@ -1038,6 +1070,7 @@ void FurnaceGUI::commitSettings() {
   e->setConf("audioRate",settings.audioRate);
   e->setConf("arcadeCore",settings.arcadeCore);
   e->setConf("ym2612Core",settings.ym2612Core);
+  e->setConf("opllCore",settings.opllCore);
   e->setConf("saaCore",settings.saaCore);
   e->setConf("mainFont",settings.mainFont);
   e->setConf("patFont",settings.patFont);
@@ -1060,6 +1093,8 @@ void FurnaceGUI::commitSettings() {
   e->setConf("scrollStep",settings.scrollStep);
   e->setConf("sysSeparators",settings.sysSeparators);
   e->setConf("forceMono",settings.forceMono);
+  e->setConf("renderPoolThreads",settings.renderPoolThreads);
+  e->setConf("renderAhead",settings.renderAhead);
   e->setConf("controlLayout",settings.controlLayout);
   e->setConf("restartOnFlagChange",settings.restartOnFlagChange);
   e->setConf("statusDisplay",settings.statusDisplay);
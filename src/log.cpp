@@ -18,67 +18,115 @@
  */
 
 #include "ta-log.h"
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+// must be a power of two
+#define TA_LOG_QUEUE_SIZE 1024
+#define TA_LOG_MESSAGE_SIZE 512
 
 int logLevel=LOGLEVEL_INFO;
 
-int logD(const char* format, ...) {
-  va_list va;
-  int ret;
-  if (logLevel<LOGLEVEL_DEBUG) return 0;
+struct TALogMessage {
+  std::atomic<bool> ready;
+  int level;
+  char text[TA_LOG_MESSAGE_SIZE];
+};
+
+static TALogMessage logQueue[TA_LOG_QUEUE_SIZE];
+static std::atomic<size_t> logReadPos(0), logWritePos(0);
+static std::atomic<int> logDropped(0);
+static std::atomic<bool> logRunning(false), logQuit(false);
+static std::thread* logThread=NULL;
+
+static void printLog(int level, const char* text) {
 #ifdef _WIN32
-  printf("[debug] ");
+  static const char* prefixes[4]={"[ERROR] ","[warning] ","[info] ","[debug] "};
 #else
-  printf("\x1b[1;34m[debug]\x1b[m ");
+  static const char* prefixes[4]={"\x1b[1;31m[ERROR]\x1b[m ","\x1b[1;33m[warning]\x1b[m ","\x1b[1;32m[info]\x1b[m ","\x1b[1;34m[debug]\x1b[m "};
 #endif
-  va_start(va,format);
-  ret=vprintf(format,va);
-  va_end(va);
-  fflush(stdout);
-  return ret;
+  fputs(prefixes[level&3],stdout);
+  fputs(text,stdout);
 }
 
-int logI(const char* format, ...) {
-  va_list va;
-  int ret;
-  if (logLevel<LOGLEVEL_INFO) return 0;
-#ifdef _WIN32
-  printf("[info] ");
-#else
-  printf("\x1b[1;32m[info]\x1b[m ");
-#endif
-  va_start(va,format);
-  ret=vprintf(format,va);
-  va_end(va);
-  return ret;
+// returns whether anything was printed
+static bool drainLog() {
+  bool printed=false;
+  int dropped=logDropped.exchange(0);
+  if (dropped>0) {
+    char text[64];
+    snprintf(text,63,"%d log messages were dropped!\n",dropped);
+    printLog(LOGLEVEL_WARN,text);
+    printed=true;
+  }
+  while (true) {
+    size_t pos=logReadPos.load(std::memory_order_relaxed);
+    if (pos==logWritePos.load(std::memory_order_acquire)) break;
+    TALogMessage& msg=logQueue[pos&(TA_LOG_QUEUE_SIZE-1)];
+    // claimed but not written yet
+    if (!msg.ready.load(std::memory_order_acquire)) break;
+    printLog(msg.level,msg.text);
+    msg.ready.store(false,std::memory_order_relaxed);
+    logReadPos.store(pos+1,std::memory_order_release);
+    printed=true;
+  }
+  if (printed) fflush(stdout);
+  return printed;
 }
 
-int logW(const char* format, ...) {
-  va_list va;
-  int ret;
-  if (logLevel<LOGLEVEL_WARN) return 0;
-#ifdef _WIN32
-  printf("[warning] ");
-#else
-  printf("\x1b[1;33m[warning]\x1b[m ");
-#endif
-  va_start(va,format);
-  ret=vprintf(format,va);
-  va_end(va);
-  return ret;
+static void logThreadLoop() {
+  while (!logQuit) {
+    if (!drainLog()) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  drainLog();
 }
 
-int logE(const char* format, ...) {
+int writeLog(int level, const char* format, ...) {
   va_list va;
   int ret;
-  if (logLevel<LOGLEVEL_ERROR) return 0;
-#ifdef _WIN32
-  printf("[ERROR] ");
-#else
-  printf("\x1b[1;31m[ERROR]\x1b[m ");
-#endif
+  if (!logRunning.load(std::memory_order_acquire)) {
+    char text[TA_LOG_MESSAGE_SIZE];
+    va_start(va,format);
+    ret=vsnprintf(text,TA_LOG_MESSAGE_SIZE,format,va);
+    va_end(va);
+    printLog(level,text);
+    fflush(stdout);
+    return ret;
+  }
+
+  // claim a slot. several threads may be logging at once.
+  size_t pos=logWritePos.load(std::memory_order_relaxed);
+  do {
+    if (pos-logReadPos.load(std::memory_order_acquire)>=TA_LOG_QUEUE_SIZE) {
+      logDropped++;
+      return 0;
+    }
+  } while (!logWritePos.compare_exchange_weak(pos,pos+1,std::memory_order_acq_rel));
+
+  TALogMessage& msg=logQueue[pos&(TA_LOG_QUEUE_SIZE-1)];
+  msg.level=level;
   va_start(va,format);
-  ret=vprintf(format,va);
+  ret=vsnprintf(msg.text,TA_LOG_MESSAGE_SIZE,format,va);
   va_end(va);
+  msg.ready.store(true,std::memory_order_release);
   return ret;
 }
 
+void initLog() {
+  if (logThread!=NULL) return;
+  logQuit=false;
+  logThread=new std::thread(logThreadLoop);
+  logRunning=true;
+}
+
+void finishLog() {
+  if (logThread==NULL) return;
+  logQuit=true;
+  logThread->join();
+  delete logThread;
+  logThread=NULL;
+  logRunning=false;
+  // messages queued while stopping
+  drainLog();
+}
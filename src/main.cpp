@@ -19,6 +19,7 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string>
 #ifdef HAVE_GUI
 #include "SDL_events.h"
@@ -49,6 +50,9 @@ String outName;
 String vgmOutName;
 int loops=1;
 DivAudioExportModes outMode=DIV_EXPORT_MODE_ONE;
+bool benchMode=false;
+unsigned int benchBufSize=1024;
+String traceName;
 
 #ifdef HAVE_GUI
 bool consoleMode=false;
@@ -211,6 +215,51 @@ bool pVGMOut(String val) {
   return true;
 }
 
+bool pBenchmark(String val) {
+  benchMode=true;
+  e.setAudio(DIV_AUDIO_DUMMY);
+  return true;
+}
+
+bool pBufSize(String val) {
+  try {
+    int size=std::stoi(val);
+    if (size<1 || size>4000) {
+      logE("buffer size shall be between 1 and 4000.\n");
+      return false;
+    }
+    benchBufSize=size;
+  } catch (std::exception& e) {
+    logE("buffer size shall be a number.\n");
+    return false;
+  }
+  return true;
+}
+
+bool pThreads(String val) {
+  try {
+    int count=std::stoi(val);
+    if (count<0 || count>32) {
+      logE("thread count shall be between 0 and 32.\n");
+      return false;
+    }
+    e.setRenderThreads(count);
+  } catch (std::exception& e) {
+    logE("thread count shall be a number.\n");
+    return false;
+  }
+  return true;
+}
+
+bool pTrace(String val) {
+  traceName=val;
+  return true;
+}
+
+void finishTrace() {
+  if (traceName!="") traceSave(traceName.c_str());
+}
+
 bool needsValue(String param) {
   for (size_t i=0; i<params.size(); i++) {
     if (params[i].name==param) {
@@ -232,6 +281,11 @@ void initParams() {
 
   params.push_back(TAParam("l","loops",true,pLoops,"<count>","set number of loops (-1 means loop forever)"));
   params.push_back(TAParam("o","outmode",true,pOutMode,"one|persys|perchan","set file output mode"));
+  params.push_back(TAParam("t","threads",true,pThreads,"<count>","set number of render threads (0 or 1 renders on the audio thread)"));
+
+  params.push_back(TAParam("B","benchmark",false,pBenchmark,"","render the song as fast as possible and print timing statistics"));
+  params.push_back(TAParam("b","bufsize",true,pBufSize,"<samples>","set buffer size for benchmark (1024 by default)"));
+  params.push_back(TAParam("T","trace",true,pTrace,"<filename>","record audio thread activity and save it as a Chrome trace on exit"));
 
   params.push_back(TAParam("V","version",false,pVersion,"","view information about Furnace."));
   params.push_back(TAParam("W","warranty",false,pWarranty,"","view warranty disclaimer."));
@@ -287,6 +341,11 @@ int main(int argc, char** argv) {
     }
   }
 
+  // from now on log messages are printed by the log thread.
+  // pending messages are printed on exit.
+  initLog();
+  atexit(finishLog);
+
   e.setConsoleMode(consoleMode);
 
 #ifdef _WIN32
@@ -304,53 +363,15 @@ int main(int argc, char** argv) {
   }
 #endif
 
-  if (fileName.empty() && consoleMode) {
+  if (fileName.empty() && (consoleMode || benchMode)) {
     logI("usage: %s file\n",argv[0]);
     return 1;
   }
   logI("Furnace version " DIV_VERSION ".\n");
+  if (traceName!="") traceStart();
   if (!fileName.empty()) {
     logI("loading module...\n");
-    FILE* f=ps_fopen(fileName.c_str(),"rb");
-    if (f==NULL) {
-      perror("error");
-      return 1;
-    }
-    if (fseek(f,0,SEEK_END)<0) {
-      perror("size error");
-      fclose(f);
-      return 1;
-    }
-    ssize_t len=ftell(f);
-    if (len==(SIZE_MAX>>1)) {
-      perror("could not get file length");
-      fclose(f);
-      return 1;
-    }
-    if (len<1) {
-      if (len==0) {
-        printf("that file is empty!\n");
-      } else {
-        perror("tell error");
-      }
-      fclose(f);
-      return 1;
-    }
-    unsigned char* file=new unsigned char[len];
-    if (fseek(f,0,SEEK_SET)<0) {
-      perror("size error");
-      fclose(f);
-      delete[] file;
-      return 1;
-    }
-    if (fread(file,1,(size_t)len,f)!=(size_t)len) {
-      perror("read error");
-      fclose(f);
-      delete[] file;
-      return 1;
-    }
-    fclose(f);
-    if (!e.load(file,(size_t)len)) {
+    if (!e.loadFile(fileName.c_str())) {
       logE("could not open file!\n");
       return 1;
     }
@@ -363,21 +384,35 @@ int main(int argc, char** argv) {
       displayEngineFailError=true;
     }
   }
+  if (benchMode) {
+    DivBenchmarkResult result;
+    if (loops==0) {
+      logE("can't benchmark with infinite loops!\n");
+      return 1;
+    }
+    // don't print status while measuring
+    e.setConsoleMode(false);
+    if (!e.benchmark(result,benchBufSize,loops)) {
+      logE("could not run benchmark!\n");
+      return 1;
+    }
+    double deadline=(double)result.bufsize/result.rate;
+    printf("rendered %.2f seconds of audio in %.2f seconds (%.2fx realtime)\n",result.audioTime,result.renderTime,result.audioTime/result.renderTime);
+    printf("%d buffers of %d samples at %gHz (deadline: %.1fus)\n",(int)result.buffers,result.bufsize,result.rate,deadline*1000000.0);
+    printf("- mean: %.1fus (%.1f%%)\n",result.bufMean*1000000.0,100.0*result.bufMean/deadline);
+    printf("- p99: %.1fus (%.1f%%)\n",result.bufP99*1000000.0,100.0*result.bufP99/deadline);
+    printf("- max: %.1fus (%.1f%%)\n",result.bufMax*1000000.0,100.0*result.bufMax/deadline);
+    printf("time per chip:\n");
+    for (size_t i=0; i<result.sysTime.size(); i++) {
+      printf("- %d. %s: %.3fs (%.1f%%)\n",(int)i+1,e.getSystemName(e.song.system[i]),result.sysTime[i],100.0*result.sysTime[i]/result.renderTime);
+    }
+    finishTrace();
+    return 0;
+  }
   if (outName!="" || vgmOutName!="") {
     if (vgmOutName!="") {
-      SafeWriter* w=e.saveVGM();
-      if (w!=NULL) {
-        FILE* f=fopen(vgmOutName.c_str(),"wb");
-        if (f!=NULL) {
-          fwrite(w->getFinalBuf(),1,w->size(),f);
-          fclose(f);
-        } else {
-          logE("could not open file! %s\n",strerror(errno));
-        }
-        w->finish();
-        delete w;
-      } else {
-        logE("could not write VGM!\n");
+      if (!e.saveVGMFile(vgmOutName.c_str())) {
+        logE("could not write VGM! %s\n",e.getLastError().c_str());
       }
     }
     if (outName!="") {
@@ -385,6 +420,7 @@ int main(int argc, char** argv) {
       e.saveAudio(outName.c_str(),loops,outMode);
       e.waitAudioFile();
     }
+    finishTrace();
     return 0;
   }
 
@@ -398,6 +434,7 @@ int main(int argc, char** argv) {
       if (ev.type==SDL_QUIT) break;
     }
     e.quit();
+    finishTrace();
     return 0;
 #else
     while (true) {
@@ -432,6 +469,7 @@ int main(int argc, char** argv) {
 
   logI("stopping engine.\n");
   e.quit();
+  finishTrace();
   return 0;
 }
 
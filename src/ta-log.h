@@ -27,10 +27,48 @@
 #define LOGLEVEL_INFO 2
 #define LOGLEVEL_DEBUG 3
 
+// log calls above this level are removed at compile time (see the
+// TA_LOG_MAX_LEVEL CMake option). their arguments are still type-checked but
+// never evaluated.
+#ifndef TA_LOG_MAX_LEVEL
+#define TA_LOG_MAX_LEVEL LOGLEVEL_DEBUG
+#endif
+
 extern int logLevel;
 
-int logD(const char* format, ...);
-int logI(const char* format, ...);
-int logW(const char* format, ...);
-int logE(const char* format, ...);
+// don't call this directly. use the macros below.
+int writeLog(int level, const char* format, ...);
+
+#if TA_LOG_MAX_LEVEL>=LOGLEVEL_DEBUG
+#define logD(...) ((logLevel>=LOGLEVEL_DEBUG)?writeLog(LOGLEVEL_DEBUG,__VA_ARGS__):0)
+#else
+#define logD(...) ((void)sizeof(writeLog(LOGLEVEL_DEBUG,__VA_ARGS__)))
+#endif
+
+#if TA_LOG_MAX_LEVEL>=LOGLEVEL_INFO
+#define logI(...) ((logLevel>=LOGLEVEL_INFO)?writeLog(LOGLEVEL_INFO,__VA_ARGS__):0)
+#else
+#define logI(...) ((void)sizeof(writeLog(LOGLEVEL_INFO,__VA_ARGS__)))
+#endif
+
+#if TA_LOG_MAX_LEVEL>=LOGLEVEL_WARN
+#define logW(...) ((logLevel>=LOGLEVEL_WARN)?writeLog(LOGLEVEL_WARN,__VA_ARGS__):0)
+#else
+#define logW(...) ((void)sizeof(writeLog(LOGLEVEL_WARN,__VA_ARGS__)))
+#endif
+
+#define logE(...) ((logLevel>=LOGLEVEL_ERROR)?writeLog(LOGLEVEL_ERROR,__VA_ARGS__):0)
+
+/**
+ * start the log thread.
+ * until this is called (and after finishLog()), messages are printed by the
+ * thread which logs them. otherwise they are queued without locking or
+ * allocating, so that logging is safe from the audio thread.
+ */
+void initLog();
+
+/**
+ * print all pending messages and stop the log thread.
+ */
+void finishLog();
 #endif
@@ -0,0 +1,28 @@
+#!/bin/bash
+# renders all files in test/songs/ on the audio thread and on a pool of two
+# render threads, and checks that the outputs are identical.
+# songs with two or more of the same chip make both instances render at the
+# same time, so any state shared between them shows up as a mismatch.
+# requires GNU parallel.
+
+testDir=$(date +%Y%m%d%H%M%S)
+failed=0
+
+echo "furnace stress test begin..."
+echo "--- STEP 1: render test files"
+mkdir -p "test/stress/$testDir/serial" || exit 1
+mkdir -p "test/stress/$testDir/parallel" || exit 1
+ls "test/songs/" | parallel --verbose -j4 ./build/furnace -threads 0 -output "test/stress/$testDir/serial/{0}.wav" "test/songs/{0}"
+ls "test/songs/" | parallel --verbose -j4 ./build/furnace -threads 2 -output "test/stress/$testDir/parallel/{0}.wav" "test/songs/{0}"
+echo "--- STEP 2: compare outputs"
+for i in $(ls "test/stress/$testDir/serial/"); do
+  if ! cmp -s "test/stress/$testDir/serial/$i" "test/stress/$testDir/parallel/$i"; then
+    echo "MISMATCH: $i"
+    failed=1
+  fi
+done
+if [ $failed -ne 0 ]; then
+  echo "stress test failed!"
+  exit 1
+fi
+echo "all outputs match."